@@ -15,32 +15,16 @@ using namespace std;
 // This class takes its inputs (in terms of T), multiplies them using *=, then outputs the multiplication expression including the product as a string.
 // For example, given the inputs of 3 and 4, it outputs the string "3 * 4 = 12".
 template<typename T>
-class multiplication_expressifier : public flow::transformer<T, string>
+class multiplication_expressifier : public flow::join<T, string>
 {
 public:
-	multiplication_expressifier(size_t ins = 2, const string& name_r = "multiplication_expressifier") : flow::node(name_r), flow::transformer<T, string>(name_r, ins, 1) {}
+	multiplication_expressifier(size_t ins = 2, const string& name_r = "multiplication_expressifier") : flow::node(name_r), flow::join<T, string>(name_r, ins, 1) {}
 
 	virtual ~multiplication_expressifier() {}
 
-	virtual void ready(size_t n)
+	// Called with one packet from each input, once all inputs have one.
+	virtual void joined(typename flow::join<T, string>::set_t& terms)
 	{
-		// Check that a packet is ready at all inputs. If not, return and try again when another packet arrives.
-		for(size_t i = 0; i != flow::consumer<T>::ins(); ++i)
-		{
-			if(!flow::consumer<T>::input(i).peek())
-			{
-				return;
-			}
-		}
-
-		// Gather the terms in a container.
-		vector<unique_ptr<flow::packet<T>>> terms;
-
-		for(size_t i = 0; i != flow::consumer<T>::ins(); ++i)
-		{
-			terms.emplace_back(move(flow::consumer<T>::input(i).pop()));
-		}
-
 		// Start the product as equal to the first term.
 		T product(terms[0]->data());
 
@@ -60,7 +44,7 @@ public:
 		// ss now looks like "a * b [* x] = p".
 
 		// Make a packet with the expression.
-		unique_ptr<flow::packet<string>> p(new flow::packet<string>(ss.str()));
+		unique_ptr<flow::packet<string>> p(flow::producer<string>::make_packet(ss.str()));
 
 		// Output it.
 		flow::producer<string>::output(0).push(p);
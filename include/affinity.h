@@ -0,0 +1,101 @@
+#if !defined(FLOW_AFFINITY_H)
+	 #define FLOW_AFFINITY_H
+
+#include <cstddef>
+#include <set>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+//!\file affinity.h
+//!
+//!\brief Defines the \ref flow::cpus_t type and the functions that pin threads to CPUs.
+
+namespace flow
+{
+
+//!\brief A set of CPUs, by index as numbered by the operating system.
+typedef std::set<size_t> cpus_t;
+
+//!\brief Whether threads can be pinned to CPUs on this platform.
+inline bool affinity_supported()
+{
+#if defined(__linux__)
+	return true;
+#else
+	return false;
+#endif
+}
+
+//!\brief Restricts a thread to run on a set of CPUs.
+//!
+//! The memory a thread touches first is typically allocated on the NUMA node of the CPU it runs on.
+//! Pinning a thread therefore also places the memory it allocates, e.g. the packets of a node's \ref packet_pool "packet_pool".
+//!
+//!\param thread_r The thread to pin. It must be running.
+//!\param cpus The CPUs the thread may run on. An empty set allows all CPUs.
+//!
+//!\return \c false if the thread could not be pinned, e.g. because pinning is not supported on this platform or a CPU does not exist.
+inline bool pin_thread(std::thread& thread_r, const cpus_t& cpus)
+{
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	if(cpus.empty())
+	{
+		for(size_t cpu = 0; cpu != CPU_SETSIZE; ++cpu)
+		{
+			CPU_SET(cpu, &set);
+		}
+	}
+	else
+	{
+		for(auto cpu : cpus)
+		{
+			if(cpu >= CPU_SETSIZE) return false;
+
+			CPU_SET(cpu, &set);
+		}
+	}
+
+	return pthread_setaffinity_np(thread_r.native_handle(), sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+}
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,313 @@
+#if !defined(FLOW_BATCH_H)
+	 #define FLOW_BATCH_H
+
+#include <algorithm>
+#include <cstddef>
+
+//!\file batch.h
+//!
+//!\brief Defines the \ref flow::batch class.
+
+namespace flow
+{
+
+//!\cond
+namespace detail
+{
+
+// The alignment of the values of a batch.
+// Packets and packet pools guarantee no more than the largest fundamental alignment.
+const size_t batch_alignment = alignof(std::max_align_t);
+
+// Tells the compiler that p is aligned so that loops over it vectorize without a scalar prologue.
+template<typename T>
+inline T* assume_aligned(T* p)
+{
+#if defined(__GNUC__)
+	return static_cast<T*>(__builtin_assume_aligned(p, batch_alignment));
+#else
+	return p;
+#endif
+}
+
+// The kernels below are plain loops over contiguous, aligned arrays, written for the compiler to vectorize.
+// Values go through fixed-size blocks of locals, which vectorize even without -O3 and whether or not the arrays overlap.
+const size_t batch_lanes = 8;
+
+template<typename T, typename Op>
+inline void elementwise(T* a_p, const T* b_p, const size_t n, Op op)
+{
+	a_p = assume_aligned(a_p);
+	b_p = assume_aligned(b_p);
+
+	const size_t whole = n / batch_lanes * batch_lanes;
+
+	for(size_t i = 0; i != whole; i += batch_lanes)
+	{
+		T r[batch_lanes];
+		for(size_t j = 0; j != batch_lanes; ++j)
+		{
+			r[j] = op(a_p[i + j], b_p[i + j]);
+		}
+
+		std::copy(r, r + batch_lanes, a_p + i);
+	}
+
+	for(size_t i = whole; i != n; ++i)
+	{
+		a_p[i] = op(a_p[i], b_p[i]);
+	}
+}
+
+template<typename T, typename Op>
+inline void scalar(T* a_p, const T b, const size_t n, Op op)
+{
+	a_p = assume_aligned(a_p);
+
+	const size_t whole = n / batch_lanes * batch_lanes;
+
+	for(size_t i = 0; i != whole; i += batch_lanes)
+	{
+		T r[batch_lanes];
+		for(size_t j = 0; j != batch_lanes; ++j)
+		{
+			r[j] = op(a_p[i + j], b);
+		}
+
+		std::copy(r, r + batch_lanes, a_p + i);
+	}
+
+	for(size_t i = whole; i != n; ++i)
+	{
+		a_p[i] = op(a_p[i], b);
+	}
+}
+
+struct plus
+{
+	template<typename T>
+	T operator()(const T& a, const T& b) const { return a + b; }
+};
+
+struct multiplies
+{
+	template<typename T>
+	T operator()(const T& a, const T& b) const { return a * b; }
+};
+
+}
+//!\endcond
+
+//!\brief A fixed-capacity block of values, to be carried by a single packet.
+//!
+//! Moving many values in a single packet spreads the cost of a packet over all of them.
+//! The values are stored contiguously, aligned, inside the batch itself, so a batch owns no memory on the heap.
+//! Its arithmetic operators are loops over whole batches that the compiler can vectorize,
+//! so nodes like \ref samples::math::adder "adder" and \ref samples::math::const_adder "const_adder" operate on whole batches at once.
+//!
+//!\tparam T The type of values, typically an arithmetic type.
+//!\tparam N The maximum number of values.
+template<typename T, size_t N>
+class batch
+{
+	static_assert(N != 0, "A batch must be able to hold values.");
+
+	alignas(detail::batch_alignment) T d_values[N];
+	size_t d_size;
+
+public:
+	typedef T value_type;			//!< The type of values.
+	typedef T* iterator;			//!< Iterator to values.
+	typedef const T* const_iterator;	//!< Iterator to constant values.
+
+	//!\brief Makes an empty batch.
+	batch() : d_size(0) {}
+
+	//!\brief Makes a batch of \c n copies of \c t.
+	//!
+	//!\param n The number of values. At most N.
+	//!\param t The value to copy.
+	explicit batch(const size_t n, const T& t = T()) : d_size(std::min(n, N))
+	{
+		std::fill(d_values, d_values + d_size, t);
+	}
+
+	//!\brief The maximum number of values.
+	static size_t capacity()
+	{
+		return N;
+	}
+
+	//!\brief The number of values.
+	size_t size() const
+	{
+		return d_size;
+	}
+
+	//!\brief Whether there are no values.
+	bool empty() const
+	{
+		return d_size == 0;
+	}
+
+	//!\brief Whether no more values fit.
+	bool full() const
+	{
+		return d_size == N;
+	}
+
+	//!\brief Removes all values.
+	void clear()
+	{
+		d_size = 0;
+	}
+
+	//!\brief Appends a value.
+	//!
+	//!\return \c false if the batch is full, in which case the value is not appended.
+	bool push_back(const T& t)
+	{
+		if(full()) return false;
+
+		d_values[d_size++] = t;
+		return true;
+	}
+
+	//!\brief Changes the number of values.
+	//!
+	//!\param n The number of values. At most N.
+	//!\param t The value to copy to values that are added.
+	void resize(const size_t n, const T& t = T())
+	{
+		const size_t size = std::min(n, N);
+
+		if(size > d_size)
+		{
+			std::fill(d_values + d_size, d_values + size, t);
+		}
+
+		d_size = size;
+	}
+
+	//!\brief Access to a value.
+	T& operator[](const size_t i) { return d_values[i]; }
+
+	//!\brief Access to a value.
+	const T& operator[](const size_t i) const { return d_values[i]; }
+
+	//!\brief The values, contiguous and aligned.
+	T* data() { return d_values; }
+
+	//!\brief The values, contiguous and aligned.
+	const T* data() const { return d_values; }
+
+	//!\brief Iterator to the first value.
+	iterator begin() { return d_values; }
+
+	//!\brief Iterator to the first value.
+	const_iterator begin() const { return d_values; }
+
+	//!\brief Iterator past the last value.
+	iterator end() { return d_values + d_size; }
+
+	//!\brief Iterator past the last value.
+	const_iterator end() const { return d_values + d_size; }
+
+	//!\brief Adds the values of another batch to the values of this one, one by one.
+	//!
+	//! If the batches are of different sizes, only the values they both have are added.
+	batch& operator+=(const batch& other)
+	{
+		detail::elementwise(d_values, other.d_values, std::min(d_size, other.d_size), detail::plus());
+		return *this;
+	}
+
+	//!\brief Adds a value to all values.
+	batch& operator+=(const T& t)
+	{
+		detail::scalar(d_values, t, d_size, detail::plus());
+		return *this;
+	}
+
+	//!\brief Multiplies the values of this batch by the values of another one, one by one.
+	//!
+	//! If the batches are of different sizes, only the values they both have are multiplied.
+	batch& operator*=(const batch& other)
+	{
+		detail::elementwise(d_values, other.d_values, std::min(d_size, other.d_size), detail::multiplies());
+		return *this;
+	}
+
+	//!\brief Multiplies all values by a factor.
+	batch& operator*=(const T& t)
+	{
+		detail::scalar(d_values, t, d_size, detail::multiplies());
+		return *this;
+	}
+
+	//!\brief The sum of all values.
+	//!
+	//! Values are summed in several interleaved partial sums, which vectorize.
+	//! For floating point values, the result may therefore differ slightly from a sum in order.
+	T sum() const
+	{
+		const size_t lanes = detail::batch_lanes;
+		T partial[lanes] = {};
+
+		const T *values_p = detail::assume_aligned(d_values);
+		const size_t whole = d_size / lanes * lanes;
+
+		for(size_t i = 0; i != whole; i += lanes)
+		{
+			for(size_t j = 0; j != lanes; ++j)
+			{
+				partial[j] += values_p[i + j];
+			}
+		}
+
+		T total = T();
+		for(size_t j = 0; j != lanes; ++j)
+		{
+			total += partial[j];
+		}
+
+		for(size_t i = whole; i != d_size; ++i)
+		{
+			total += values_p[i];
+		}
+
+		return total;
+	}
+};
+
+}
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
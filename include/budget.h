@@ -0,0 +1,307 @@
+#if !defined(FLOW_BUDGET_H)
+	 #define FLOW_BUDGET_H
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//!\file budget.h
+//!
+//!\brief Defines the \ref flow::budget_policy values, what a graph does when the packets in its pipes outgrow its memory budget.
+
+namespace flow
+{
+
+//!\namespace flow::budget_policy
+//!
+//!\brief Contains the different budget policy values.
+namespace budget_policy
+{
+
+//!\enum type
+//!
+//!\brief What a graph does with a packet pushed once the packets in all its pipes weigh as much as its \ref graph::budget "budget" allows.
+enum type
+{
+	backpressure,	//!< The pipe that holds the most bytes refuses the packet and its own \ref overflow::type "overflow policy" applies, e.g. an overflow::block pipe makes its producer wait. The other pipes still take packets so that the nodes draining the biggest pipe never wait on the budget.
+	shed,			//!< The packet is discarded if its pipe has the lowest \ref pipe::priority "priority" of the pipes that hold packets. Pipes of higher priority still take packets.
+	drop_oldest		//!< The oldest packets of the packet's pipe, those with the earliest consumption times in a stream stamped in order, are discarded to make room for it. A \ref flow::ring_pipe "ring_pipe" discards the packet instead.
+};
+
+}
+
+//!\cond
+namespace detail
+{
+
+class budget;
+
+// A pipe's share of a budget: the bytes it holds and its priority.
+// A pipe that is not metered still has an account, which only holds its priority.
+class account
+{
+	std::shared_ptr<budget> d_budget_sp;	// Null if the pipe is not metered.
+
+	std::atomic<size_t> d_weight_a;
+	std::atomic<int> d_priority_a;
+
+	account(const account&);
+	account& operator=(const account&);
+
+	friend class budget;
+
+public:
+	account(const int priority = 0) : d_weight_a(0), d_priority_a(priority) {}
+
+	~account();
+
+	// Draws from a budget from now on, or from none if null, starting with the bytes the pipe already holds.
+	// Must not be called while packets are pushed to or popped from the pipe.
+	void meter(const std::shared_ptr<budget>& budget_sp, const size_t weight);
+
+	// Charges the budget for a packet. Returns false if the budget has no room for it.
+	bool admit(const size_t size);
+
+	// Gives the bytes of a packet that left the pipe back to the budget.
+	void release(const size_t size);
+
+	// Counts packets discarded to stay within the budget.
+	void shed(const size_t n);
+
+	// The policy of the budget, budget_policy::backpressure if the pipe is not metered.
+	budget_policy::type policy() const;
+
+	int priority() const
+	{
+		return d_priority_a.load(std::memory_order_relaxed);
+	}
+
+	int prioritize(const int priority)
+	{
+		return d_priority_a.exchange(priority, std::memory_order_relaxed);
+	}
+};
+
+// The bytes held by all pipes of a graph, against a limit.
+// Pipes charge it as packets are pushed to them and credit it as packets are popped from them, from whatever thread.
+// Only a push that finds the budget exhausted looks at the other pipes' accounts, under a lock that is never held while locking anything else.
+class budget
+{
+	std::atomic<size_t> d_limit_a;
+	std::atomic<budget_policy::type> d_policy_a;
+
+	std::atomic<size_t> d_used_a;
+	std::atomic<size_t> d_high_water_a;
+	std::atomic<size_t> d_refused_a;
+	std::atomic<size_t> d_shed_a;
+
+	std::vector<account*> d_accounts;
+	mutable std::mutex d_accounts_m;
+
+	budget(const budget&);
+	budget& operator=(const budget&);
+
+	// Whether no other pipe holds more bytes.
+	bool biggest(const account& account_r) const
+	{
+		std::lock_guard<std::mutex> lg(d_accounts_m);
+
+		const size_t weight = account_r.d_weight_a.load(std::memory_order_relaxed);
+		for(auto account_p : d_accounts)
+		{
+			if(account_p->d_weight_a.load(std::memory_order_relaxed) > weight) return false;
+		}
+
+		return true;
+	}
+
+	// Whether no other pipe that holds packets has a lower priority.
+	bool lowest(const account& account_r) const
+	{
+		std::lock_guard<std::mutex> lg(d_accounts_m);
+
+		const int priority = account_r.priority();
+		for(auto account_p : d_accounts)
+		{
+			if(account_p->d_weight_a.load(std::memory_order_relaxed) && account_p->priority() < priority) return false;
+		}
+
+		return true;
+	}
+
+	void raise(const size_t used)
+	{
+		size_t high_water = d_high_water_a.load(std::memory_order_relaxed);
+		while(used > high_water && !d_high_water_a.compare_exchange_weak(high_water, used, std::memory_order_relaxed));
+	}
+
+public:
+	budget() : d_limit_a(0), d_policy_a(budget_policy::backpressure), d_used_a(0), d_high_water_a(0), d_refused_a(0), d_shed_a(0) {}
+
+	// Sets the number of bytes the pipes may hold, 0 for no limit, and what to do once they do.
+	void set(const size_t limit, const budget_policy::type policy)
+	{
+		d_policy_a = policy;
+		d_limit_a = limit;
+	}
+
+	budget_policy::type policy() const
+	{
+		return d_policy_a.load(std::memory_order_relaxed);
+	}
+
+	void enlist(account& account_r)
+	{
+		std::lock_guard<std::mutex> lg(d_accounts_m);
+
+		d_accounts.push_back(&account_r);
+		raise(d_used_a.fetch_add(account_r.d_weight_a.load()) + account_r.d_weight_a.load());
+	}
+
+	void strike(account& account_r)
+	{
+		std::lock_guard<std::mutex> lg(d_accounts_m);
+
+		d_accounts.erase(std::find(d_accounts.begin(), d_accounts.end(), &account_r));
+		d_used_a.fetch_sub(account_r.d_weight_a.exchange(0));
+	}
+
+	bool admit(account& account_r, const size_t size)
+	{
+		const size_t limit = d_limit_a.load(std::memory_order_relaxed), used = d_used_a.fetch_add(size) + size;
+
+		if(limit && used > limit)
+		{
+			const budget_policy::type policy = d_policy_a.load(std::memory_order_relaxed);
+
+			if(policy == budget_policy::drop_oldest || (policy == budget_policy::backpressure && biggest(account_r)) || (policy == budget_policy::shed && lowest(account_r)))
+			{
+				d_used_a.fetch_sub(size);
+
+				if(policy == budget_policy::backpressure)
+				{
+					d_refused_a.fetch_add(1, std::memory_order_relaxed);
+				}
+
+				return false;
+			}
+		}
+
+		account_r.d_weight_a.fetch_add(size, std::memory_order_relaxed);
+		raise(used);
+
+		return true;
+	}
+
+	void release(account& account_r, const size_t size)
+	{
+		account_r.d_weight_a.fetch_sub(size, std::memory_order_relaxed);
+		d_used_a.fetch_sub(size);
+	}
+
+	void shed(const size_t n)
+	{
+		d_shed_a.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	budget_metrics metrics() const
+	{
+		budget_metrics m;
+
+		m.limit = d_limit_a.load(std::memory_order_relaxed);
+		m.used = d_used_a.load(std::memory_order_relaxed);
+		m.high_water = d_high_water_a.load(std::memory_order_relaxed);
+		m.refused = d_refused_a.load(std::memory_order_relaxed);
+		m.shed = d_shed_a.load(std::memory_order_relaxed);
+
+		return m;
+	}
+};
+
+inline account::~account()
+{
+	meter(std::shared_ptr<budget>(), 0);
+}
+
+inline void account::meter(const std::shared_ptr<budget>& budget_sp, const size_t weight)
+{
+	if(budget_sp == d_budget_sp) return;
+
+	if(d_budget_sp)
+	{
+		d_budget_sp->strike(*this);
+	}
+
+	d_budget_sp = budget_sp;
+	d_weight_a = weight;
+
+	if(d_budget_sp)
+	{
+		d_budget_sp->enlist(*this);
+	}
+}
+
+inline bool account::admit(const size_t size)
+{
+	return !d_budget_sp || d_budget_sp->admit(*this, size);
+}
+
+inline void account::release(const size_t size)
+{
+	if(d_budget_sp)
+	{
+		d_budget_sp->release(*this, size);
+	}
+}
+
+inline void account::shed(const size_t n)
+{
+	if(d_budget_sp)
+	{
+		d_budget_sp->shed(n);
+	}
+}
+
+inline budget_policy::type account::policy() const
+{
+	return d_budget_sp ? d_budget_sp->policy() : budget_policy::backpressure;
+}
+
+}
+//!\endcond
+
+}
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
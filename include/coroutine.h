@@ -0,0 +1,758 @@
+#if !defined(FLOW_COROUTINE_H)
+	 #define FLOW_COROUTINE_H
+
+#include "node.h"
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+//!\brief Defined when the compiler supports C++20 coroutines and the coroutine nodes are available.
+#define FLOW_COROUTINES
+#endif
+
+#if defined(FLOW_COROUTINES)
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#endif
+
+//!\file coroutine.h
+//!
+//!\brief Defines the \ref flow::co_producer, \ref flow::co_transformer and \ref flow::co_consumer classes, nodes written as C++20 coroutines.
+//!
+//! This header requires a compiler that supports C++20 coroutines. It defines nothing otherwise.
+
+#if defined(FLOW_COROUTINES)
+
+namespace flow
+{
+
+//!\brief The coroutine that is the body of a coroutine node.
+//!
+//! A routine starts suspended. The node resumes it when what it awaits is available and it runs until it awaits again.
+class routine
+{
+public:
+	//!\brief The promise of a routine.
+	struct promise_type
+	{
+		routine get_return_object()
+		{
+			return routine(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+
+		std::suspend_always initial_suspend() noexcept { return std::suspend_always(); }
+
+		std::suspend_always final_suspend() noexcept { return std::suspend_always(); }
+
+		void return_void() {}
+
+		//!\brief The exception reaches whoever resumed the routine, i.e. the node's thread.
+		void unhandled_exception() { throw; }
+	};
+
+private:
+	std::coroutine_handle<promise_type> d_handle;
+
+	explicit routine(std::coroutine_handle<promise_type> handle) : d_handle(handle) {}
+
+	routine(const routine&);
+	routine& operator=(const routine&);
+
+public:
+	routine() {}
+
+	routine(routine&& routine_rr) : d_handle(std::exchange(routine_rr.d_handle, nullptr)) {}
+
+	routine& operator=(routine&& routine_rr)
+	{
+		if(this != &routine_rr)
+		{
+			if(d_handle) d_handle.destroy();
+			d_handle = std::exchange(routine_rr.d_handle, nullptr);
+		}
+
+		return *this;
+	}
+
+	~routine()
+	{
+		if(d_handle) d_handle.destroy();
+	}
+
+	//!\brief Whether there is a coroutine.
+	explicit operator bool() const
+	{
+		return static_cast<bool>(d_handle);
+	}
+
+	//!\brief Whether the coroutine has returned.
+	bool done() const
+	{
+		return d_handle.done();
+	}
+
+	//!\brief Runs the coroutine until it awaits or returns.
+	void resume()
+	{
+		d_handle.resume();
+	}
+};
+
+//!\cond
+namespace detail
+{
+
+// Something a routine waits for.
+class co_condition
+{
+public:
+	virtual ~co_condition() {}
+
+	// Whether the routine can be resumed. Must not change anything, it is also checked by threads other than the node's.
+	virtual bool satisfied() const = 0;
+};
+
+// Wakes nodes whose routines sleep, on a single thread shared by all of them.
+class alarm
+{
+	typedef std::chrono::steady_clock clock_type;
+
+	std::multimap<clock_type::time_point, node*> d_alarms;
+
+	bool d_quit;
+	std::condition_variable d_changed_cv;
+	std::mutex d_m;
+
+	std::thread d_thread;
+
+	alarm() : d_quit(false), d_thread([this]{ this->run(); }) {}
+
+	alarm(const alarm&);
+	alarm& operator=(const alarm&);
+
+	void run()
+	{
+		std::unique_lock<std::mutex> ul(d_m);
+
+		while(!d_quit)
+		{
+			if(d_alarms.empty())
+			{
+				d_changed_cv.wait(ul);
+			}
+			else if(d_alarms.begin()->first <= clock_type::now())
+			{
+				// Waking under the lock keeps cancel from returning while a node is being woken.
+				d_alarms.begin()->second->wake();
+				d_alarms.erase(d_alarms.begin());
+			}
+			else
+			{
+				d_changed_cv.wait_until(ul, d_alarms.begin()->first);
+			}
+		}
+	}
+
+public:
+	~alarm()
+	{
+		{
+			std::lock_guard<std::mutex> lg(d_m);
+			d_quit = true;
+			d_changed_cv.notify_one();
+		}
+
+		d_thread.join();
+	}
+
+	static alarm& instance()
+	{
+		static alarm a;
+		return a;
+	}
+
+	// Wakes a node at a point in time.
+	void set(const clock_type::time_point& when, node *node_p)
+	{
+		std::lock_guard<std::mutex> lg(d_m);
+
+		if(d_alarms.empty() || when < d_alarms.begin()->first)
+		{
+			d_changed_cv.notify_one();
+		}
+
+		d_alarms.insert(std::make_pair(when, node_p));
+	}
+
+	// Forgets all alarms of a node. The node is not woken once this returns.
+	void cancel(node *node_p)
+	{
+		std::lock_guard<std::mutex> lg(d_m);
+
+		for(auto i = d_alarms.begin(); i != d_alarms.end();)
+		{
+			if(i->second == node_p)
+			{
+				i = d_alarms.erase(i);
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+};
+
+// Runs the routine of a coroutine node.
+// The routine is resumed by the node's thread of execution, or by the scheduler, whenever what it awaits is available.
+class co_driver
+{
+	node *d_node_p;
+
+	routine d_routine;
+	co_condition *d_awaited_p;		// What the suspended routine waits for. Null if it can be resumed right away.
+	std::atomic<bool> d_reset_a;	// Set when the node is stopped. The routine will start over.
+
+	mutable std::mutex d_resume_m;	// Held while the routine is reset or resumed.
+
+	co_driver(const co_driver&);
+	co_driver& operator=(const co_driver&);
+
+protected:
+	// An awaitable that suspends the routine until a condition is satisfied.
+	// Conditions are checked by whichever thread asks whether the node is runnable and must not block.
+	template<typename Derived>
+	class awaitable : public co_condition
+	{
+	protected:
+		co_driver &d_driver_r;
+
+	public:
+		awaitable(co_driver& driver_r) : d_driver_r(driver_r) {}
+
+		bool await_ready()
+		{
+			return static_cast<Derived*>(this)->satisfied();
+		}
+
+		void await_suspend(std::coroutine_handle<>)
+		{
+			d_driver_r.d_awaited_p = this;
+			static_cast<Derived*>(this)->suspended();
+		}
+
+		void suspended() {}
+	};
+
+	// Satisfied at a point in time.
+	class alarm_awaitable : public awaitable<alarm_awaitable>
+	{
+		std::chrono::steady_clock::time_point d_when;
+
+	public:
+		alarm_awaitable(co_driver& driver_r, const std::chrono::steady_clock::time_point& when) : awaitable<alarm_awaitable>(driver_r), d_when(when) {}
+
+		virtual bool satisfied() const
+		{
+			return std::chrono::steady_clock::now() >= d_when;
+		}
+
+		void suspended()
+		{
+			alarm::instance().set(d_when, this->d_driver_r.d_node_p);
+		}
+
+		void await_resume() {}
+	};
+
+	// Always satisfied, yet suspends.
+	class yield_awaitable : public awaitable<yield_awaitable>
+	{
+	public:
+		yield_awaitable(co_driver& driver_r) : awaitable<yield_awaitable>(driver_r) {}
+
+		virtual bool satisfied() const
+		{
+			return true;
+		}
+
+		bool await_ready()
+		{
+			return false;
+		}
+
+		void await_resume() {}
+	};
+
+	// Satisfied when an outpin has room.
+	template<typename T>
+	class room_awaitable : public awaitable<room_awaitable<T>>
+	{
+		outpin<T> &d_outpin_r;
+
+	public:
+		room_awaitable(co_driver& driver_r, outpin<T>& outpin_r) : awaitable<room_awaitable<T>>(driver_r), d_outpin_r(outpin_r) {}
+
+		virtual bool satisfied() const
+		{
+			return !d_outpin_r.full();
+		}
+
+		void await_resume() {}
+	};
+
+	// Satisfied when a packet is waiting at an inpin, which is then popped.
+	template<typename T>
+	class packet_awaitable : public awaitable<packet_awaitable<T>>
+	{
+		inpin<T> &d_inpin_r;
+
+	public:
+		packet_awaitable(co_driver& driver_r, inpin<T>& inpin_r) : awaitable<packet_awaitable<T>>(driver_r), d_inpin_r(inpin_r) {}
+
+		virtual bool satisfied() const
+		{
+			return d_inpin_r.peek();
+		}
+
+		std::unique_ptr<packet<T>> await_resume()
+		{
+			return d_inpin_r.pop();
+		}
+	};
+
+	// Satisfied when a packet is waiting at any inpin of a consumer, whose index is then returned.
+	template<typename T>
+	class any_awaitable : public awaitable<any_awaitable<T>>
+	{
+		flow::consumer<T> &d_consumer_r;
+
+		// The index of the first inpin at which a packet is waiting, ins() if none.
+		size_t first() const
+		{
+			size_t i = 0;
+			while(i != d_consumer_r.ins() && !d_consumer_r.input(i).peek()) ++i;
+
+			return i;
+		}
+
+	public:
+		any_awaitable(co_driver& driver_r, flow::consumer<T>& consumer_r) : awaitable<any_awaitable<T>>(driver_r), d_consumer_r(consumer_r) {}
+
+		virtual bool satisfied() const
+		{
+			return first() != d_consumer_r.ins();
+		}
+
+		// Only the node pops its inpins, so the packet that satisfied the routine is still there.
+		size_t await_resume()
+		{
+			return first();
+		}
+	};
+
+	// Whether the routine will start over or has not returned and what it awaits, if anything, is available.
+	// d_resume_m must be held.
+	bool ready() const
+	{
+		if(d_reset_a || !d_routine)
+		{
+			return true;
+		}
+
+		return !d_routine.done() && (!d_awaited_p || d_awaited_p->satisfied());
+	}
+
+	// Whether resume() would resume the routine. Changes nothing, so any thread may ask.
+	//
+	// Returns false while another thread resumes the routine. That thread is stepping the node and asks again when it is done.
+	bool resumable() const
+	{
+		std::unique_lock<std::mutex> ul(d_resume_m, std::try_to_lock);
+
+		return ul.owns_lock() && ready();
+	}
+
+	// Resumes the routine, making it first if the node was just started or stopped.
+	// Only called by the thread that steps the node.
+	//
+	// Returns false if it could not be resumed.
+	bool resume()
+	{
+		std::lock_guard<std::mutex> lg(d_resume_m);
+
+		if(d_reset_a.exchange(false))
+		{
+			alarm::instance().cancel(d_node_p);
+
+			d_routine = routine();
+			d_awaited_p = nullptr;
+		}
+
+		if(!ready())
+		{
+			return false;
+		}
+
+		if(!d_routine)
+		{
+			d_routine = run();
+		}
+
+		d_awaited_p = nullptr;
+		d_routine.resume();
+
+		return true;
+	}
+
+	// Makes the routine start over the next time it is resumed.
+	// Its alarms are forgotten right away, so a stopped node is not woken by one on a scheduler that may be gone.
+	void reset()
+	{
+		d_reset_a = true;
+
+		alarm::instance().cancel(d_node_p);
+	}
+
+	// Forgets the node's alarms. Called by the destructors of the concrete nodes, before the node is torn down.
+	void cancel()
+	{
+		alarm::instance().cancel(d_node_p);
+	}
+
+	// The body of the node.
+	virtual routine run() = 0;
+
+public:
+	co_driver(node *node_p) : d_node_p(node_p), d_awaited_p(nullptr), d_reset_a(false) {}
+
+	virtual ~co_driver() {}
+};
+
+}
+//!\endcond
+
+//!\brief Base class from which concrete producers written as coroutines derive.
+//!
+//! Instead of produce(), concrete classes implement run(), a coroutine that typically loops forever.
+//! It can co_await \ref sleep_for, \ref sleep_until, \ref room and \ref yield.
+//! While it is suspended, the node takes no thread: on a scheduler, it is only queued again once what it awaits is available.
+//! Any number of coroutine nodes can thus share a handful of threads, with no condition variable of their own.
+//!
+//! The routine starts over when the node is stopped and started again.
+//!
+//!\tparam T The type of data this node produces.
+template<typename T>
+class co_producer : public producer<T>, protected detail::co_driver
+{
+	virtual void produce() {}
+
+protected:
+	//!\brief Suspends the routine for a while.
+	template<typename Rep, typename Period>
+	alarm_awaitable sleep_for(const std::chrono::duration<Rep, Period>& duration)
+	{
+		return alarm_awaitable(*this, std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+	}
+
+	//!\brief Suspends the routine until a point in time.
+	alarm_awaitable sleep_until(const std::chrono::steady_clock::time_point& when)
+	{
+		return alarm_awaitable(*this, when);
+	}
+
+	//!\brief Suspends the routine until an outpin's pipe has room.
+	//!
+	//! Room is signaled by pipes whose overflow policy is overflow::block.
+	//!
+	//!\param n The index of the output pin.
+	room_awaitable<T> room(const size_t n)
+	{
+		return room_awaitable<T>(*this, producer<T>::output(n));
+	}
+
+	//!\brief Suspends the routine and resumes it on the node's next turn, letting other nodes run meanwhile.
+	yield_awaitable yield()
+	{
+		return yield_awaitable(*this);
+	}
+
+	//!\brief Implementation of node::operator()().
+	//!
+	//! Resumes the routine whenever what it awaits is available and sleeps in between.
+	virtual void operator()()
+	{
+		state::type s(node::state());
+
+		while(s != state::stopped)
+		{
+			if(s == state::paused)
+			{
+				detail::stopwatch sw(node::d_waiting_ns);
+				std::unique_lock<std::mutex> ul(node::d_transition_m);
+				node::d_transition_cv.wait(ul, [&s, this](){ return (s = this->state()) != state::paused; });
+			}
+			else if(s == state::started)
+			{
+				const unsigned ticket = node::d_wakeup_e.ticket();
+
+				bool resumed;
+				{
+					detail::stopwatch sw(node::d_busy_ns);
+					resumed = resume();
+				}
+
+				if(!resumed && node::state() == state::started)
+				{
+					detail::stopwatch sw(node::d_waiting_ns);
+					node::d_wakeup_e.wait(ticket);
+				}
+			}
+
+			s = node::state();
+		}
+	}
+
+	//!\brief Resumes the routine once, when the node runs on a scheduler.
+	virtual void step()
+	{
+		if(node::state() == state::started)
+		{
+			detail::stopwatch sw(node::d_busy_ns);
+			resume();
+		}
+	}
+
+	//!\brief A started coroutine producer has something to do when what its routine awaits is available.
+	virtual bool runnable()
+	{
+		return node::state() == state::started && resumable();
+	}
+
+public:
+	//!\param name_r The name to give this node.
+	//!\param outs Numbers of output pins.
+	co_producer(const std::string& name_r, const size_t outs) : node(name_r), producer<T>(name_r, outs), detail::co_driver(this) {}
+
+	virtual ~co_producer()
+	{
+		cancel();
+	}
+
+	//!\brief Implementation of node::stopped(). The routine will start over.
+	virtual void stopped()
+	{
+		reset();
+	}
+};
+
+//!\brief Base class from which concrete consumers written as coroutines derive.
+//!
+//! Instead of ready(), concrete classes implement run(), a coroutine that typically loops forever.
+//! It can co_await \ref next, \ref any, \ref sleep_for, \ref sleep_until and \ref yield.
+//! While it is suspended, the node takes no thread: on a scheduler, it is only queued again once what it awaits is available.
+//!
+//! The routine starts over when the node is stopped and started again.
+//!
+//!\tparam T The type of data this node consumes.
+template<typename T>
+class co_consumer : public consumer<T>, protected detail::co_driver
+{
+	virtual void ready(size_t) {}
+
+protected:
+	//!\brief Suspends the routine for a while.
+	template<typename Rep, typename Period>
+	alarm_awaitable sleep_for(const std::chrono::duration<Rep, Period>& duration)
+	{
+		return alarm_awaitable(*this, std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+	}
+
+	//!\brief Suspends the routine until a point in time.
+	alarm_awaitable sleep_until(const std::chrono::steady_clock::time_point& when)
+	{
+		return alarm_awaitable(*this, when);
+	}
+
+	//!\brief Suspends the routine until a packet is waiting at an inpin and pops it.
+	//!
+	//!\param n The index of the input pin.
+	packet_awaitable<T> next(const size_t n)
+	{
+		return packet_awaitable<T>(*this, consumer<T>::input(n));
+	}
+
+	//!\brief Suspends the routine until a packet is waiting at any inpin and returns the index of that inpin.
+	any_awaitable<T> any()
+	{
+		return any_awaitable<T>(*this, *this);
+	}
+
+	//!\brief Suspends the routine and resumes it on the node's next turn, letting other nodes run meanwhile.
+	yield_awaitable yield()
+	{
+		return yield_awaitable(*this);
+	}
+
+	//!\brief Resumes the routine if what it awaits is available.
+	//!
+	//! This is what consumer::operator()(), consumer::step() and fused runs call.
+	virtual bool service()
+	{
+		return resume();
+	}
+
+	//!\brief A started coroutine consumer has something to do when what its routine awaits is available.
+	virtual bool runnable()
+	{
+		return node::state() == state::started && resumable();
+	}
+
+public:
+	//!\param name_r The name to give this node.
+	//!\param ins Numbers of input pins.
+	co_consumer(const std::string& name_r, const size_t ins) : node(name_r), consumer<T>(name_r, ins), detail::co_driver(this) {}
+
+	virtual ~co_consumer()
+	{
+		cancel();
+	}
+
+	//!\brief Implementation of node::stopped(). The routine will start over.
+	virtual void stopped()
+	{
+		reset();
+	}
+};
+
+//!\brief Base class from which concrete transformers written as coroutines derive.
+//!
+//! Instead of ready(), concrete classes implement run(), a coroutine that typically loops forever.
+//! It can co_await \ref next, \ref any, \ref room, \ref sleep_for, \ref sleep_until and \ref yield.
+//! While it is suspended, the node takes no thread: on a scheduler, it is only queued again once what it awaits is available.
+//!
+//! The routine starts over when the node is stopped and started again.
+//!
+//!\tparam C The type of data this node consumes.
+//!\tparam P The type of data this node produces.
+template<typename C, typename P>
+class co_transformer : public transformer<C, P>, protected detail::co_driver
+{
+	virtual void ready(size_t) {}
+
+protected:
+	//!\brief Suspends the routine for a while.
+	template<typename Rep, typename Period>
+	alarm_awaitable sleep_for(const std::chrono::duration<Rep, Period>& duration)
+	{
+		return alarm_awaitable(*this, std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+	}
+
+	//!\brief Suspends the routine until a point in time.
+	alarm_awaitable sleep_until(const std::chrono::steady_clock::time_point& when)
+	{
+		return alarm_awaitable(*this, when);
+	}
+
+	//!\brief Suspends the routine until a packet is waiting at an inpin and pops it.
+	//!
+	//!\param n The index of the input pin.
+	packet_awaitable<C> next(const size_t n)
+	{
+		return packet_awaitable<C>(*this, consumer<C>::input(n));
+	}
+
+	//!\brief Suspends the routine until a packet is waiting at any inpin and returns the index of that inpin.
+	any_awaitable<C> any()
+	{
+		return any_awaitable<C>(*this, *this);
+	}
+
+	//!\brief Suspends the routine until an outpin's pipe has room.
+	//!
+	//! Room is signaled by pipes whose overflow policy is overflow::block.
+	//!
+	//!\param n The index of the output pin.
+	room_awaitable<P> room(const size_t n)
+	{
+		return room_awaitable<P>(*this, producer<P>::output(n));
+	}
+
+	//!\brief Suspends the routine and resumes it on the node's next turn, letting other nodes run meanwhile.
+	yield_awaitable yield()
+	{
+		return yield_awaitable(*this);
+	}
+
+	//!\brief Resumes the routine if what it awaits is available.
+	//!
+	//! This is what consumer::operator()(), consumer::step() and fused runs call.
+	virtual bool service()
+	{
+		return resume();
+	}
+
+	//!\brief A started coroutine transformer has something to do when what its routine awaits is available.
+	virtual bool runnable()
+	{
+		return node::state() == state::started && resumable();
+	}
+
+public:
+	//!\param name_r The name to give this node.
+	//!\param ins Numbers of input pins.
+	//!\param outs Numbers of output pins.
+	co_transformer(const std::string& name_r, const size_t ins, const size_t outs) : node(name_r), transformer<C, P>(name_r, ins, outs), detail::co_driver(this) {}
+
+	virtual ~co_transformer()
+	{
+		cancel();
+	}
+
+	//!\brief Implementation of node::stopped(). The routine will start over.
+	virtual void stopped()
+	{
+		reset();
+	}
+};
+
+}
+
+#endif
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,206 @@
+#if !defined(FLOW_DELIVERY_H)
+	 #define FLOW_DELIVERY_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+//!\file delivery.h
+//!
+//!\brief Defines the \ref flow::delivery class.
+
+namespace flow
+{
+
+class delivery;
+
+//!\cond
+namespace detail
+{
+
+// Something that holds packets until their consumption time. Registered with a delivery.
+class timed
+{
+	friend class flow::delivery;
+
+protected:
+	typedef std::chrono::high_resolution_clock::time_point time_point_type;
+
+	// Releases the packets that are due at now.
+	// Returns the earliest consumption time of the packets still held, or time_point_type() if there are none.
+	virtual time_point_type release(const time_point_type& now) = 0;
+
+public:
+	virtual ~timed() {}
+};
+
+}
+//!\endcond
+
+//!\brief Releases timestamped packets held by many nodes when their consumption time comes.
+//!
+//! Nodes that hold packets, such as \ref samples::generic::deliverer "deliverer", tell a delivery when their earliest packet is due.
+//! A single delivery, and the single thread that runs it, serves any number of such nodes, so none of them has to block.
+//!
+//! Like a \ref timer, a delivery runs on a thread given to it by the user and returns from operator()() once stopped.
+class delivery
+{
+	typedef detail::timed::time_point_type time_point_type;
+	typedef std::multimap<time_point_type, detail::timed*> deadlines_t;
+
+	std::atomic<bool> d_stop_a;
+
+	deadlines_t d_deadlines;								// The earliest deadline of every node, earliest first.
+	std::map<detail::timed*, deadlines_t::iterator> d_scheduled;	// Where each node is in d_deadlines.
+	detail::timed *d_releasing_p;							// The node being released outside the lock.
+
+	std::condition_variable d_changed_cv;	// Notified when stopped, when a deadline is scheduled and when a release ends.
+	std::mutex d_m;
+
+	delivery(const delivery&);
+	delivery& operator=(const delivery&);
+
+	// Schedules a node at deadline, unless it is already scheduled earlier. d_m must be held.
+	bool schedule_locked(detail::timed* timed_p, const time_point_type& deadline)
+	{
+		auto s = d_scheduled.find(timed_p);
+		if(s != d_scheduled.end())
+		{
+			if(s->second->first <= deadline) return false;
+
+			d_deadlines.erase(s->second);
+			s->second = d_deadlines.insert(std::make_pair(deadline, timed_p));
+		}
+		else
+		{
+			d_scheduled[timed_p] = d_deadlines.insert(std::make_pair(deadline, timed_p));
+		}
+
+		return true;
+	}
+
+public:
+	delivery() : d_stop_a(false), d_releasing_p(nullptr) {}
+
+	virtual ~delivery() {}
+
+	//!\brief Returns true if the delivery is stopped.
+	virtual bool stopped() const
+	{
+		return d_stop_a;
+	}
+
+	//!\brief Stops the delivery.
+	virtual void stop()
+	{
+		d_stop_a = true;
+
+		std::lock_guard<std::mutex> lg(d_m);
+		d_changed_cv.notify_all();
+	}
+
+	//!\brief Asks for a node to release its packets at deadline.
+	//!
+	//! Does nothing if the node is already to be released earlier.
+	void schedule(detail::timed* timed_p, const time_point_type& deadline)
+	{
+		std::lock_guard<std::mutex> lg(d_m);
+		if(schedule_locked(timed_p, deadline))
+		{
+			d_changed_cv.notify_all();
+		}
+	}
+
+	//!\brief Forgets a node.
+	//!
+	//! Waits for the node to be done releasing if it is being released. The node will not be released again.
+	void cancel(detail::timed* timed_p)
+	{
+		std::unique_lock<std::mutex> ul(d_m);
+		d_changed_cv.wait(ul, [this, timed_p](){ return d_releasing_p != timed_p; });
+
+		auto s = d_scheduled.find(timed_p);
+		if(s != d_scheduled.end())
+		{
+			d_deadlines.erase(s->second);
+			d_scheduled.erase(s);
+		}
+	}
+
+	//!\brief Execution function.
+	//!
+	//! Releases nodes as their deadlines come until stopped.
+	//! Nodes are released without holding the lock, they may schedule themselves from other threads meanwhile.
+	virtual void operator()()
+	{
+		std::unique_lock<std::mutex> ul(d_m);
+
+		while(!stopped())
+		{
+			if(d_deadlines.empty())
+			{
+				d_changed_cv.wait(ul);
+				continue;
+			}
+
+			const time_point_type next = d_deadlines.begin()->first;
+			const time_point_type now = std::chrono::high_resolution_clock::now();
+			if(now < next)
+			{
+				d_changed_cv.wait_until(ul, next);
+				continue;
+			}
+
+			detail::timed *timed_p = d_deadlines.begin()->second;
+			d_deadlines.erase(d_deadlines.begin());
+			d_scheduled.erase(timed_p);
+			d_releasing_p = timed_p;
+
+			ul.unlock();
+			const time_point_type later = timed_p->release(now);
+			ul.lock();
+
+			if(later != time_point_type())
+			{
+				schedule_locked(timed_p, later);
+			}
+
+			d_releasing_p = nullptr;
+			d_changed_cv.notify_all();
+		}
+	}
+};
+
+}
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,160 @@
+#if !defined(FLOW_EVENT_H)
+	 #define FLOW_EVENT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+//!\file event.h
+//!
+//!\brief Defines the \ref flow::event class.
+
+namespace flow
+{
+
+//!\cond
+namespace detail
+{
+
+// Hints the processor that we are busy-waiting.
+inline void relax()
+{
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	__builtin_ia32_pause();
+#endif
+}
+
+}
+//!\endcond
+
+//!\brief Signals a single waiting thread that something has happened.
+//!
+//! This is an event count.
+//! The waiting thread takes a ticket, checks whether there is work to do and, if there is not, waits with that ticket.
+//! Any notification that comes after the ticket was taken ends the wait, so none can be missed.
+//!
+//! The waiting thread first polls for a configurable number of times, then yields for a configurable number of times and finally sleeps.
+//! Notifying costs a single atomic operation unless the waiting thread is sleeping.
+class event
+{
+	std::atomic<unsigned> d_epoch_a;	// Incremented by every notification.
+	std::atomic<bool> d_armed_a;		// True while the waiting thread is sleeping or about to.
+
+	std::atomic<size_t> d_spins_a;
+	std::atomic<size_t> d_yields_a;
+
+	std::condition_variable d_cv;
+	std::mutex d_m;
+
+	event(const event&);
+	event& operator=(const event&);
+
+	bool notified(const unsigned ticket) const
+	{
+		return d_epoch_a.load(std::memory_order_acquire) != ticket;
+	}
+
+public:
+	//!\param spins The number of times to poll before yielding.
+	//!\param yields The number of times to yield before sleeping.
+	event(const size_t spins = 0, const size_t yields = 0) : d_epoch_a(0), d_armed_a(false), d_spins_a(spins), d_yields_a(yields) {}
+
+	virtual ~event() {}
+
+	//!\brief Sets how long to busy-wait before sleeping.
+	//!
+	//! Busy-waiting lowers latency at the cost of CPU time.
+	//!
+	//!\param spins The number of times to poll before yielding.
+	//!\param yields The number of times to yield before sleeping.
+	virtual void spin(const size_t spins, const size_t yields = 0)
+	{
+		d_spins_a = spins;
+		d_yields_a = yields;
+	}
+
+	//!\brief Takes a ticket to be given to wait().
+	//!
+	//! Must be called before checking whether there is work to do.
+	unsigned ticket() const
+	{
+		return d_epoch_a.load(std::memory_order_acquire);
+	}
+
+	//!\brief Waits until notify() is called after the ticket was taken.
+	//!
+	//! Returns immediately if that already happened.
+	void wait(const unsigned ticket)
+	{
+		for(size_t i = d_spins_a.load(std::memory_order_relaxed); i; --i)
+		{
+			if(notified(ticket)) return;
+
+			detail::relax();
+		}
+
+		for(size_t i = d_yields_a.load(std::memory_order_relaxed); i; --i)
+		{
+			if(notified(ticket)) return;
+
+			std::this_thread::yield();
+		}
+
+		std::unique_lock<std::mutex> ul(d_m);
+
+		d_armed_a.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		d_cv.wait(ul, [this, ticket](){ return this->notified(ticket); });
+
+		d_armed_a.store(false, std::memory_order_relaxed);
+	}
+
+	//!\brief Ends the current or next wait.
+	//!
+	//! Only locks the mutex and notifies the condition variable if the waiting thread is sleeping.
+	void notify()
+	{
+		d_epoch_a.fetch_add(1, std::memory_order_release);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if(d_armed_a.load(std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lg(d_m);
+			d_cv.notify_one();
+		}
+	}
+};
+
+}
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
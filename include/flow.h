@@ -29,12 +29,28 @@
 #if !defined(FLOW_FLOW_H)
 	 #define FLOW_FLOW_H
 
+#include "affinity.h"
+#include "batch.h"
+#include "budget.h"
+#include "coroutine.h"
+#include "delivery.h"
+#include "event.h"
 #include "graph.h"
+#include "join.h"
+#include "metrics.h"
 #include "named.h"
+#include "net.h"
 #include "node.h"
 #include "packet.h"
+#include "parallel.h"
 #include "pipe.h"
+#include "pipeline.h"
+#include "pool.h"
+#include "scheduler.h"
+#include "shared.h"
+#include "shm.h"
 #include "timer.h"
+#include "trace.h"
 
 #endif
 
@@ -91,12 +107,69 @@ This implementation:
 When flowing through the graph, \ref flow::packet "data packets" are wrapped in std::unique_ptr. 
 This helps memory managment tremendously and enforces the idea that, at any point in time, only a single entity -pipe or node- is responsible for a data packet.
 
+Producing nodes should make their packets with \ref flow::producer::make_packet "make_packet".
+Such packets are still wrapped in std::unique_ptr but their memory comes from the node's \ref flow::packet_pool "packet_pool".
+When they are deleted, their memory is recycled instead of being returned to the global allocator.
+
+Large payloads that are broadcast to many nodes can be wrapped in \ref flow::shared "shared".
+Copying a packet<shared<T>> only adds a reference to its payload, which is copied only if one of the nodes modifies it.
+
+Small payloads can go without the consumption time and the virtual destructor packets have by default.
+Specializing \ref flow::packet_traits "packet_traits" as a \ref flow::slim_packet "slim_packet" makes a packet no larger than its data.
+Numeric streams can instead carry many values per packet in a \ref flow::batch "batch", whose arithmetic operators vectorize.
+The \ref flow::samples::math "math" sample nodes then operate on whole batches.
+
 \subsection thread_per_node A thread per node
 
 flow is multi-threaded in that the \ref flow::graph "graph" assigns a thread of execution to each of its nodes.
 The lifetime of these threads is taken care by \ref flow::graph "graph".
 As a library user, the only mutli-threaded code you would write is whatever a node would require to perform its work.
 
+A consumer node waiting for packets sleeps on an \ref flow::event "event".
+Notifying it costs a single atomic operation unless it is actually sleeping.
+Latency-critical nodes can be made to busy-wait for a while before sleeping with \ref flow::node::spin "spin".
+
+A consumer with many inputs visits them in turn, once each, by default.
+Its \ref flow::consumer::set_order "service order" can instead favor the inputs of highest \ref flow::inpin::priority "priority",
+visit each input as many times as its \ref flow::inpin::share "share" or take the input whose next packet has the earliest consumption time.
+Priorities and shares are given to inputs as they are connected with \ref flow::graph::connect "graph::connect",
+so that control traffic does not wait behind bulk data inside the same node.
+
+A run of transformers with a single input and a single output, connected by pipes with no maximum length or weight, shares a single thread.
+When the graph is started, such runs are fused: a packet goes through all the transformers of the run without a context switch.
+
+A transformer that cannot keep up can be replicated with \ref flow::parallel "parallel", each replica running on a thread of its own.
+A \ref flow::splitter "splitter" gives each packet to one replica, in turn or to the least loaded one,
+and a \ref flow::merger "merger" gathers the transformed packets, in the order they came in unless told otherwise.
+
+A graph constructed with \ref flow::execution::pooled "execution::pooled" runs its nodes on a \ref flow::scheduler "scheduler" instead.
+The scheduler is a fixed-size pool of threads, one per core by default.
+A node is queued on it when it has work to do: a started producer produces one packet per turn, a consumer services its inpins when packets arrive.
+Nodes that \ref flow::node::blocks "block" on something other than their input pins still get a thread of their own.
+Generators are driven by a \ref flow::timer "timer" running on a thread of its own.
+Any number of generators running at different rates can share a single \ref flow::multirate_timer "multirate_timer".
+
+With a compiler that supports C++20, nodes can be written as coroutines by deriving from \ref flow::co_producer "co_producer",
+\ref flow::co_transformer "co_transformer" or \ref flow::co_consumer "co_consumer".
+Their body is a single \ref flow::routine "routine" that co_awaits packets, room in a pipe or the passing of time.
+A suspended routine holds no thread and no condition variable, so thousands of such nodes can share the threads of a scheduler.
+
+Stages that always follow one another can be composed at compile time with \ref flow::pipeline "pipeline" instead.
+The resulting \ref flow::static_pipeline "static_pipeline" calls its stages directly, on a single thread, and can be wrapped in a single node of a graph.
+
+Threads can be pinned to sets of CPUs, node by node with \ref flow::graph::pin "graph::pin" and scheduler thread by scheduler thread with \ref flow::graph::pin_worker "graph::pin_worker".
+\ref flow::graph::place "graph::place" pins the nodes at both ends of the busiest pipes to the same set of CPUs, a NUMA node for instance.
+Packet pools allocate on the thread of the producer, so memory ends up local to the CPUs it runs on.
+
+Graphs of different processes on the same host are connected through a \ref flow::shm_ring "shm_ring", a ring of trivially copyable records in a named shared-memory segment.
+Connecting an outpin or an inpin to a segment's name adds a \ref flow::shm_sink "shm_sink" or a \ref flow::shm_source "shm_source" to the graph.
+Records are copied straight into the segment and an end only makes a system call when it has to wait for the other.
+Graphs on different hosts are connected over TCP by a \ref flow::net_sink "net_sink" and a \ref flow::net_source "net_source".
+Packets travel in frames, as many per frame as are waiting, and the receiving side grants credits as it pushes them downstream,
+so its pipes throttle the sending side as they would a local producer.
+Data is turned into bytes by a \ref flow::serializer "serializer", which copies trivially copyable data as is and can be specialized for other types.
+\ref flow::graph::to_dot "graph::to_dot" draws the endpoints of these nodes as remote edges.
+
 \subsection node_state Node state
 
 A node can be in one of three states: \ref flow::state::paused "paused", \ref flow::state::started "started" or \ref flow::state::stopped "stopped".
@@ -111,6 +184,11 @@ Before a node can transition to a new state, it must be added to a graph.
 Transitioning between these states is done by calling a corresponding member function of the \ref flow::graph "graph" class.
 For this relase, all nodes in a graph are always in the same state.
 Regardless of the nodes' state, nodes can be added to and removed from a graph at any time and can be connected to and disconnected from another node at any time.
+To redeploy part of a running graph, record the changes in a \ref flow::graph::update "graph::update" and \ref flow::graph::apply "apply" them at once.
+The update is checked as a whole before anything changes, and only the nodes it touches are stopped and restarted.
+
+\ref flow::graph::stop "stop" stops nodes right away, leaving whatever packets are in flight in the pipes.
+\ref flow::graph::drain "drain" stops the producers and lets the packets in flight reach the consumers first, for at most a given time, and reports what was left behind.
 
 \subsection consumption_time Packet consumption time
 
@@ -122,6 +200,31 @@ When a data packet with an assigned consumption time arrives at a consumer node
 Node that consumption time is optional. 
 Data packets with no consumption time are consumed as soon as they reach a consumer node.
 
+A consumer that waits for consumption times cannot consume anything else meanwhile, even packets that arrive later but are due earlier.
+Placing a \ref flow::samples::generic::deliverer "deliverer" in front of it lets it consume packets as they arrive instead.
+Deliverers hold packets ordered by consumption time and a single \ref flow::delivery "delivery" thread releases them, for all deliverers, when they are due.
+
+Nodes that combine one packet from each of their inputs derive from \ref flow::join "join".
+A join only visits the inputs at which packets arrived and knows in constant time whether every input has a packet, however many inputs it has.
+With \ref flow::alignment::timestamp "alignment::timestamp", it only combines packets that have the same consumption time.
+
+\subsection metrics Metrics
+
+Every pipe counts the packets pushed to it, the packets it dropped for lack of room and the greatest length it reached.
+Every node measures the time it spends busy producing and consuming packets and the time it spends waiting.
+These counters are always enabled and cost little: they are only ever updated by a single thread.
+A snapshot of them all is taken with \ref flow::graph::metrics "graph::metrics", even while the graph is running.
+
+The bytes held by all pipes of a graph together can be bounded with \ref flow::graph::budget "graph::budget", wherever the packets pile up.
+Once the budget is exhausted, its \ref flow::budget_policy::type "policy" throttles the pipe holding the most bytes,
+sheds the packets pushed to the pipes of lowest \ref flow::graph::prioritize "priority" or drops the oldest packets of a pipe to make room.
+The snapshot tells how much of the budget is used and how many packets were refused or shed.
+
+Where the counters tell how much, a trace tells when. Defining \c FLOW_TRACE before including flow compiles in hooks that record
+every push and pop, every call to produce() and ready() and every state change in a ring per thread.
+\ref flow::graph::to_trace "graph::to_trace" writes them as a trace that chrome://tracing and Perfetto open, with an arrow from the push of each packet to its pop.
+Without \c FLOW_TRACE, the hooks compile to nothing.
+
 \subsection named_things Named building blocks
 
 All classes in flow, including the \ref flow::node "node" base class, derive from \ref flow::named "named".
@@ -130,10 +233,14 @@ This feature serves two purposes:
  - nodes can be refered to by their names when building a graph, improving code readability greatly.
  - helps debugging, especially since all pins and pipes are also named and have names automatically generated based on what they are connected to.
 
+Pins are named after their node and their index, e.g. \c adder_in12, and pipes after the pins they connect.
+Finding a node by name takes a single hash lookup, so graphs of many thousands of nodes are built in time proportional to their size.
+When the size is known ahead of time, \ref flow::graph::reserve "graph::reserve" spares the rehashing as nodes are added.
+
 \section samples Samples concrete nodes
 
 As convenience, a small collection of concrete nodes is provided. 
-They are found in the \ref flow::samples::generic and \ref flow::samples::math namespaces.
+They are found in the \ref flow::samples::generic, \ref flow::samples::io and \ref flow::samples::math namespaces.
 
 \section examples Examples
 
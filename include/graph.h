@@ -1,14 +1,30 @@
 #if !defined(FLOW_GRAPH_H)
 	 #define FLOW_GRAPH_H
 
+#include "affinity.h"
+#include "metrics.h"
 #include "named.h"
 #include "node.h"
+#include "parallel.h"
+#include "scheduler.h"
+#include "shm.h"
+#include "trace.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 //!\file graph.h
 //!
@@ -17,57 +33,464 @@
 namespace flow
 {
 
+//!\namespace flow::execution
+//!
+//!\brief Contains the different execution values.
+namespace execution
+{
+
+//!\enum type
+//!
+//!\brief How a graph runs its nodes.
+enum type
+{
+	threaded,	//!< Every node runs on a thread of its own.
+	pooled		//!< Nodes are queued on a \ref flow::scheduler "scheduler" when they have work to do. Nodes that \ref flow::node::blocks "block" still run on a thread of their own.
+};
+
+}
+
 //!\brief Object that manages the connections and state of multiple nodes.
 //!
 //! When starting or stopping a graph, nodes are started and stopped in a fashion to minize build-up of packets.
+//!
+//! With execution::threaded, runs of transformers that have a single input and a single output and
+//! that are connected by pipes with no maximum length or weight are fused when the graph is started.
+//! A single thread then services all transformers of a run in order, so that a packet goes through the whole run without a context switch.
+//!
+//! The topology of a running graph can be changed with an \ref update, without stopping the nodes it does not touch.
 class graph : public named
 {
 	typedef std::map<std::string, std::shared_ptr<node>> nodes_t;
 	nodes_t d_producers, d_transformers, d_consumers;
 
+	typedef std::unordered_map<std::string, std::pair<nodes_t*, nodes_t::iterator>> index_t;
+	index_t d_index;	// Which of the above holds each node, so that finding a node by name takes a single hash lookup.
+
 	typedef std::map<std::string, std::unique_ptr<std::thread>> threads_t;
 	threads_t d_threads;
 
 	typedef std::map<std::string, std::map<size_t, std::pair<std::string, size_t>>> connections_t;
 	connections_t connections;
 
+	std::unique_ptr<scheduler> d_scheduler_p;
+
+	typedef std::vector<std::shared_ptr<node>> run_t;
+	std::set<std::string> d_fused;			// Nodes that run on the thread of the first node of their run.
+	std::map<std::string, run_t> d_runs;	// The runs of fused nodes, keyed by the name of their first node.
+
+	state::type d_state;					// The state nodes were last transitioned to.
+	std::atomic<size_t> d_epoch_a;			// The number of updates applied.
+
+	mutable std::recursive_mutex d_topology_m;	// Serializes the functions that read or change the topology.
+
+	std::map<std::string, cpus_t> d_affinities;	// The CPUs the threads of nodes are pinned to.
+
+	std::shared_ptr<detail::budget> d_budget_sp;	// Charged by all pipes of the graph. Null until a budget is set.
+
+	// Makes a node's pipes count against the graph's budget, and those it connects later.
+	void meter(const std::shared_ptr<node>& node_sp)
+	{
+		node_sp->d_budget_sp = d_budget_sp;
+
+		if(auto producer_p = std::dynamic_pointer_cast<detail::producer>(node_sp))
+		{
+			producer_p->meter(d_budget_sp);
+		}
+	}
+
+	// Whether a node can be fused with the nodes next to it.
+	bool fusible(const std::shared_ptr<node>& node_sp) const
+	{
+		auto consumer_p = std::dynamic_pointer_cast<detail::consumer>(node_sp);
+		auto producer_p = std::dynamic_pointer_cast<detail::producer>(node_sp);
+
+		return !node_sp->blocks() && consumer_p->ins() == 1 && producer_p->outs() == 1 && d_threads.find(node_sp->name()) == d_threads.end();
+	}
+
+	// Finds the runs of transformers to fuse, keyed by the name of the first transformer of each run.
+	std::map<std::string, run_t> fuse()
+	{
+		std::map<std::string, std::string> next;
+		std::set<std::string> followers;
+
+		for(auto& i : d_transformers)
+		{
+			if(!fusible(i.second) || std::dynamic_pointer_cast<detail::producer>(i.second)->capped(0)) continue;
+
+			auto c = connections.find(i.first);
+			if(c == connections.end()) continue;
+
+			auto o = c->second.find(0);
+			if(o == c->second.end()) continue;
+
+			auto t = d_transformers.find(o->second.first);
+			if(t == d_transformers.end() || !fusible(t->second) || d_fused.count(t->first)) continue;
+
+			next[i.first] = t->first;
+			followers.insert(t->first);
+		}
+
+		std::map<std::string, run_t> runs;
+
+		for(auto& n : next)
+		{
+			if(followers.count(n.first) || d_fused.count(n.first)) continue;
+
+			run_t &run = runs[n.first];
+			run.push_back(d_transformers[n.first]);
+
+			for(auto f = next.find(n.first); f != next.end(); f = next.find(f->second))
+			{
+				run.push_back(d_transformers[f->second]);
+				d_fused.insert(f->second);
+			}
+		}
+
+		return runs;
+	}
+
+	// The execution function of a run of fused nodes. The first node's state and event govern the run.
+	static void run_fused(const run_t& run)
+	{
+		node &first = *run.front();
+
+		state::type s(first.state());
+
+		while(s != state::stopped)
+		{
+			if(s == state::paused)
+			{
+				detail::stopwatch sw(first.d_waiting_ns);
+				std::unique_lock<std::mutex> ul(first.d_transition_m);
+				first.d_transition_cv.wait(ul, [&s, &first](){ return (s = first.state()) != state::paused; });
+			}
+			else if(s == state::started)
+			{
+				const unsigned ticket = first.d_wakeup_e.ticket();
+
+				bool serviced = false;
+				for(auto& node_sp : run)
+				{
+					if(node_sp->state() == state::started)
+					{
+						detail::stopwatch sw(node_sp->d_busy_ns);
+						serviced = node_sp->service() || serviced;
+					}
+				}
+
+				if(!serviced && first.state() == state::started)
+				{
+					detail::stopwatch sw(first.d_waiting_ns);
+					first.d_wakeup_e.wait(ticket);
+				}
+			}
+
+			s = first.state();
+		}
+	}
+
+	// Starts a node on a thread of its own, on the scheduler or, if it is fused, on the thread of the first node of its run.
+	void launch(nodes_t::value_type& i, const std::map<std::string, run_t>& runs)
+	{
+		if(d_fused.count(i.first))
+		{
+			// Runs on the thread of the first node of its run.
+			i.second->d_scheduler_a = nullptr;
+			i.second->transition(state::started);
+
+			return;
+		}
+
+		i.second->d_host_a = nullptr;
+
+		if(d_scheduler_p && !i.second->blocks())
+		{
+			i.second->d_scheduler_a = d_scheduler_p.get();
+			i.second->transition(state::started);
+
+			if(i.second->runnable())
+			{
+				d_scheduler_p->schedule(i.second.get());
+			}
+
+			return;
+		}
+
+		i.second->d_scheduler_a = nullptr;
+		i.second->transition(state::started);
+
+		auto r = runs.find(i.first);
+		if(r != runs.end())
+		{
+			run_t run(r->second);
+			d_threads[i.first] = std::unique_ptr<std::thread>(new std::thread([run]{ graph::run_fused(run); }));
+		}
+		else if(d_threads.find(i.first) == d_threads.end())
+		{
+//			d_threads[i.first] = std::unique_ptr<std::thread>(new std::thread(std::ref(*i.second)));
+			d_threads[i.first] = std::unique_ptr<std::thread>(new std::thread([&i]{ i.second->operator()(); }));	// Remove this workaround for bug in VC++11 (bug #734305) when possible.
+		}
+		else
+		{
+			return;
+		}
+
+		auto a = d_affinities.find(i.first);
+		if(a != d_affinities.end())
+		{
+			flow::pin_thread(*d_threads[i.first], a->second);
+		}
+	}
+
+	// Stops a node and joins its thread.
+	void halt(nodes_t::value_type& i)
+	{
+		i.second->transition(state::stopped);
+
+		// A node on the scheduler may still be queued or in the middle of its last step.
+		while(i.second->scheduled())
+		{
+			std::this_thread::yield();
+		}
+
+		graph::threads_t::iterator j = d_threads.find(i.first);
+		if(j != d_threads.end())
+		{
+			j->second->join();
+			d_threads.erase(j);
+		}
+	}
+
 public:
 	//!\param name_r The name of this graph.
-	graph(const std::string name_r = "graph") : named(name_r)
-	{}
+	//!\param e How this graph runs its nodes.
+	//!\param threads With execution::pooled, the number of threads of the scheduler. Do not set or set to 0 for as many threads as there are cores.
+	graph(const std::string name_r = "graph", const execution::type e = execution::threaded, const size_t threads = 0) : named(name_r), d_state(state::paused), d_epoch_a(0)
+	{
+		if(e == execution::pooled)
+		{
+			d_scheduler_p.reset(new scheduler(threads));
+		}
+	}
 
 	virtual ~graph()
 	{
 		stop();
 	}
 
+	//!\brief A batch of changes to the topology of a graph, applied all at once by \ref graph::apply.
+	//!
+	//! Recording a change does not perform it.
+	//! Changes are applied in the order they were recorded, so a node added by an update can be connected by the same update.
+	class update
+	{
+		friend class graph;
+
+		enum action { adding, removing, connecting, disconnecting };
+
+		struct operation
+		{
+			action what;
+			std::shared_ptr<node> node_sp;	// The node to add.
+			std::string name;				// The node to add, to remove or to disconnect, or the producing node to connect.
+			std::string other;				// The consuming node to connect.
+
+			// Whether the nodes have the types and the pins the operation expects.
+			std::function<bool (const std::shared_ptr<node>&, const std::shared_ptr<node>&)> typed;
+
+			std::function<void (graph&)> apply;
+		};
+
+		std::vector<operation> d_operations;
+
+	public:
+		//!\brief Adds a node to the graph.
+		//!
+		//! If the graph is started, the node is started too.
+		//!
+		//!\param node_sp The node to add.
+		//!\param name_r Optional. New name to give the node.
+		void add(std::shared_ptr<node> node_sp, const std::string& name_r = std::string())
+		{
+			operation o;
+			o.what = adding;
+			o.node_sp = node_sp;
+			o.name = name_r.empty() && node_sp ? node_sp->name() : name_r;
+			o.apply = [node_sp, name_r](graph& g){ g.add(node_sp, name_r); };
+
+			d_operations.push_back(o);
+		}
+
+		//!\brief Removes a node from the graph.
+		//!
+		//! The node is stopped and its thread is joined. Packets waiting at its inpins are lost.
+		//!
+		//!\param name_r The name of the node to remove.
+		void remove(const std::string& name_r)
+		{
+			operation o;
+			o.what = removing;
+			o.name = name_r;
+			o.apply = [name_r](graph& g){ g.remove(name_r); };
+
+			d_operations.push_back(o);
+		}
+
+		//!\brief Connects two nodes' pins together.
+		//!
+		//! The parameters are those of \ref graph::connect.
+		template<typename T>
+		void connect(const std::string& p_name_r, const size_t p_pin, const std::string& c_name_r, const size_t c_pin, const size_t max_length = 0, const size_t max_weight = 0, const pipe_type::type kind = pipe_type::deque, const overflow::type policy = overflow::reject, const int priority = 0, const size_t share = 1)
+		{
+			operation o;
+			o.what = connecting;
+			o.name = p_name_r;
+			o.other = c_name_r;
+			o.typed = [p_pin, c_pin](const std::shared_ptr<node>& p_sp, const std::shared_ptr<node>& c_sp)
+			{
+				auto producer_sp = std::dynamic_pointer_cast<producer<T>>(p_sp);
+				auto consumer_sp = std::dynamic_pointer_cast<consumer<T>>(c_sp);
+
+				return producer_sp && consumer_sp && p_pin < producer_sp->outs() && c_pin < consumer_sp->ins();
+			};
+			o.apply = [=](graph& g){ g.connect<T>(p_name_r, p_pin, c_name_r, c_pin, max_length, max_weight, kind, policy, priority, share); };
+
+			d_operations.push_back(o);
+		}
+
+		//!\brief Disconnects a node's outpin.
+		//!
+		//!\param sp_p The node.
+		//!\param p_pin The pin's index.
+		template<typename T>
+		void disconnect(std::shared_ptr<flow::producer<T>> sp_p, const size_t p_pin)
+		{
+			operation o;
+			o.what = disconnecting;
+			o.name = sp_p->name();
+			o.typed = [sp_p, p_pin](const std::shared_ptr<node>& p_sp, const std::shared_ptr<node>&){ return p_sp.get() == static_cast<node*>(sp_p.get()) && p_pin < sp_p->outs(); };
+			o.apply = [sp_p, p_pin](graph& g){ g.disconnect<T>(sp_p, p_pin); };
+
+			d_operations.push_back(o);
+		}
+
+		//!\brief Disconnects a node's inpin.
+		//!
+		//!\param sp_c The node.
+		//!\param c_pin The pin's index.
+		template<typename T>
+		void disconnect(std::shared_ptr<flow::consumer<T>> sp_c, const size_t c_pin)
+		{
+			operation o;
+			o.what = disconnecting;
+			o.name = sp_c->name();
+			o.typed = [sp_c, c_pin](const std::shared_ptr<node>& c_sp, const std::shared_ptr<node>&){ return c_sp.get() == static_cast<node*>(sp_c.get()) && c_pin < sp_c->ins(); };
+			o.apply = [sp_c, c_pin](graph& g){ g.disconnect<T>(sp_c, c_pin); };
+
+			d_operations.push_back(o);
+		}
+
+		//!\brief The number of changes recorded.
+		size_t size() const
+		{
+			return d_operations.size();
+		}
+
+		//!\brief Forgets all changes recorded.
+		void clear()
+		{
+			d_operations.clear();
+		}
+	};
+
+	//!\brief Makes room for a number of nodes ahead of time.
+	//!
+	//! Call before adding many nodes at once, e.g. when building a generated graph.
+	//! Finding a node by name takes a single hash lookup either way, this only spares the rehashing as the graph grows.
+	//!
+	//!\param nodes The number of nodes the graph is expected to hold.
+	virtual void reserve(const size_t nodes)
+	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
+		d_index.reserve(nodes);
+	}
+
 	//!\brief Adds a node to the graph.
 	//!
 	//! The node will initially be disconnected and paused.
+	//! It replaces the node that has the same name, if any.
 	//!
 	//!\param node_p Pointer to the node to add.
 	//!\param name_r Optional. New name to give the node.
 	virtual void add(std::shared_ptr<node> node_p, const std::string& name_r = std::string())
 	{
-		if(!name_r.empty())
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
+		if(!name_r.empty() && name_r != node_p->name())
 		{
 			node_p->rename(name_r);
 		}
 
-		if(std::dynamic_pointer_cast<detail::transformer>(node_p))
+		nodes_t *n = nullptr;
+		if(dynamic_cast<detail::transformer*>(node_p.get()))
 		{
-			d_transformers[node_p->name()] = node_p;
+			n = &d_transformers;
 		}
-		else if(std::dynamic_pointer_cast<detail::producer>(node_p))
+		else if(dynamic_cast<detail::producer*>(node_p.get()))
 		{
-			d_producers[node_p->name()] = node_p;
+			n = &d_producers;
 		}
-		else if(std::dynamic_pointer_cast<detail::consumer>(node_p))
+		else if(dynamic_cast<detail::consumer*>(node_p.get()))
 		{
-			d_consumers[node_p->name()] = node_p;
+			n = &d_consumers;
+		}
+
+		if(n)
+		{
+			// A node of another kind with the same name is replaced, as one of the same kind is.
+			index_t::iterator x = d_index.find(node_p->name());
+			if(x != d_index.end() && x->second.first != n)
+			{
+				x->second.first->erase(x->second.second);
+			}
+
+			nodes_t::iterator i = n->insert(std::make_pair(node_p->name(), node_p)).first;
+			i->second = node_p;
+			d_index[node_p->name()] = std::make_pair(n, i);
 		}
 
 		connections[node_p->name()];
+
+		if(d_budget_sp)
+		{
+			meter(node_p);
+		}
+	}
+
+	//!\brief Adds the nodes of a parallel stage to the graph and connects them.
+	//!
+	//! The splitter is named \c name_r + "_split", the replicas \c name_r + "_" + their index and the merger \c name_r + "_merge".
+	//! They are regular nodes: connect to the stage through \ref parallel::splitter and \ref parallel::merger, remove them one by one.
+	//! In threaded execution, every replica gets a thread of its own.
+	//!
+	//!\param p The parallel stage.
+	//!\param name_r The name from which the names of the nodes are made.
+	template<typename Transformer>
+	void add(const parallel<Transformer>& p, const std::string& name_r)
+	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
+		add(p.splitter(), name_r + "_split");
+		add(p.merger(), name_r + "_merge");
+
+		for(size_t i = 0; i != p.replicas(); ++i)
+		{
+			add(p.replica(i), name_r + "_" + std::to_string(i));
+			connect<typename parallel<Transformer>::consumed_type>(p.splitter(), i, p.replica(i), 0);
+			connect<typename parallel<Transformer>::produced_type>(p.replica(i), 0, p.merger(), i);
+		}
 	}
 
 	//!\brief Removes a node from the graph.
@@ -77,6 +500,8 @@ public:
 	//!\return Node that was removed.
 	virtual std::shared_ptr<node> remove(const std::string& name_r)
 	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
 		std::shared_ptr<node> p;
 		nodes_t *n;
 		nodes_t::iterator i;
@@ -84,11 +509,14 @@ public:
 		if((n = find(name_r, i)))
 		{
 			i->second->sever();
+			i->second->d_budget_sp.reset();
 			p = i->second;
 			n->erase(i);
+			d_index.erase(name_r);
 		}
 
 		connections.erase(name_r);
+		d_affinities.erase(name_r);
 
 		return p;
 	}
@@ -109,11 +537,17 @@ public:
 	//!\param c_pin The index of the consuming node's input pin to connect.
 	//!\param max_length The maximum length to give the pipe. Do not set or set to 0 for uncapped length.
 	//!\param max_weight The maximum weight to give the pipe. Do not set or set to 0 for uncapped weight.
+	//!\param kind The implementation of the pipe. Use pipe_type::ring for a lock-free pipe whose capacity is \c max_length.
+	//!\param policy What the pipe does with packets that do not fit. Use overflow::block to throttle the producing node.
+	//!\param priority The priority to give the consuming node's input pin, consulted under service_order::priority.
+	//!\param share The share to give the consuming node's input pin, consulted under service_order::weighted.
 	//!
 	//!\return False if the nodes had not yet been added to the graph.
 	template<typename T>
-	bool connect(const std::string& p_name_r, const size_t p_pin, const std::string& c_name_r, const size_t c_pin, const size_t max_length = 0, const size_t max_weight = 0)
+	bool connect(const std::string& p_name_r, const size_t p_pin, const std::string& c_name_r, const size_t c_pin, const size_t max_length = 0, const size_t max_weight = 0, const pipe_type::type kind = pipe_type::deque, const overflow::type policy = overflow::reject, const int priority = 0, const size_t share = 1)
 	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
 		nodes_t::iterator p, c;
 		
 		// Confirm these two nodes are in the graph.
@@ -122,7 +556,11 @@ public:
 			return false;
 		}
 		
-		std::dynamic_pointer_cast<producer<T>>(p->second)->connect(p_pin, std::dynamic_pointer_cast<consumer<T>>(c->second).get(), c_pin, max_length, max_weight);
+		consumer<T> *consumer_p = std::dynamic_pointer_cast<consumer<T>>(c->second).get();
+
+		std::dynamic_pointer_cast<producer<T>>(p->second)->connect(p_pin, consumer_p, c_pin, max_length, max_weight, kind, policy);
+		consumer_p->input(c_pin).prioritize(priority);
+		consumer_p->input(c_pin).set_share(share);
 
 		connections[p_name_r][p_pin] = std::make_pair(c_name_r, c_pin);
 
@@ -137,11 +575,17 @@ public:
 	//!\param c_pin The index of the consuming node's input pin to connect.
 	//!\param max_length The maximum length to give the pipe. Do not set or set to 0 for uncapped length.
 	//!\param max_weight The maximum weight to give the pipe. Do not set or set to 0 for uncapped weight.
+	//!\param kind The implementation of the pipe. Use pipe_type::ring for a lock-free pipe whose capacity is \c max_length.
+	//!\param policy What the pipe does with packets that do not fit. Use overflow::block to throttle the producing node.
+	//!\param priority The priority to give the consuming node's input pin, consulted under service_order::priority.
+	//!\param share The share to give the consuming node's input pin, consulted under service_order::weighted.
 	//!
 	//!\return False if the nodes had not yet been added to the graph.
 	template<typename T>
-	bool connect(std::shared_ptr<flow::producer<T>> sp_p, const size_t p_pin, std::shared_ptr<flow::consumer<T>> sp_c, const size_t c_pin, const size_t max_length = 0, const size_t max_weight = 0)
+	bool connect(std::shared_ptr<flow::producer<T>> sp_p, const size_t p_pin, std::shared_ptr<flow::consumer<T>> sp_c, const size_t c_pin, const size_t max_length = 0, const size_t max_weight = 0, const pipe_type::type kind = pipe_type::deque, const overflow::type policy = overflow::reject, const int priority = 0, const size_t share = 1)
 	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
 		nodes_t::iterator i;
 		
 		// Confirm these two nodes are in the graph.
@@ -150,13 +594,148 @@ public:
 			return false;
 		}
 		
-		sp_p->connect(p_pin, sp_c.get(), c_pin, max_length, max_weight);
+		sp_p->connect(p_pin, sp_c.get(), c_pin, max_length, max_weight, kind, policy);
+		sp_c->input(c_pin).prioritize(priority);
+		sp_c->input(c_pin).set_share(share);
 
 		connections[sp_p->name()][p_pin] = std::make_pair(sp_c->name(), c_pin);
 
 		return true;
 	}
 
+#if defined(FLOW_SHM_SUPPORTED)
+	//!\brief Connects a node's outpin to a shared-memory ring read by a graph of another process.
+	//!
+	//! A \ref shm_sink holding the writer end of the ring is added to the graph and connected to the outpin.
+	//! It is named after the producing node and its pin.
+	//!
+	//!\param sp_p The producing node.
+	//!\param p_pin The index of the producing node's output pin to connect.
+	//!\param segment_r The name of the shared-memory segment, starting with a slash.
+	//!\param capacity The number of records the ring holds, if this end creates the segment.
+	//!
+	//!\return False if the producing node had not yet been added to the graph or if the segment could not be opened.
+	template<typename T>
+	bool connect(std::shared_ptr<flow::producer<T>> sp_p, const size_t p_pin, const std::string& segment_r, const size_t capacity = shm_ring<T>::default_capacity)
+	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
+		nodes_t::iterator i;
+
+		if(!find(sp_p->name(), i))
+		{
+			return false;
+		}
+
+		auto sp_s = std::make_shared<shm_sink<T>>(segment_r, capacity, sp_p->name() + "_shm" + std::to_string(p_pin));
+		if(!sp_s->is_open())
+		{
+			return false;
+		}
+
+		add(sp_s);
+
+		return connect<T>(sp_p, p_pin, std::static_pointer_cast<flow::consumer<T>>(sp_s), 0);
+	}
+
+	//!\brief Connects a node's inpin to a shared-memory ring written by a graph of another process.
+	//!
+	//! A \ref shm_source holding the reader end of the ring is added to the graph and connected to the inpin.
+	//! It is named after the consuming node and its pin.
+	//!
+	//!\param segment_r The name of the shared-memory segment, starting with a slash.
+	//!\param sp_c The consuming node.
+	//!\param c_pin The index of the consuming node's input pin to connect.
+	//!\param capacity The number of records the ring holds, if this end creates the segment.
+	//!
+	//!\return False if the consuming node had not yet been added to the graph or if the segment could not be opened.
+	template<typename T>
+	bool connect(const std::string& segment_r, std::shared_ptr<flow::consumer<T>> sp_c, const size_t c_pin, const size_t capacity = shm_ring<T>::default_capacity)
+	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
+		nodes_t::iterator i;
+
+		if(!find(sp_c->name(), i))
+		{
+			return false;
+		}
+
+		auto sp_s = std::make_shared<shm_source<T>>(segment_r, capacity, sp_c->name() + "_shm" + std::to_string(c_pin));
+		if(!sp_s->is_open())
+		{
+			return false;
+		}
+
+		add(sp_s);
+
+		return connect<T>(std::static_pointer_cast<flow::producer<T>>(sp_s), 0, sp_c, c_pin);
+	}
+#endif
+
+	//!\brief Sets the priority of the pipe connected to a node's outpin.
+	//!
+	//! When the graph's \ref budget is exhausted and its policy is budget_policy::shed, packets pushed to the pipes of lowest priority are discarded first.
+	//! Pipes have a priority of 0 until they are given another. The priority goes with the pipe, a new connection starts over at 0.
+	//!
+	//!\param p_name_r Name of the producing node.
+	//!\param p_pin The index of the producing node's output pin.
+	//!\param priority The pipe's new priority.
+	//!
+	//!\return \c false if the node is not in the graph, is not a producer or if the outpin is not connected.
+	virtual bool prioritize(const std::string& p_name_r, const size_t p_pin, const int priority)
+	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
+		nodes_t::iterator i;
+		if(!find(p_name_r, i))
+		{
+			return false;
+		}
+
+		auto producer_p = std::dynamic_pointer_cast<detail::producer>(i->second);
+
+		return producer_p && p_pin < producer_p->outs() && producer_p->prioritize(p_pin, priority);
+	}
+
+	//!\brief Bounds the number of bytes held by all pipes of the graph together.
+	//!
+	//! Every packet pushed to a pipe of the graph is charged to the budget and credited back once it is popped.
+	//! While the pipes together hold \c bytes or more, the policy decides what happens to packets pushed to them:
+	//!  - budget_policy::backpressure refuses them at the pipe holding the most bytes, whose own overflow policy then applies.
+	//!    Pipes connected with overflow::block make their producer wait, so the busiest producer is throttled.
+	//!  - budget_policy::shed discards them at the pipes of lowest \ref prioritize "priority" among those holding packets.
+	//!  - budget_policy::drop_oldest discards the oldest packets of the pipe they are pushed to in order to make room.
+	//!
+	//! The other pipes still take packets, so that the nodes draining an offending pipe never wait on the budget.
+	//! The budget can therefore be overshot by the packets those nodes push, until they are the offenders in turn.
+	//!
+	//! Pipes already connected are counted from now on, with the packets they already hold, so the budget should be set while the graph is not started.
+	//! Pipes connected afterwards are counted as soon as they are made. The budget can be changed at any time.
+	//! Its counters are part of the graph's \ref metrics.
+	//!
+	//!\param bytes The number of bytes the pipes may hold. 0 lifts the limit but keeps counting.
+	//!\param policy What happens to packets pushed once the pipes hold that many bytes.
+	virtual void budget(const size_t bytes, const budget_policy::type policy = budget_policy::backpressure)
+	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
+		if(!d_budget_sp)
+		{
+			d_budget_sp = std::make_shared<detail::budget>();
+
+			for(auto n : { &d_producers, &d_transformers, &d_consumers })
+			{
+				for(auto& i : *n)
+				{
+					meter(i.second);
+				}
+			}
+		}
+
+		d_budget_sp->set(bytes, policy);
+	}
+
 	//!\brief Disconnects a node's pin.
 	//!
 	//!\param sp_p The node.
@@ -164,6 +743,8 @@ public:
 	template<typename T>
 	void disconnect(std::shared_ptr<flow::producer<T>> sp_p, const size_t p_pin)
 	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
 		sp_p->disconnect(p_pin);
 
 		connections[sp_p->name()][p_pin] = std::make_pair(std::string(), 0);
@@ -176,31 +757,178 @@ public:
 	template<typename T>
 	void disconnect(std::shared_ptr<flow::consumer<T>> sp_c, const size_t c_pin)
 	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
 		sp_c->disconnect(c_pin);
 
 		connections[sp_c->name()][c_pin] = std::make_pair(std::string(), 0);
 	}
 
+	//!\brief Applies a batch of changes to the topology of the graph at once.
+	//!
+	//! The whole update is checked before anything is changed: if a node it names does not exist at that point of the update,
+	//! if a node is added under a name already taken or if nodes to connect do not have the right types or pins, nothing is changed.
+	//!
+	//! Only the nodes the update touches are disturbed, the others keep streaming packets.
+	//! The nodes the update touches are stopped and their threads joined, or retired by the scheduler, before their pins are changed.
+	//! A run of fused nodes that the update touches is taken apart and its nodes get threads of their own.
+	//! If the graph is started, added nodes are started and so are the touched nodes that were not removed.
+	//! No other graph function runs while an update is applied.
+	//!
+	//!\param u The changes to apply.
+	//!
+	//!\return \c false if the update was rejected.
+	virtual bool apply(const update& u)
+	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
+		// The nodes of the graph as they will be after each change.
+		std::map<std::string, std::shared_ptr<node>> staged;
+		for(auto n : { &d_producers, &d_transformers, &d_consumers })
+		{
+			staged.insert(n->begin(), n->end());
+		}
+
+		std::set<std::string> touched, removed, added;
+		for(auto& o : u.d_operations)
+		{
+			switch(o.what)
+			{
+			case update::adding:
+				if(!o.node_sp || staged.count(o.name)) return false;
+				staged[o.name] = o.node_sp;
+				added.insert(o.name);
+				break;
+
+			case update::removing:
+				if(!staged.erase(o.name)) return false;
+				touched.insert(o.name);
+				removed.insert(o.name);
+				added.erase(o.name);
+				break;
+
+			case update::connecting:
+			case update::disconnecting:
+				{
+					auto p = staged.find(o.name), c = o.other.empty() ? p : staged.find(o.other);
+					if(p == staged.end() || c == staged.end() || !o.typed(p->second, c->second)) return false;
+				}
+				touched.insert(o.name);
+				if(!o.other.empty()) touched.insert(o.other);
+				break;
+			}
+		}
+
+		// Take apart the runs of fused nodes that are touched. A run's thread returns once its first node is stopped.
+		std::set<std::string> restarted;
+		for(auto r = d_runs.begin(); r != d_runs.end();)
+		{
+			if(std::none_of(r->second.begin(), r->second.end(), [&touched](const std::shared_ptr<node>& node_sp){ return touched.count(node_sp->name()) != 0; }))
+			{
+				++r;
+				continue;
+			}
+
+			for(auto& node_sp : r->second)
+			{
+				node_sp->transition(state::stopped);
+			}
+
+			auto t = d_threads.find(r->first);
+			if(t != d_threads.end())
+			{
+				t->second->join();
+				d_threads.erase(t);
+			}
+
+			for(auto& node_sp : r->second)
+			{
+				node_sp->d_host_a = nullptr;
+				d_fused.erase(node_sp->name());
+				restarted.insert(node_sp->name());
+			}
+
+			r = d_runs.erase(r);
+		}
+
+		// No touched node may be running while its pins and their pipes are replaced.
+		for(auto& name : touched)
+		{
+			nodes_t::iterator i;
+			if(find(name, i))
+			{
+				halt(*i);
+
+				if(!removed.count(name))
+				{
+					restarted.insert(name);
+				}
+			}
+		}
+
+		for(auto& o : u.d_operations)
+		{
+			o.apply(*this);
+		}
+
+		if(d_state == state::started)
+		{
+			const std::map<std::string, run_t> none;
+
+			restarted.insert(added.begin(), added.end());
+			for(auto n : { &d_consumers, &d_transformers, &d_producers })
+			{
+				for(auto& i : *n)
+				{
+					if(restarted.count(i.first))
+					{
+						launch(i, none);
+					}
+				}
+			}
+		}
+
+		++d_epoch_a;
+
+		return true;
+	}
+
+	//!\brief The number of updates applied to this graph so far.
+	virtual size_t epoch() const
+	{
+		return d_epoch_a.load();
+	}
+
 	//!\brief Starts all nodes in the graph.
 	//!
 	//! To avoid packet build-up in pipes, pure consuming node are started first, transforming nodes second and pure producing nodes last.
 	//! If a node had been stopped earlier, a new thread is created for it.
+	//! With execution::pooled, nodes that do not block are queued on the scheduler instead.
 	virtual void start()
 	{
-		auto start_f = [this](nodes_t::value_type& i)
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
+		std::map<std::string, run_t> runs;
+		if(!d_scheduler_p)
 		{
-			i.second->transition(state::started);
+			runs = fuse();
+		}
 
-			if(d_threads.find(i.first) == d_threads.end())
+		for(auto& run : runs)
+		{
+			for(auto& node_sp : run.second)
 			{
-//				d_threads[i.first] = std::unique_ptr<std::thread>(new std::thread(std::ref(*i.second)));
-				d_threads[i.first] = std::unique_ptr<std::thread>(new std::thread([&i]{ i.second->operator()(); }));	// Remove this workaround for bug in VC++11 (bug #734305) when possible.
+				node_sp->d_host_a = node_sp == run.second.front() ? nullptr : run.second.front().get();
 			}
-		};
 
-		for(auto& i : d_consumers){ start_f(i); }
-		for(auto& i : d_transformers){ start_f(i); }
-		for(auto& i : d_producers){ start_f(i); }
+			d_runs[run.first] = run.second;
+		}
+
+		for(auto& i : d_consumers){ launch(i, runs); }
+		for(auto& i : d_transformers){ launch(i, runs); }
+		for(auto& i : d_producers){ launch(i, runs); }
+
+		d_state = state::started;
 	}
 
 	//!\brief Pauses all nodes in the graph.
@@ -213,31 +941,379 @@ public:
 			i.second->transition(state::paused);
 		};
 
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
 		for(auto& i : d_producers){ pause_f(i); }
 		for(auto& i : d_transformers){ pause_f(i); }
 		for(auto& i : d_consumers){ pause_f(i); }
+
+		d_state = state::paused;
 	}
 
 	//!\brief Stops all nodes in the graph.
 	//!
 	//! node::stop() is called on all nodes.
+	//! Returns once no node is running anymore.
 	virtual void stop()
 	{
-		auto stop_f = [this](nodes_t::value_type& i)
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
+		for(auto& i : d_producers){ halt(i); }
+		for(auto& i : d_transformers){ halt(i); }
+		for(auto& i : d_consumers){ halt(i); }
+
+		d_fused.clear();
+		d_runs.clear();
+
+		d_state = state::stopped;
+	}
+
+	//!\brief Stops all nodes in the graph once the packets in flight have reached the consumers.
+	//!
+	//! Producers are stopped first. Every other node is stopped as soon as the nodes feeding it are done and its inputs are empty,
+	//! so packets flush through the graph in topological order while nodes downstream keep running.
+	//! Once the timeout has passed, all nodes still running are stopped at once.
+	//! A node waiting for a packet's consumption time is woken up when it is stopped.
+	//!
+	//! Returns once no node is running anymore, like stop().
+	//!
+	//!\param timeout How long to wait for packets in flight to reach the consumers.
+	//!
+	//!\return What was left in pipes, packets held inside nodes are not accounted for.
+	template<typename Rep, typename Period>
+	drain_report drain(const std::chrono::duration<Rep, Period>& timeout)
+	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now(), deadline = start + timeout;
+
+		std::map<std::string, std::set<std::string>> upstream;
+		for(auto& c : connections)
+		{
+			for(auto& o : c.second)
+			{
+				if(!o.second.first.empty())
+				{
+					upstream[o.second.first].insert(c.first);
+				}
+			}
+		}
+
+		// The first node of the run of each fused node.
+		std::map<std::string, std::string> hosts;
+		for(auto& r : d_runs)
+		{
+			for(auto& node_sp : r.second)
+			{
+				hosts[node_sp->name()] = r.first;
+			}
+		}
+
+		std::set<std::string> stopped, done;
+
+		auto stop_f = [&stopped](nodes_t::value_type& i)
 		{
 			i.second->transition(state::stopped);
+			stopped.insert(i.first);
+		};
 
-			graph::threads_t::iterator j = d_threads.find(i.first);
-			if(j != d_threads.end())
+		// A stopped node is done once it can no longer push packets: its thread has returned or it is no longer on the scheduler.
+		auto done_f = [this, &stopped, &done, &hosts]()
+		{
+			for(auto& name : stopped)
 			{
-				j->second->join();
-				d_threads.erase(j);
+				if(done.count(name)) continue;
+
+				auto h = hosts.find(name);
+				if(h != hosts.end())
+				{
+					// A run's thread returns once its first node is stopped, the run is done once all its nodes are stopped.
+					const run_t& run = d_runs[h->second];
+					if(std::any_of(run.begin(), run.end(), [&stopped](const std::shared_ptr<node>& node_sp){ return stopped.count(node_sp->name()) == 0; })) continue;
+
+					auto t = d_threads.find(h->second);
+					if(t != d_threads.end())
+					{
+						t->second->join();
+						d_threads.erase(t);
+					}
+
+					for(auto& node_sp : run)
+					{
+						done.insert(node_sp->name());
+					}
+				}
+				else
+				{
+					nodes_t::iterator i;
+					find(name, i);
+					if(i->second->scheduled()) continue;
+
+					auto t = d_threads.find(name);
+					if(t != d_threads.end())
+					{
+						t->second->join();
+						d_threads.erase(t);
+					}
+
+					done.insert(name);
+				}
 			}
 		};
 
 		for(auto& i : d_producers){ stop_f(i); }
-		for(auto& i : d_transformers){ stop_f(i); }
-		for(auto& i : d_consumers){ stop_f(i); }
+
+		drain_report report;
+		report.complete = true;
+
+		const size_t total = d_producers.size() + d_transformers.size() + d_consumers.size();
+		while(stopped.size() != total)
+		{
+			done_f();
+
+			const bool late = std::chrono::steady_clock::now() >= deadline;
+
+			for(auto n : { &d_transformers, &d_consumers })
+			{
+				for(auto& i : *n)
+				{
+					if(stopped.count(i.first)) continue;
+
+					// Within a run, the node feeding this one is serviced by the same thread, it only has to be stopped.
+					auto h = hosts.find(i.first);
+					auto fed_f = [&](const std::string& name)
+					{
+						auto g = hosts.find(name);
+						return done.count(name) || (h != hosts.end() && g != hosts.end() && g->second == h->second && stopped.count(name));
+					};
+
+					const std::set<std::string>& feeders = upstream[i.first];
+					const bool ready = std::all_of(feeders.begin(), feeders.end(), fed_f) && !std::dynamic_pointer_cast<detail::consumer>(i.second)->queued();
+
+					if(ready || late)
+					{
+						report.complete = report.complete && ready;
+						stop_f(i);
+					}
+				}
+			}
+
+			if(stopped.size() != total)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+
+		while(done.size() != total)
+		{
+			done_f();
+			std::this_thread::yield();
+		}
+
+		d_fused.clear();
+		d_runs.clear();
+
+		d_state = state::stopped;
+
+		report.left = 0;
+		for(auto& p : metrics().pipes)
+		{
+			if(p.length)
+			{
+				report.left += p.length;
+				report.pipes.push_back(p);
+			}
+		}
+
+		report.complete = report.complete && !report.left;
+		report.elapsed = std::chrono::steady_clock::now() - start;
+
+		return report;
+	}
+
+	//!\brief Takes a snapshot of the counters of all nodes and pipes, and of the graph's \ref budget.
+	//!
+	//! Can be called while the graph is running to find the node that holds back the flow of packets.
+	//! Such a node spends most of its time busy while the pipes leading to it fill up.
+	virtual graph_metrics metrics() const
+	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
+		graph_metrics m;
+
+		auto metrics_f = [&m](const nodes_t::value_type& i)
+		{
+			m.nodes.push_back(i.second->metrics());
+			i.second->pipes_metrics(m.pipes);
+		};
+
+		for(auto& i : d_producers){ metrics_f(i); }
+		for(auto& i : d_transformers){ metrics_f(i); }
+		for(auto& i : d_consumers){ metrics_f(i); }
+
+		m.budget = d_budget_sp ? d_budget_sp->metrics() : budget_metrics();
+
+		return m;
+	}
+
+	//!\brief Pins the thread of a node to a set of CPUs.
+	//!
+	//! Takes effect right away if the node runs on a thread of its own, otherwise the next time it is started on one.
+	//! A fused node runs on the thread of the first node of its run and a node on a \ref scheduler runs on the scheduler's threads,
+	//! the pin only applies if the node ever gets a thread of its own. See \ref pin_worker for the scheduler's threads.
+	//!
+	//! Pinning the producer and the consumer of a busy pipe to CPUs that share a cache or a NUMA node keeps the packets they exchange close to both.
+	//!
+	//!\param name_r The name of the node.
+	//!\param cpus The CPUs the node's thread may run on. An empty set allows all CPUs.
+	//!
+	//!\return \c false if the node is not in the graph, if pinning is not supported on this platform or if the node's running thread could not be pinned.
+	virtual bool pin(const std::string& name_r, const cpus_t& cpus)
+	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
+		nodes_t::iterator i;
+		if(!find(name_r, i) || !affinity_supported())
+		{
+			return false;
+		}
+
+		if(cpus.empty())
+		{
+			d_affinities.erase(name_r);
+		}
+		else
+		{
+			d_affinities[name_r] = cpus;
+		}
+
+		auto t = d_threads.find(name_r);
+		return t == d_threads.end() || flow::pin_thread(*t->second, cpus);
+	}
+
+	//!\brief Pins one of the threads of the scheduler to a set of CPUs.
+	//!
+	//!\param thread The index of the thread in the scheduler.
+	//!\param cpus The CPUs the thread may run on. An empty set allows all CPUs.
+	//!
+	//!\return \c false if the graph was not constructed with execution::pooled or if the thread could not be pinned.
+	virtual bool pin_worker(const size_t thread, const cpus_t& cpus)
+	{
+		return d_scheduler_p && d_scheduler_p->pin(thread, cpus);
+	}
+
+	//!\brief Pins all nodes so that the endpoints of the busiest pipes share a set of CPUs.
+	//!
+	//! Pipes are weighed by the number of packets pushed to them so far, so this is best called after the graph has run for a while.
+	//! Starting with the busiest pipe, the nodes at both ends are put in the same group unless the group would outgrow its share of nodes.
+	//! Groups are then given to domains so that every domain gets about as many nodes.
+	//!
+	//!\param domains Sets of CPUs, typically one per NUMA node or per socket.
+	virtual void place(const std::vector<cpus_t>& domains)
+	{
+		if(domains.empty()) return;
+
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
+		std::vector<std::string> names;
+		for(auto n : { &d_producers, &d_transformers, &d_consumers })
+		{
+			for(auto& i : *n)
+			{
+				names.push_back(i.first);
+			}
+		}
+
+		const size_t share = (names.size() + domains.size() - 1) / domains.size();
+
+		// Every node starts in a group of its own.
+		std::map<std::string, std::string> leaders;
+		std::map<std::string, size_t> sizes;
+		for(auto& name : names)
+		{
+			leaders[name] = name;
+			sizes[name] = 1;
+		}
+
+		auto leader_f = [&leaders](std::string name)
+		{
+			while(leaders[name] != name)
+			{
+				name = leaders[name];
+			}
+
+			return name;
+		};
+
+		// The busiest pipes first.
+		std::vector<std::pair<size_t, std::pair<std::string, std::string>>> pipes;
+		for(auto& c : connections)
+		{
+			nodes_t::iterator i;
+			if(!find(c.first, i)) continue;
+
+			auto producer_p = std::dynamic_pointer_cast<detail::producer>(i->second);
+			if(!producer_p) continue;
+
+			for(auto& o : c.second)
+			{
+				if(o.first < producer_p->outs() && leaders.count(o.second.first))
+				{
+					pipes.push_back(std::make_pair(producer_p->pushed(o.first), std::make_pair(c.first, o.second.first)));
+				}
+			}
+		}
+
+		std::sort(pipes.begin(), pipes.end(), [](const decltype(pipes)::value_type& a, const decltype(pipes)::value_type& b){ return a.first > b.first; });
+
+		for(auto& p : pipes)
+		{
+			const std::string a = leader_f(p.second.first), b = leader_f(p.second.second);
+
+			if(a != b && sizes[a] + sizes[b] <= share)
+			{
+				leaders[b] = a;
+				sizes[a] += sizes[b];
+			}
+		}
+
+		// The largest groups first, each to the domain with the fewest nodes.
+		std::vector<std::pair<size_t, std::string>> groups;
+		for(auto& name : names)
+		{
+			if(leader_f(name) == name)
+			{
+				groups.push_back(std::make_pair(sizes[name], name));
+			}
+		}
+
+		std::sort(groups.begin(), groups.end(), [](const std::pair<size_t, std::string>& a, const std::pair<size_t, std::string>& b){ return a.first > b.first; });
+
+		std::vector<size_t> loads(domains.size(), 0);
+		std::map<std::string, size_t> placement;
+		for(auto& g : groups)
+		{
+			const size_t d = std::min_element(loads.begin(), loads.end()) - loads.begin();
+
+			loads[d] += g.first;
+			placement[g.second] = d;
+		}
+
+		for(auto& name : names)
+		{
+			pin(name, domains[placement[leader_f(name)]]);
+		}
+	}
+
+	//!\brief The CPUs a node's thread is pinned to, empty if it is not pinned.
+	//!
+	//!\param name_r The name of the node.
+	virtual cpus_t affinity(const std::string& name_r) const
+	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
+		auto a = d_affinities.find(name_r);
+		return a == d_affinities.end() ? cpus_t() : a->second;
 	}
 
 	//!\brief Produces a dot syntax of the graph.
@@ -245,6 +1321,8 @@ public:
 	//!\param o The output stream to output the syntax.
 	virtual std::ostream& to_dot(std::ostream& o)
 	{
+		std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
 		o << "digraph " << (name() == "graph" ? "graph1" : name()) << "\n{\n";
 		o << "\trankdir = LR\n";
 		o << "\tnode [shape = record, fontname = \"Helvetica\"]\n";
@@ -258,30 +1336,167 @@ public:
 			}
 		}
 
+		// Nodes bridging to another process or host get a dashed edge to or from their endpoint.
+		for(auto n : { &d_producers, &d_transformers, &d_consumers })
+		{
+			for(auto& i : *n)
+			{
+				const std::string remote = i.second->remote();
+				if(remote.empty()) continue;
+
+				o << "\t\"" << remote << "\" [shape = box, style = dashed]\n";
+
+				if(n == &d_producers)
+				{
+					o << "\t\"" << remote << "\" -> " << i.first << " [style = dashed]\n";
+				}
+				else
+				{
+					o << "\t" << i.first << " -> \"" << remote << "\" [style = dashed]\n";
+				}
+			}
+		}
+
 		o << "}" << std::endl;
 
 		return o;
 	}
 
-private:
-	virtual nodes_t* find(const std::string& name_r, nodes_t::iterator& i)
+	//!\brief Writes the events recorded by the tracing hooks of this graph's nodes as a Chrome trace.
+	//!
+	//! The output is in the JSON trace event format, which chrome://tracing and Perfetto open.
+	//! Every thread gets a track. Calls to produce() and ready() are slices, pushes, pops and state changes are instants.
+	//! An arrow links the push of a packet to its pop, which also tells how long the packet spent in the pipe.
+	//! Events are those gathered by the \ref tracer since it was last cleared. The trace is empty unless \c FLOW_TRACE is defined.
+	//!
+	//!\param o The output stream to write the trace to.
+	virtual std::ostream& to_trace(std::ostream& o) const
 	{
-		i = d_producers.find(name_r);
+		std::map<const node*, std::string> names;
+		{
+			std::lock_guard<std::recursive_mutex> lg(d_topology_m);
+
+			for(auto n : { &d_producers, &d_transformers, &d_consumers })
+			{
+				for(auto& i : *n)
+				{
+					names[i.second.get()] = i.first;
+				}
+			}
+		}
+
+		std::vector<trace_event> events;
+		tracer::collect(events);
 
-		if(i != d_producers.end())
+		events.erase(std::remove_if(events.begin(), events.end(), [&names](const trace_event& e){ return names.count(e.node_p) == 0; }), events.end());
+		std::stable_sort(events.begin(), events.end(), [](const trace_event& a, const trace_event& b){ return a.time < b.time; });
+
+		auto quoted_f = [](const std::string& s)
+		{
+			std::string q(1, '"');
+			for(char c : s)
+			{
+				if(c == '"' || c == '\\') q += '\\';
+				q += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+			}
+
+			return q + '"';
+		};
+
+		auto us_f = [](const std::chrono::nanoseconds& ns){ return ns.count() / 1000.; };
+
+		static const char* const states[] = { "started", "paused", "stopped" };
+
+		const std::ios_base::fmtflags flags = o.flags();
+		const std::streamsize precision = o.precision();
+		o << std::fixed << std::setprecision(3);
+
+		o << "{\"traceEvents\":[";
+
+		const char *separator = "\n";
+		std::set<size_t> threads;
+		std::map<const void*, std::chrono::nanoseconds> pushed;	// The packets in flight and when they were pushed.
+
+		for(auto& e : events)
 		{
-			return &d_producers;
+			const std::string &name = names[e.node_p];
+			threads.insert(e.thread);
+
+			o << separator;
+			separator = ",\n";
+
+			switch(e.what)
+			{
+			case hook::produce:
+			case hook::ready:
+				o << "{\"name\":" << quoted_f(name) << ",\"cat\":\"" << (e.what == hook::produce ? "produce" : "ready") << "\",\"ph\":\"X\",\"ts\":" << us_f(e.time) << ",\"dur\":" << us_f(e.duration)
+				  << ",\"pid\":1,\"tid\":" << e.thread;
+				if(e.what == hook::ready)
+				{
+					o << ",\"args\":{\"pin\":" << e.arg << "}";
+				}
+				o << "}";
+				break;
+
+			case hook::push:
+				o << "{\"name\":\"push\",\"cat\":\"packet\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << us_f(e.time) << ",\"pid\":1,\"tid\":" << e.thread
+				  << ",\"args\":{\"node\":" << quoted_f(name) << ",\"packets\":" << e.arg << "}},\n";
+				o << "{\"name\":\"hop\",\"cat\":\"packet\",\"ph\":\"s\",\"id\":" << reinterpret_cast<std::uintptr_t>(e.packet_p) << ",\"ts\":" << us_f(e.time) << ",\"pid\":1,\"tid\":" << e.thread << "}";
+				pushed[e.packet_p] = e.time;
+				break;
+
+			case hook::pop:
+				{
+					auto p = pushed.find(e.packet_p);
+
+					o << "{\"name\":\"pop\",\"cat\":\"packet\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << us_f(e.time) << ",\"pid\":1,\"tid\":" << e.thread
+					  << ",\"args\":{\"node\":" << quoted_f(name) << ",\"packets\":" << e.arg;
+					if(p != pushed.end())
+					{
+						o << ",\"latency_us\":" << us_f(e.time - p->second) << "}},\n";
+						o << "{\"name\":\"hop\",\"cat\":\"packet\",\"ph\":\"f\",\"bp\":\"e\",\"id\":" << reinterpret_cast<std::uintptr_t>(e.packet_p) << ",\"ts\":" << us_f(e.time) << ",\"pid\":1,\"tid\":" << e.thread << "}";
+						pushed.erase(p);
+					}
+					else
+					{
+						o << "}}";
+					}
+				}
+				break;
+
+			case hook::transition:
+				o << "{\"name\":\"" << states[e.arg < 3 ? e.arg : 2] << "\",\"cat\":\"state\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << us_f(e.time) << ",\"pid\":1,\"tid\":" << e.thread
+				  << ",\"args\":{\"node\":" << quoted_f(name) << "}}";
+				break;
+			}
 		}
-		else if((i = d_transformers.find(name_r)) != d_transformers.end())
+
+		for(auto thread : threads)
 		{
-			return &d_transformers;
+			o << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"name\":\"thread " << thread << "\"}}";
+			separator = ",\n";
 		}
-		else if((i = d_consumers.find(name_r)) != d_consumers.end())
+
+		o << "\n],\"displayTimeUnit\":\"ns\"}" << std::endl;
+
+		o.flags(flags);
+		o.precision(precision);
+
+		return o;
+	}
+
+private:
+	virtual nodes_t* find(const std::string& name_r, nodes_t::iterator& i)
+	{
+		index_t::iterator x = d_index.find(name_r);
+		if(x == d_index.end())
 		{
-			return &d_consumers;
+			return nullptr;
 		}
 
-		return nullptr;
+		i = x->second.second;
+
+		return x->second.first;
 	}
 };
 
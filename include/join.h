@@ -0,0 +1,224 @@
+#if !defined(FLOW_JOIN_H)
+	 #define FLOW_JOIN_H
+
+#include "node.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+//!\file join.h
+//!
+//!\brief Defines the \ref flow::join base class.
+
+namespace flow
+{
+
+//!\namespace flow::alignment
+//!
+//!\brief Contains the ways a \ref flow::join matches packets across its inputs.
+namespace alignment
+{
+
+//!\enum type
+//!
+//!\brief How packets are matched across inputs.
+enum type
+{
+	arrival,	//!< The n-th packet of every input are joined together.
+	timestamp	//!< Only packets with the same consumption time are joined together. Packets for which some input has no match are dropped.
+};
+
+}
+
+//!\brief Base class from which concrete transformers that combine one packet from each of their inputs derive.
+//!
+//! Concrete classes implement joined(), which is called with one packet per input once every input has one.
+//!
+//! Rather than checking every input whenever a packet arrives, a join lets its inpins flag arrivals.
+//! Only flagged inputs are visited, their pipes are emptied under a single lock each and the packets are kept in a queue per input.
+//! A counter of non-empty queues tells in constant time whether a complete set is available.
+//!
+//! With alignment::timestamp, every input must deliver packets in increasing order of consumption time.
+//! Whenever the oldest packets of the inputs do not all have the same consumption time, those older than the newest of them can never be matched and are dropped.
+//! Packets that do not carry a consumption time all match one another.
+//!
+//!\tparam C The type of data this node consumes.
+//!\tparam P The type of data this node produces.
+template<typename C, typename P>
+class join : public transformer<C, P>
+{
+public:
+	//!\brief One packet per input, in the order of the inputs.
+	typedef std::vector<std::unique_ptr<packet<C>>> set_t;
+
+private:
+	typedef std::deque<std::unique_ptr<packet<C>>> queue_t;
+
+	detail::arrivals d_arrivals;
+	std::vector<queue_t> d_queues;
+	size_t d_filled;		// The number of non-empty queues.
+
+	const alignment::type d_alignment;
+	std::atomic<size_t> d_unmatched_a;
+
+	set_t d_set;
+	typename pipe<C>::packets_t d_popped;
+
+	// Packets are taken from the inpins by service().
+	virtual void ready(size_t) {}
+
+	// Removes the oldest packet of a queue.
+	std::unique_ptr<packet<C>> take(const size_t i)
+	{
+		std::unique_ptr<packet<C>> packet_p(std::move(d_queues[i].front()));
+
+		d_queues[i].pop_front();
+		if(d_queues[i].empty())
+		{
+			--d_filled;
+		}
+
+		return packet_p;
+	}
+
+	// Drops the oldest packets that cannot be matched. Returns whether the oldest packets of all queues match.
+	bool aligned()
+	{
+		if(d_alignment == alignment::arrival) return true;
+
+		typename packet<C>::time_point_type newest = d_queues[0].front()->consumption_time();
+		for(auto& q : d_queues)
+		{
+			newest = std::max(newest, q.front()->consumption_time());
+		}
+
+		bool matched = true;
+		for(size_t i = 0; i != d_queues.size(); ++i)
+		{
+			if(d_queues[i].front()->consumption_time() < newest)
+			{
+				take(i);
+				d_unmatched_a.fetch_add(1, std::memory_order_relaxed);
+				matched = false;
+			}
+		}
+
+		return matched;
+	}
+
+protected:
+	//!\brief Whether packets arrived at any inpin since they were last visited.
+	virtual bool incoming()
+	{
+		return d_arrivals.raised();
+	}
+
+	//!\brief Takes the packets waiting at the flagged inpins and calls joined() for every complete set.
+	//!
+	//!\return \c true if packets were waiting at any inpin.
+	virtual bool service()
+	{
+		if(!d_arrivals.raised()) return false;
+
+		bool serviced = false;
+
+		for(size_t i = 0; i != d_queues.size(); ++i)
+		{
+			if(d_arrivals.lower(i) && consumer<C>::input(i).pop_n(d_popped))
+			{
+				if(d_queues[i].empty())
+				{
+					++d_filled;
+				}
+
+				std::move(d_popped.begin(), d_popped.end(), std::back_inserter(d_queues[i]));
+				d_popped.clear();
+
+				serviced = true;
+			}
+		}
+
+		while(d_filled && d_filled == d_queues.size())
+		{
+			if(!aligned()) continue;
+
+			for(size_t i = 0; i != d_queues.size(); ++i)
+			{
+				d_set[i] = take(i);
+			}
+
+			joined(d_set);
+
+			for(auto& packet_p : d_set)
+			{
+				packet_p.reset();
+			}
+		}
+
+		return serviced;
+	}
+
+public:
+	//!\param name_r The name to give this node.
+	//!\param ins The number of input pins.
+	//!\param outs The number of output pins.
+	//!\param a How packets are matched across inputs.
+	join(const std::string& name_r, const size_t ins, const size_t outs, const alignment::type a = alignment::arrival) :
+		 node(name_r), transformer<C, P>(name_r, ins, outs), d_arrivals(ins), d_queues(ins), d_filled(0), d_alignment(a), d_unmatched_a(0), d_set(ins)
+	{
+		consumer<C>::track(&d_arrivals);
+	}
+
+	virtual ~join() {}
+
+	//!\brief The number of packets dropped because they could not be matched with packets from all other inputs.
+	virtual size_t unmatched() const
+	{
+		return d_unmatched_a.load(std::memory_order_relaxed);
+	}
+
+	//!\brief Joining function.
+	//!
+	//! Called with one packet per input as soon as every input has one.
+	//! Concrete classes may move packets out of the set, it is cleared after this function returns.
+	//!
+	//!\param set One packet per input, in the order of the inputs.
+	virtual void joined(set_t& set) = 0;
+};
+
+}
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
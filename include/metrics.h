@@ -0,0 +1,152 @@
+#if !defined(FLOW_METRICS_H)
+	 #define FLOW_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+//!\file metrics.h
+//!
+//!\brief Defines the \ref flow::pipe_metrics, \ref flow::node_metrics, \ref flow::budget_metrics and \ref flow::graph_metrics snapshots.
+
+namespace flow
+{
+
+//!\brief A snapshot of the counters of a pipe.
+struct pipe_metrics
+{
+	std::string name;		//!< The name of the pipe.
+	size_t pushed;			//!< The number of packets moved to the pipe.
+	size_t dropped;			//!< The number of packets refused by the pipe because it had reached its maximum length or weight.
+	size_t high_water;		//!< The greatest length the pipe has reached.
+	size_t length;			//!< The length of the pipe at the time of the snapshot.
+	size_t weight;			//!< The weight of the pipe at the time of the snapshot.
+};
+
+//!\brief A snapshot of the counters of a node.
+struct node_metrics
+{
+	std::string name;					//!< The name of the node.
+	std::chrono::nanoseconds busy;		//!< The time spent producing and consuming packets, i.e. in produce(), ready() and ready_batch().
+	std::chrono::nanoseconds waiting;	//!< The time spent waiting for packets or for the node to be started.
+};
+
+//!\brief A snapshot of the memory budget of a graph.
+//!
+//! All zeros if the graph has no \ref graph::budget "budget".
+struct budget_metrics
+{
+	size_t limit;			//!< The number of bytes the pipes of the graph may hold, 0 for no limit.
+	size_t used;			//!< The number of bytes the pipes held at the time of the snapshot.
+	size_t high_water;		//!< The greatest number of bytes the pipes have held.
+	size_t refused;			//!< The number of pushes refused with budget_policy::backpressure.
+	size_t shed;			//!< The number of packets discarded with budget_policy::shed or budget_policy::drop_oldest.
+};
+
+//!\brief A snapshot of the counters of all nodes and pipes of a graph.
+struct graph_metrics
+{
+	std::vector<node_metrics> nodes;	//!< One entry per node.
+	std::vector<pipe_metrics> pipes;	//!< One entry per connected pipe.
+	budget_metrics budget;				//!< The memory budget shared by all pipes.
+};
+
+//!\brief What was left behind when a graph was drained.
+struct drain_report
+{
+	bool complete;						//!< Whether every node was stopped with its inputs empty before the timeout.
+	size_t left;						//!< The number of packets left in pipes, which would be consumed if the graph were started again.
+	std::vector<pipe_metrics> pipes;	//!< The pipes that still hold packets.
+	std::chrono::nanoseconds elapsed;	//!< The time it took to drain the graph.
+};
+
+//!\cond
+namespace detail
+{
+
+// A counter that only one thread at a time updates and any thread reads.
+// Updates are a plain load and store, cheap enough to always be enabled.
+class counter
+{
+	std::atomic<size_t> d_value_a;
+
+	counter& operator=(const counter&);
+
+public:
+	counter() : d_value_a(0) {}
+
+	counter(const counter& o) : d_value_a(o.value()) {}
+
+	void add(const size_t n)
+	{
+		d_value_a.store(d_value_a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	// Keeps the greatest value ever given.
+	void raise(const size_t n)
+	{
+		if(n > d_value_a.load(std::memory_order_relaxed))
+		{
+			d_value_a.store(n, std::memory_order_relaxed);
+		}
+	}
+
+	size_t value() const
+	{
+		return d_value_a.load(std::memory_order_relaxed);
+	}
+};
+
+// Adds the time elapsed during its lifetime, in nanoseconds, to a counter.
+class stopwatch
+{
+	counter &d_counter_r;
+	const std::chrono::steady_clock::time_point d_start;
+
+	stopwatch(const stopwatch&);
+	stopwatch& operator=(const stopwatch&);
+
+public:
+	stopwatch(counter& counter_r) : d_counter_r(counter_r), d_start(std::chrono::steady_clock::now()) {}
+
+	~stopwatch()
+	{
+		d_counter_r.add(static_cast<size_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - d_start).count()));
+	}
+};
+
+}
+//!\endcond
+
+}
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
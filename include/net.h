@@ -0,0 +1,765 @@
+#if !defined(FLOW_NET_H)
+	 #define FLOW_NET_H
+
+#include "node.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+//!\brief Defined when network transport nodes are available, i.e. on POSIX systems.
+#define FLOW_NET_SUPPORTED
+#endif
+
+//!\file net.h
+//!
+//!\brief Defines the \ref flow::net_sink and \ref flow::net_source classes that connect graphs of different hosts over TCP.
+
+namespace flow
+{
+
+//!\brief Turns data into bytes and back, to carry packets across a network.
+//!
+//! This default serializer copies trivially copyable data byte for byte, so both hosts must lay it out the same way.
+//! Specialize it, or give \ref net_sink and \ref net_source another class with the same members, for other types.
+//!
+//!\tparam T The type of data.
+template<typename T>
+struct serializer
+{
+	static_assert(std::is_trivially_copyable<T>::value, "specialize flow::serializer for data that is not trivially copyable");
+
+	//!\brief Whether the bytes of a value are the value itself, in which case they are sent straight from the packets, without copying them.
+	static const bool direct = true;
+
+	//!\brief Appends the bytes of a value to a buffer.
+	static void write(const T& t, std::vector<char>& buffer_r)
+	{
+		const char *p = reinterpret_cast<const char*>(&t);
+		buffer_r.insert(buffer_r.end(), p, p + sizeof(T));
+	}
+
+	//!\brief Reads a value and moves past its bytes.
+	//!
+	//!\return \c false if there are not enough bytes left.
+	static bool read(const char*& p_r, const char* end_p, T& t_r)
+	{
+		if(static_cast<size_t>(end_p - p_r) < sizeof(T))
+		{
+			return false;
+		}
+
+		std::memcpy(static_cast<void*>(&t_r), p_r, sizeof(T));
+		p_r += sizeof(T);
+
+		return true;
+	}
+};
+
+//!\brief Serializes strings as their length followed by their characters.
+template<>
+struct serializer<std::string>
+{
+	static const bool direct = false;
+
+	static void write(const std::string& s, std::vector<char>& buffer_r)
+	{
+		const uint32_t length = htonl(static_cast<uint32_t>(s.size()));
+		const char *p = reinterpret_cast<const char*>(&length);
+
+		buffer_r.insert(buffer_r.end(), p, p + sizeof(length));
+		buffer_r.insert(buffer_r.end(), s.begin(), s.end());
+	}
+
+	static bool read(const char*& p_r, const char* end_p, std::string& s_r)
+	{
+		uint32_t length;
+		if(static_cast<size_t>(end_p - p_r) < sizeof(length))
+		{
+			return false;
+		}
+
+		std::memcpy(&length, p_r, sizeof(length));
+		length = ntohl(length);
+
+		if(static_cast<size_t>(end_p - p_r) - sizeof(length) < length)
+		{
+			return false;
+		}
+
+		s_r.assign(p_r + sizeof(length), length);
+		p_r += sizeof(length) + length;
+
+		return true;
+	}
+};
+
+#if defined(FLOW_NET_SUPPORTED)
+
+//!\cond
+namespace detail
+{
+
+// Precedes the serialized packets of a frame. Both counts are in network byte order.
+struct frame_header
+{
+	uint32_t packets;
+	uint32_t bytes;
+};
+
+#if defined(MSG_NOSIGNAL)
+const int send_flags = MSG_NOSIGNAL;	// A peer that went away is reported as an error rather than with SIGPIPE.
+#else
+const int send_flags = 0;
+#endif
+
+inline void close_socket(int& fd_r)
+{
+	if(fd_r != -1)
+	{
+		::close(fd_r);
+		fd_r = -1;
+	}
+}
+
+// Frames are sent as soon as they are written, they are already batched.
+inline void configure_socket(const int fd)
+{
+	int one = 1;
+	::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#if defined(SO_NOSIGPIPE)
+	::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+}
+
+// Waits for a socket to be ready for reading or writing.
+inline bool await_socket(const int fd, const short events, const int timeout_ms)
+{
+	pollfd p;
+	p.fd = fd;
+	p.events = events;
+	p.revents = 0;
+
+	return ::poll(&p, 1, timeout_ms) > 0;
+}
+
+// Sends all the bytes of a sequence of buffers, gathering as many as the system allows per call.
+inline bool send_all(const int fd, iovec* iov_p, size_t n)
+{
+	const size_t max_iov = 1024;
+
+	while(n)
+	{
+		msghdr m;
+		std::memset(&m, 0, sizeof(m));
+		m.msg_iov = iov_p;
+		m.msg_iovlen = std::min(n, max_iov);
+
+		ssize_t sent = ::sendmsg(fd, &m, send_flags);
+		if(sent < 0)
+		{
+			if(errno == EINTR) continue;
+
+			return false;
+		}
+
+		// Skip over what went out, the last buffer may have gone out partially.
+		while(n && static_cast<size_t>(sent) >= iov_p->iov_len)
+		{
+			sent -= iov_p->iov_len;
+			++iov_p;
+			--n;
+		}
+
+		if(n)
+		{
+			iov_p->iov_base = static_cast<char*>(iov_p->iov_base) + sent;
+			iov_p->iov_len -= sent;
+		}
+	}
+
+	return true;
+}
+
+}
+//!\endcond
+
+//!\brief Concrete consumer that streams the packets it receives over TCP to a \ref net_source, typically on another host.
+//!
+//! Packets are sent in frames, as many per frame as are waiting and as the receiving side allows.
+//! A frame's header and its packets are handed to the system in a single scatter/gather write.
+//! When the data is sent directly, the bytes go straight from the packets to the socket.
+//!
+//! The receiving side grants credits, one per packet it has pushed downstream.
+//! This node never sends more packets than it was granted, so the pipes of the receiving graph throttle it
+//! just as they throttle a local producer: a capped pipe with overflow::block there holds it back here.
+//!
+//! The connection is made when the first packet arrives, and made again if it is lost.
+//! Once the node is paused or stopped, it keeps waiting for a connection or for credits for at most its \ref linger "linger" time,
+//! so that the packets it holds still go across when the graph is \ref graph::drain "drained". Packets that cannot be sent by then are dropped.
+//! Consumption times are not carried across.
+//!
+//!\tparam T The type of data.
+//!\tparam S The \ref serializer of the data.
+template<typename T, typename S = serializer<T>>
+class net_sink : public consumer<T>
+{
+	const std::string d_host;
+	const unsigned short d_port;
+
+	int d_fd;
+
+	size_t d_credits;				// Packets that may be sent.
+	char d_grant[sizeof(uint32_t)];	// A grant of credits being received.
+	size_t d_grant_size;
+
+	std::vector<char> d_buffer;		// Serialized packets, when the data is not sent directly.
+	std::vector<iovec> d_iov;
+
+	std::atomic<size_t> d_sent_a;
+	std::atomic<size_t> d_frames_a;
+	std::atomic<size_t> d_dropped_a;
+	std::atomic<std::chrono::milliseconds::rep> d_linger_a;
+
+	bool open()
+	{
+		addrinfo hints;
+		std::memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+
+		addrinfo *info_p = nullptr;
+		if(::getaddrinfo(d_host.c_str(), std::to_string(d_port).c_str(), &hints, &info_p) != 0)
+		{
+			return false;
+		}
+
+		for(addrinfo *a_p = info_p; a_p && d_fd == -1; a_p = a_p->ai_next)
+		{
+			d_fd = ::socket(a_p->ai_family, a_p->ai_socktype, a_p->ai_protocol);
+			if(d_fd != -1 && ::connect(d_fd, a_p->ai_addr, a_p->ai_addrlen) != 0)
+			{
+				detail::close_socket(d_fd);
+			}
+		}
+
+		::freeaddrinfo(info_p);
+
+		if(d_fd == -1)
+		{
+			return false;
+		}
+
+		detail::configure_socket(d_fd);
+		d_credits = 0;
+		d_grant_size = 0;
+
+		return true;
+	}
+
+	// Adds up the credits granted so far, waiting for some for at most timeout_ms.
+	// Returns false if the connection was lost.
+	bool collect(const int timeout_ms)
+	{
+		if(timeout_ms && !detail::await_socket(d_fd, POLLIN, timeout_ms))
+		{
+			return true;
+		}
+
+		while(true)
+		{
+			const ssize_t r = ::recv(d_fd, d_grant + d_grant_size, sizeof(d_grant) - d_grant_size, MSG_DONTWAIT);
+
+			if(r > 0)
+			{
+				d_grant_size += r;
+				if(d_grant_size == sizeof(d_grant))
+				{
+					uint32_t grant;
+					std::memcpy(&grant, d_grant, sizeof(grant));
+					d_credits += ntohl(grant);
+					d_grant_size = 0;
+				}
+			}
+			else if(r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+			{
+				return true;
+			}
+			else
+			{
+				return false;
+			}
+		}
+	}
+
+	// Waits until there is a connection and credits to send packets with.
+	// Once the node is no longer started, it only waits until a deadline, which is set the first time it has to wait.
+	bool sendable(std::chrono::steady_clock::time_point& deadline_r)
+	{
+		while(true)
+		{
+			if(node::state() != state::started)
+			{
+				const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+				if(deadline_r == std::chrono::steady_clock::time_point())
+				{
+					deadline_r = now + std::chrono::milliseconds(d_linger_a.load());
+				}
+				else if(now >= deadline_r)
+				{
+					return false;
+				}
+			}
+
+			if(d_fd == -1 && !open())
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				continue;
+			}
+
+			if(!collect(d_credits ? 0 : 10))
+			{
+				detail::close_socket(d_fd);
+				continue;
+			}
+
+			if(d_credits)
+			{
+				return true;
+			}
+		}
+	}
+
+	// Points at the data of the packets.
+	void gather(typename pipe<T>::packets_t& packets, const size_t first, const size_t count, std::true_type)
+	{
+		for(size_t i = first; i != first + count; ++i)
+		{
+			iovec v;
+			v.iov_base = static_cast<void*>(&packets[i]->data());
+			v.iov_len = sizeof(T);
+			d_iov.push_back(v);
+		}
+	}
+
+	// Serializes the data of the packets.
+	void gather(typename pipe<T>::packets_t& packets, const size_t first, const size_t count, std::false_type)
+	{
+		d_buffer.clear();
+		for(size_t i = first; i != first + count; ++i)
+		{
+			S::write(packets[i]->data(), d_buffer);
+		}
+
+		if(!d_buffer.empty())
+		{
+			iovec v;
+			v.iov_base = &d_buffer[0];
+			v.iov_len = d_buffer.size();
+			d_iov.push_back(v);
+		}
+	}
+
+	bool frame(typename pipe<T>::packets_t& packets, const size_t first, const size_t count)
+	{
+		d_iov.resize(1);
+		gather(packets, first, count, std::integral_constant<bool, S::direct>());
+
+		size_t bytes = 0;
+		for(size_t i = 1; i != d_iov.size(); ++i)
+		{
+			bytes += d_iov[i].iov_len;
+		}
+
+		detail::frame_header header;
+		header.packets = htonl(static_cast<uint32_t>(count));
+		header.bytes = htonl(static_cast<uint32_t>(bytes));
+
+		d_iov[0].iov_base = &header;
+		d_iov[0].iov_len = sizeof(header);
+
+		return detail::send_all(d_fd, &d_iov[0], d_iov.size());
+	}
+
+	void forward(typename pipe<T>::packets_t& packets)
+	{
+		std::chrono::steady_clock::time_point deadline;
+
+		for(size_t first = 0; first != packets.size();)
+		{
+			if(!sendable(deadline))
+			{
+				d_dropped_a += packets.size() - first;
+				return;
+			}
+
+			const size_t count = std::min(packets.size() - first, d_credits);
+
+			if(frame(packets, first, count))
+			{
+				d_credits -= count;
+				d_sent_a += count;
+				++d_frames_a;
+			}
+			else
+			{
+				detail::close_socket(d_fd);
+				d_dropped_a += count;
+			}
+
+			first += count;
+		}
+	}
+
+public:
+	//! This consumer has only one input.
+	//!
+	//!\param host_r The name or address of the host the \ref net_source listens on.
+	//!\param port The port the \ref net_source listens on.
+	//!\param name_r The name to give this node.
+	net_sink(const std::string& host_r, const unsigned short port, const std::string& name_r = "net_sink") :
+		node(name_r), consumer<T>(name_r, 1), d_host(host_r), d_port(port), d_fd(-1), d_credits(0), d_grant_size(0), d_sent_a(0), d_frames_a(0), d_dropped_a(0), d_linger_a(1000)
+	{
+		consumer<T>::template batch<net_sink>();
+	}
+
+	virtual ~net_sink()
+	{
+		detail::close_socket(d_fd);
+	}
+
+	//!\brief The number of packets sent so far.
+	virtual size_t sent() const
+	{
+		return d_sent_a;
+	}
+
+	//!\brief The number of frames sent so far.
+	virtual size_t frames() const
+	{
+		return d_frames_a;
+	}
+
+	//!\brief The number of packets dropped because they still could not be sent a while after the node was paused or stopped, or because the connection was lost.
+	virtual size_t dropped() const
+	{
+		return d_dropped_a;
+	}
+
+	//!\brief Sets how long to keep waiting for a connection or for credits once this node is paused or stopped. The default is one second.
+	virtual void linger(const std::chrono::milliseconds& linger)
+	{
+		d_linger_a = linger.count();
+	}
+
+	//!\brief The address of the \ref net_source, as a remote endpoint.
+	virtual std::string remote() const
+	{
+		return "tcp://" + d_host + ":" + std::to_string(d_port);
+	}
+
+	//!\brief Waiting on the network is waiting on something else than the input pins.
+	virtual bool blocks() const
+	{
+		return true;
+	}
+
+	//!\brief Implementation of consumer::ready().
+	virtual void ready(size_t)
+	{
+		typename pipe<T>::packets_t packets;
+		packets.push_back(consumer<T>::input(0).pop());
+
+		if(packets.back())
+		{
+			forward(packets);
+		}
+	}
+
+	//!\brief Implementation of consumer::ready_batch().
+	virtual void ready_batch(size_t, typename pipe<T>::packets_t& packets)
+	{
+		forward(packets);
+	}
+};
+
+//!\brief Concrete producer that pushes the packets a \ref net_sink streams to it over TCP.
+//!
+//! It listens on a port and accepts one connection at a time.
+//! It grants the sending side a window of credits when it connects, then grants one more credit for each packet it pushes.
+//! Credits are granted back in bulk, once half a window is due.
+//! A push that blocks on a full pipe holds back the grants and so, once the window is used up, the sending side.
+//!
+//!\tparam T The type of data. It must be default-constructible.
+//!\tparam S The \ref serializer of the data.
+template<typename T, typename S = serializer<T>>
+class net_source : public producer<T>
+{
+	static const size_t chunk_size = 1 << 16;	// The number of bytes read at once.
+
+	int d_listen_fd;
+	int d_fd;
+	unsigned short d_port;
+
+	const size_t d_window;
+	size_t d_ungranted;		// Packets pushed since the last grant.
+
+	std::vector<char> d_input;	// Bytes received and not yet parsed.
+
+	std::atomic<size_t> d_received_a;
+	std::atomic<size_t> d_frames_a;
+
+	bool grant(const size_t credits)
+	{
+		const uint32_t g = htonl(static_cast<uint32_t>(credits));
+
+		iovec v;
+		v.iov_base = const_cast<uint32_t*>(&g);
+		v.iov_len = sizeof(g);
+
+		return detail::send_all(d_fd, &v, 1);
+	}
+
+	void accept()
+	{
+		if(!detail::await_socket(d_listen_fd, POLLIN, 10))
+		{
+			return;
+		}
+
+		d_fd = ::accept(d_listen_fd, nullptr, nullptr);
+		if(d_fd == -1)
+		{
+			return;
+		}
+
+		detail::configure_socket(d_fd);
+		d_input.clear();
+		d_ungranted = 0;
+
+		if(!grant(d_window))
+		{
+			detail::close_socket(d_fd);
+		}
+	}
+
+	// Pushes the packets of all complete frames received so far.
+	// Returns false if a frame could not be parsed.
+	bool parse()
+	{
+		size_t offset = 0;
+
+		while(d_input.size() - offset >= sizeof(detail::frame_header))
+		{
+			detail::frame_header header;
+			std::memcpy(&header, &d_input[offset], sizeof(header));
+
+			const size_t packets = ntohl(header.packets);
+			const size_t bytes = ntohl(header.bytes);
+
+			if(d_input.size() - offset - sizeof(header) < bytes)
+			{
+				break;
+			}
+
+			const char *p = d_input.data() + offset + sizeof(header), *end_p = p + bytes;
+			for(size_t i = 0; i != packets; ++i)
+			{
+				T t;
+				if(!S::read(p, end_p, t))
+				{
+					return false;
+				}
+
+				std::unique_ptr<packet<T>> packet_p(producer<T>::make_packet(std::move(t)));
+				producer<T>::output(0).push(packet_p);
+
+				++d_received_a;
+				++d_ungranted;
+			}
+
+			offset += sizeof(header) + bytes;
+			++d_frames_a;
+		}
+
+		d_input.erase(d_input.begin(), d_input.begin() + offset);
+
+		return true;
+	}
+
+public:
+	//! This producer has only one output.
+	//!
+	//!\param port The port to listen on. Set to 0 to let the system pick one, see \ref port.
+	//!\param window The number of packets the sending side may send ahead of those pushed by this node.
+	//!\param name_r The name to give this node.
+	net_source(const unsigned short port, const size_t window = 1024, const std::string& name_r = "net_source") :
+		node(name_r), producer<T>(name_r, 1), d_listen_fd(-1), d_fd(-1), d_port(port), d_window(window ? window : 1), d_ungranted(0), d_received_a(0), d_frames_a(0)
+	{
+		d_listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+		if(d_listen_fd == -1)
+		{
+			return;
+		}
+
+		int one = 1;
+		::setsockopt(d_listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+		sockaddr_in a;
+		std::memset(&a, 0, sizeof(a));
+		a.sin_family = AF_INET;
+		a.sin_addr.s_addr = htonl(INADDR_ANY);
+		a.sin_port = htons(port);
+
+		socklen_t size = sizeof(a);
+		if(::bind(d_listen_fd, reinterpret_cast<sockaddr*>(&a), sizeof(a)) != 0 || ::listen(d_listen_fd, 1) != 0 ||
+		   ::getsockname(d_listen_fd, reinterpret_cast<sockaddr*>(&a), &size) != 0)
+		{
+			detail::close_socket(d_listen_fd);
+			return;
+		}
+
+		d_port = ntohs(a.sin_port);
+	}
+
+	virtual ~net_source()
+	{
+		detail::close_socket(d_fd);
+		detail::close_socket(d_listen_fd);
+	}
+
+	//!\brief Whether the node listens for a connection.
+	virtual bool is_open() const
+	{
+		return d_listen_fd != -1;
+	}
+
+	//!\brief The port the node listens on.
+	virtual unsigned short port() const
+	{
+		return d_port;
+	}
+
+	//!\brief The number of packets received so far.
+	virtual size_t received() const
+	{
+		return d_received_a;
+	}
+
+	//!\brief The number of frames received so far.
+	virtual size_t frames() const
+	{
+		return d_frames_a;
+	}
+
+	//!\brief The port this node listens on, as a remote endpoint.
+	virtual std::string remote() const
+	{
+		return "tcp://*:" + std::to_string(d_port);
+	}
+
+	//!\brief Waiting on the network is waiting on something else than the input pins.
+	virtual bool blocks() const
+	{
+		return true;
+	}
+
+	//!\brief Implementation of producer::produce().
+	//!
+	//! Waits a little while for a connection or for bytes so that state changes are noticed promptly.
+	virtual void produce()
+	{
+		if(d_listen_fd == -1)
+		{
+			std::this_thread::yield();
+			return;
+		}
+
+		if(d_fd == -1)
+		{
+			accept();
+			return;
+		}
+
+		if(!detail::await_socket(d_fd, POLLIN, 10))
+		{
+			return;
+		}
+
+		const size_t used = d_input.size();
+		d_input.resize(used + chunk_size);
+
+		const ssize_t r = ::recv(d_fd, &d_input[used], chunk_size, 0);
+		d_input.resize(used + (r > 0 ? r : 0));
+
+		if(r == 0 || (r < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) || (r > 0 && !parse()))
+		{
+			// The sending side went away or sent garbage. Wait for it to connect again.
+			detail::close_socket(d_fd);
+			return;
+		}
+
+		if(d_ungranted >= (d_window + 1) / 2)
+		{
+			if(!grant(d_ungranted))
+			{
+				detail::close_socket(d_fd);
+			}
+
+			d_ungranted = 0;
+		}
+	}
+};
+
+#endif
+
+}
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
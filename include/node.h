@@ -1,14 +1,22 @@
 #if !defined(FLOW_NODE_H)
 	 #define FLOW_NODE_H
 
+#include "event.h"
+#include "metrics.h"
 #include "named.h"
 #include "packet.h"
 #include "pipe.h"
+#include "pool.h"
+#include "scheduler.h"
+#include "trace.h"
 
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 #include <utility>
@@ -55,6 +63,256 @@ enum type
 
 }
 
+//!\namespace flow::service_order
+//!
+//!\brief Contains the different service order values.
+namespace service_order
+{
+
+//!\enum type
+//!
+//!\brief How a consumer chooses which of its inpins with packets waiting to service.
+enum type
+{
+	round_robin,	//!< Every inpin is serviced once per round, in index order.
+	priority,		//!< Only the inpin of highest \ref flow::inpin::priority "priority" is serviced until it runs dry.
+	weighted,		//!< Every inpin is serviced as many times per round as its \ref flow::inpin::share "share".
+	earliest		//!< The inpin whose next packet has the earliest consumption time is serviced first.
+};
+
+}
+
+//!\brief Base class common to all nodes.
+class node : public named, public detail::task
+{
+	std::atomic<state::type> d_state_a; //!< The state of this node.
+
+	std::atomic<scheduler*> d_scheduler_a; //!< The scheduler that runs this node. Null when the node has a thread of its own.
+	std::atomic<node*> d_host_a; //!< The node whose thread also runs this node, when fused with it. Null otherwise.
+
+	std::shared_ptr<detail::budget> d_budget_sp; //!< The memory budget of the graph this node belongs to, charged by the pipes it pushes to. Null if there is none.
+
+	//!\brief Changes this node's state.
+	//!
+	//!\param s The new state.
+	virtual void transition(state::type s)
+	{
+		std::unique_lock<std::mutex> ul(d_transition_m);
+
+		d_state_a = s;
+
+		detail::trace(hook::transition, this, nullptr, s);
+
+		// Notify the concrete class.
+		switch(s)
+		{
+		case state::started: started(); break;
+		case state::paused: paused(); break;
+		case state::stopped: stopped(); break;
+		default: break;
+		}
+
+		// Notify the execution loop.
+		d_transition_cv.notify_one();
+		d_wakeup_e.notify();
+	}
+
+	friend class graph;
+
+	template<typename T>
+	friend class outpin;
+
+protected:
+	std::condition_variable d_transition_cv;	//!< The condition variable to monitor the node's state.
+	std::mutex d_transition_m;					//!< The mutex to lock when waiting on d_transition_cv.
+
+	event d_wakeup_e;							//!< Notified when a packet arrives at an input pin or when the state changes.
+
+	detail::counter d_busy_ns;		//!< Nanoseconds spent producing and consuming packets.
+	detail::counter d_waiting_ns;	//!< Nanoseconds spent waiting for packets or for a state change.
+
+	//!\brief Disconnect all pins.
+	virtual void sever() = 0;
+
+	//!\brief Signals the packets waiting at the input pins to the concrete class.
+	//!
+	//!\return \c true if packets were waiting at any input pin. Nodes with no input pins return \c false.
+	virtual bool service()
+	{
+		return false;
+	}
+
+public:
+	//! Constructor.
+	//!
+	//!\param name_r The name to give this node.
+	node(const std::string& name_r) : named(name_r), d_state_a(state::paused), d_scheduler_a(nullptr), d_host_a(nullptr)
+	{}
+
+	//!\brief Move constructor.
+	node(node&& node_rr) : named(std::move(node_rr)), d_state_a(node_rr.d_state_a.load()), d_scheduler_a(nullptr), d_host_a(nullptr)
+	{}
+	
+	virtual ~node() {}
+
+	//!\brief Returns the node's state
+	virtual state::type state() const
+	{
+		return d_state_a;
+	}
+	
+	//!\brief Indicates the node has been started.
+	//!
+	//! Concrete nodes can override this function to be notified of the state transition.
+	virtual void started() {}
+
+	//!\brief Indicates the node has been paused.
+	//!
+	//! Concrete nodes can override this function to be notified of the state transition.
+	virtual void paused() {}
+
+	//!\brief Indicates the node has been stopped.
+	//!
+	//! Concrete nodes can override this function to be notified of the state transition.
+	virtual void stopped() {}
+
+	//!\brief Whether this node may block for long periods of time.
+	//!
+	//! A graph that runs its nodes on a \ref scheduler still gives a thread of its own to a node that blocks.
+	//! Concrete nodes that wait on something else than their input pins, e.g. a timer, should override this function to return \c true.
+	virtual bool blocks() const
+	{
+		return false;
+	}
+
+	//!\brief The endpoint in another process or on another host this node exchanges packets with.
+	//!
+	//! Nodes that bridge graphs, like \ref shm_sink or \ref net_source, return an address that \ref graph::to_dot shows as a remote edge.
+	//! All other nodes return an empty string.
+	virtual std::string remote() const
+	{
+		return std::string();
+	}
+
+	//!\brief Signals this node that a packet has arrived at one of its input pins.
+	//!
+	//! If the node runs on a scheduler, it is queued there.
+	//! If it is fused with other nodes, the node whose thread runs them all is signaled instead.
+	//! Otherwise, its execution function is notified.
+	virtual void wake()
+	{
+		scheduler *scheduler_p = d_scheduler_a.load();
+		node *host_p = d_host_a.load();
+
+		if(scheduler_p)
+		{
+			if(d_state_a == state::started)
+			{
+				scheduler_p->schedule(this);
+			}
+		}
+		else if(host_p)
+		{
+			host_p->wake();
+		}
+		else
+		{
+			d_wakeup_e.notify();
+		}
+	}
+
+	//!\brief A snapshot of this node's counters.
+	//!
+	//! Can be called from any thread while the node runs.
+	//! A node that runs on a \ref scheduler does not wait for packets, it is queued when they arrive.
+	virtual node_metrics metrics() const
+	{
+		node_metrics m;
+
+		m.name = name();
+		m.busy = std::chrono::nanoseconds(d_busy_ns.value());
+		m.waiting = std::chrono::nanoseconds(d_waiting_ns.value());
+
+		return m;
+	}
+
+	//!\brief Appends a snapshot of the counters of the pipes this node pushes packets to.
+	//!
+	//! Must not be called while this node's pins are being connected or disconnected.
+	virtual void pipes_metrics(std::vector<pipe_metrics>&) const {}
+
+	//!\brief Sets how long this node busy-waits for packets before it sleeps.
+	//!
+	//! Busy-waiting lowers the latency of a node at the cost of CPU time.
+	//! Only applies to a node running on a thread of its own.
+	//!
+	//!\param spins The number of times to poll before yielding.
+	//!\param yields The number of times to yield before sleeping.
+	virtual void spin(const size_t spins, const size_t yields = 0)
+	{
+		d_wakeup_e.spin(spins, yields);
+	}
+
+	//!\brief The node's execution function.
+	//!
+	//! When the node is started, this function is called.
+	//! It will exit when the node is stopped.
+	virtual void operator()() = 0;
+};
+
+//!\cond
+namespace detail
+{
+
+// Flags raised by inpins as packets arrive, so that a node can tell which of its inpins have packets without locking their pipes.
+class arrivals
+{
+	std::unique_ptr<std::atomic<bool>[]> d_flags_a;
+	std::atomic<size_t> d_raised_a;	// The number of raised flags.
+
+	arrivals(const arrivals&);
+	arrivals& operator=(const arrivals&);
+
+public:
+	arrivals(const size_t n) : d_flags_a(new std::atomic<bool>[n]), d_raised_a(0)
+	{
+		for(size_t i = 0; i != n; ++i)
+		{
+			d_flags_a[i].store(false, std::memory_order_relaxed);
+		}
+	}
+
+	// Called by the inpin after a packet was moved to its pipe.
+	void raise(const size_t i)
+	{
+		if(!d_flags_a[i].exchange(true, std::memory_order_acq_rel))
+		{
+			d_raised_a.fetch_add(1, std::memory_order_release);
+		}
+	}
+
+	// Called by the node before extracting all packets from the inpin's pipe.
+	bool lower(const size_t i)
+	{
+		if(d_flags_a[i].exchange(false, std::memory_order_acq_rel))
+		{
+			d_raised_a.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		return false;
+	}
+
+	// Whether any flag is raised.
+	bool raised() const
+	{
+		return d_raised_a.load(std::memory_order_acquire) != 0;
+	}
+};
+
+}
+//!\endcond
+
 //!\brief Base class for a node's inlet or outlet.
 //!
 //! Pins are connected to one another through pipes.
@@ -63,7 +321,20 @@ template<typename T>
 class pin : public named
 {
 protected:
-	std::shared_ptr<std::pair<pipe<T>, std::unique_ptr<std::mutex>>> d_pipe_sp; //!< Shared ownership of a pipe with the pin to which this pin is connected.
+	std::shared_ptr<std::pair<std::unique_ptr<pipe<T>>, std::unique_ptr<std::mutex>>> d_pipe_sp; //!< Shared ownership of a pipe with the pin to which this pin is connected.
+
+	//!\brief Locks the pipe's mutex, unless the pipe is \ref pipe::concurrent "concurrent".
+	//!
+	//! This pin must be connected to a pipe.
+	std::unique_lock<std::mutex> lock_pipe() const
+	{
+		if(d_pipe_sp->first->concurrent())
+		{
+			return std::unique_lock<std::mutex>();
+		}
+
+		return std::unique_lock<std::mutex>(*d_pipe_sp->second);
+	}
 
 	friend class outpin<T>;
 
@@ -89,8 +360,13 @@ public:
 template<typename T>
 class inpin : public pin<T>
 {
-	std::condition_variable *d_transition_cv_p;
-	std::mutex *d_transition_m_p;
+	node *d_node_p;
+
+	detail::arrivals *d_arrivals_p;	// Told about arriving packets, if the owning node tracks them.
+	size_t d_index;					// The index of this inpin in the owning node.
+
+	std::atomic<int> d_priority_a;	// Consulted under service_order::priority.
+	std::atomic<size_t> d_share_a;	// Consulted under service_order::weighted.
 
 	using pin<T>::d_pipe_sp;
 
@@ -99,7 +375,7 @@ class inpin : public pin<T>
 	{
 		{
 			std::lock_guard<std::mutex> lg(*d_pipe_sp->second);
-			d_pipe_sp->first.rename(d_pipe_sp->first.input()->name() + "_to_" + "nothing");
+			d_pipe_sp->first->rename((d_pipe_sp->first->input() ? d_pipe_sp->first->input()->name() : std::string("nothing")) + "_to_" + "nothing");
 		}
 
 		pin<T>::disconnect();
@@ -111,10 +387,14 @@ public:
 	//!\brief Constructor.
 	//!
 	//!\param name_r The name to give this node.
-	//!\param transition_cv_p Pointer to the node's transition condition_variable.
-	//!\param transition_m_p Pointer to the node's transition mutex.
-	inpin(const std::string& name_r, std::condition_variable* transition_cv_p, std::mutex *transition_m_p)
-		: pin<T>(name_r), d_transition_cv_p(transition_cv_p), d_transition_m_p(transition_m_p)
+	//!\param node_p Pointer to the node that owns this pin.
+	inpin(const std::string& name_r, node *node_p)
+		: pin<T>(name_r), d_node_p(node_p), d_arrivals_p(nullptr), d_index(0), d_priority_a(0), d_share_a(1)
+	{}
+
+	//!\brief Copy constructor, for the container of inpins of the owning node.
+	inpin(const inpin& inpin_r)
+		: pin<T>(inpin_r), d_node_p(inpin_r.d_node_p), d_arrivals_p(inpin_r.d_arrivals_p), d_index(inpin_r.d_index), d_priority_a(inpin_r.priority()), d_share_a(inpin_r.share())
 	{}
 
 	virtual ~inpin() {}
@@ -129,9 +409,9 @@ public:
 		if(d_pipe_sp)
 		{
 			std::lock_guard<std::mutex> lg(*d_pipe_sp->second);
-			if(d_pipe_sp->first.input())
+			if(d_pipe_sp->first->input())
 			{
-				d_pipe_sp->first.rename(d_pipe_sp->first.input()->name() + "_to_" + name_r);
+				d_pipe_sp->first->rename(d_pipe_sp->first->input()->name() + "_to_" + name_r);
 			}
 		}
 
@@ -145,25 +425,147 @@ public:
 	{
 		if(d_pipe_sp)
 		{
-			std::lock_guard<std::mutex> lg(*d_pipe_sp->second);
-			return d_pipe_sp->first.length() != 0;
+			std::unique_lock<std::mutex> ul(pin<T>::lock_pipe());
+			return d_pipe_sp->first->length() != 0;
 		}
 
 		return false;
 	}
 
+	//!\brief The number of packets in the pipe.
+	//!
+	//!\return 0 if there is no pipe.
+	virtual size_t length() const
+	{
+		if(d_pipe_sp)
+		{
+			std::unique_lock<std::mutex> ul(pin<T>::lock_pipe());
+			return d_pipe_sp->first->length();
+		}
+
+		return 0;
+	}
+
+	//!\brief The consumption time of the next packet in the pipe.
+	//!
+	//!\param time_r Set to the consumption time of the next packet, if there is one.
+	//!
+	//!\return \c false if there is no pipe or the pipe is empty, \c true otherwise.
+	virtual bool due(typename packet<T>::time_point_type& time_r) const
+	{
+		if(d_pipe_sp)
+		{
+			std::unique_lock<std::mutex> ul(pin<T>::lock_pipe());
+			if(const packet<T> *packet_p = d_pipe_sp->first->front())
+			{
+				time_r = packet_p->consumption_time();
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	//!\brief The priority of this inpin.
+	//!
+	//! Under service_order::priority, the owning consumer only services this inpin when no inpin of higher priority has packets waiting.
+	//! The default priority is 0.
+	virtual int priority() const
+	{
+		return d_priority_a.load(std::memory_order_relaxed);
+	}
+
+	//!\brief Sets the priority of this inpin.
+	//!
+	//!\return The previous priority.
+	virtual int prioritize(const int priority)
+	{
+		return d_priority_a.exchange(priority, std::memory_order_relaxed);
+	}
+
+	//!\brief The number of times this inpin is serviced per round under service_order::weighted.
+	//!
+	//! The default share is 1.
+	virtual size_t share() const
+	{
+		return d_share_a.load(std::memory_order_relaxed);
+	}
+
+	//!\brief Sets the number of times this inpin is serviced per round under service_order::weighted.
+	//!
+	//! An inpin with a share of 0 is never serviced under service_order::weighted.
+	//!
+	//!\return The previous share.
+	virtual size_t set_share(const size_t share)
+	{
+		return d_share_a.exchange(share, std::memory_order_relaxed);
+	}
+
 	//!\brief Extracts a packet from the pipe.
 	//!
 	//!\return The next packet to be consumed if the inpin is connected to a pipe and the pipe is not empty, empty pointer otherwise.
 	virtual std::unique_ptr<packet<T>> pop()
 	{
+		std::unique_ptr<packet<T>> packet_p;
+		outpin<T>* outpin_p = 0;
+
 		if(d_pipe_sp)
 		{
-			std::lock_guard<std::mutex> lg(*d_pipe_sp->second);
-			return d_pipe_sp->first.pop();
+			std::unique_lock<std::mutex> ul(pin<T>::lock_pipe());
+			packet_p = d_pipe_sp->first->pop();
+
+			if(packet_p && d_pipe_sp->first->overflow_policy() == overflow::block)
+			{
+				outpin_p = d_pipe_sp->first->input();
+			}
+		}
+
+		if(packet_p)
+		{
+			detail::trace(hook::pop, d_node_p, packet_p.get(), 1);
+		}
+
+		if(outpin_p)
+		{
+			outpin_p->vacated();
+		}
+
+		return packet_p;
+	}
+
+	//!\brief Extracts many packets from the pipe under a single lock.
+	//!
+	//!\param packets The container to which extracted packets are appended.
+	//!\param max_n The maximum number of packets to extract. Do not set to extract all packets.
+	//!
+	//!\return The number of packets extracted.
+	virtual size_t pop_n(typename pipe<T>::packets_t& packets, const size_t max_n = static_cast<size_t>(-1))
+	{
+		size_t n = 0;
+		outpin<T>* outpin_p = 0;
+
+		if(d_pipe_sp)
+		{
+			std::unique_lock<std::mutex> ul(pin<T>::lock_pipe());
+			n = d_pipe_sp->first->pop_n(packets, max_n);
+
+			if(n && d_pipe_sp->first->overflow_policy() == overflow::block)
+			{
+				outpin_p = d_pipe_sp->first->input();
+			}
+		}
+
+		if(n)
+		{
+			detail::trace(hook::pop, d_node_p, packets[packets.size() - n].get(), n);
+		}
+
+		if(outpin_p)
+		{
+			outpin_p->vacated();
 		}
 
-		return std::unique_ptr<packet<T>>();
+		return n;
 	}
 
 	//!\brief Notifies this pin that a packet has been queued to the pipe.
@@ -172,8 +574,12 @@ public:
 	//! If this inpin's owning node state is flow::started, it touches the state signal the node there is a packet to be consumed.
 	virtual void incoming()
 	{
-		std::unique_lock<std::mutex> ul(*d_transition_m_p);
-		d_transition_cv_p->notify_one();
+		if(d_arrivals_p)
+		{
+			d_arrivals_p->raise(d_index);
+		}
+
+		d_node_p->wake();
 	}
 };
 
@@ -183,6 +589,8 @@ public:
 template<typename T>
 class outpin : public pin<T>
 {
+	node *d_node_p;
+
 	using pin<T>::d_pipe_sp;
 	
 	//!\brief Disconnect this outpin.
@@ -190,7 +598,10 @@ class outpin : public pin<T>
 	{
 		{
 			std::lock_guard<std::mutex> lg(*d_pipe_sp->second);
-			d_pipe_sp->first.rename(std::string("nothing") + "_to_" + d_pipe_sp->first.output()->name());
+			d_pipe_sp->first->rename(std::string("nothing") + "_to_" + d_pipe_sp->first->output()->name());
+
+			// The inpin keeps the pipe, it must not refer to this outpin anymore.
+			d_pipe_sp->first->d_input_p = nullptr;
 		}
 
 		pin<T>::disconnect();
@@ -204,7 +615,9 @@ class outpin : public pin<T>
 	//!\param inpin_r The inpin to which to connect this outpin.
 	//!\param max_length The maximum length to give the pipe. Do not set or set to 0 for uncapped length.
 	//!\param max_weight The maximum weight to give the pipe. Do not set or set to 0 for uncapped weight.
-	virtual void connect(inpin<T>& inpin_r, const size_t max_length = 0, const size_t max_weight = 0)
+	//!\param kind The implementation of the pipe to make. Ignored if the input pin's pipe is reused.
+	//!\param policy What the pipe does with packets that do not fit.
+	virtual void connect(inpin<T>& inpin_r, const size_t max_length = 0, const size_t max_weight = 0, const pipe_type::type kind = pipe_type::deque, const overflow::type policy = overflow::reject)
 	{
 		// Disconnect this outpin from it's pipe, if it has one.
 		if(d_pipe_sp)
@@ -215,160 +628,270 @@ class outpin : public pin<T>
 		if(inpin_r.pin<T>::d_pipe_sp)
 		{
 			// The inpin already has a pipe, connect this outpin to it.
-			std::lock_guard<std::mutex> lg(*inpin_r.pin<T>::d_pipe_sp->second);
-			
-			pipe<T> &inpin_pipe = inpin_r.pin<T>::d_pipe_sp->first;
+			auto pipe_sp = inpin_r.pin<T>::d_pipe_sp;
+			pipe<T> &inpin_pipe = *pipe_sp->first;
 
 			//... but first, disconnects it from it's other output pin.
-			if(inpin_pipe.input())
+			outpin<T> *previous_p;
 			{
-				inpin_pipe.input()->disconnect();
+				std::lock_guard<std::mutex> lg(*pipe_sp->second);
+				previous_p = inpin_pipe.input();
 			}
 
-			inpin_pipe.rename(pin<T>::name() + "_to_" + inpin_pipe.name());
+			if(previous_p)
+			{
+				previous_p->disconnect();
+			}
+
+			std::lock_guard<std::mutex> lg(*pipe_sp->second);
+
+			inpin_pipe.d_input_p = this;
+			inpin_pipe.rename(pin<T>::name() + "_to_" + inpin_r.pin<T>::name());
 
 			// Overwrite the pipe's parameters with new ones.
 			inpin_pipe.cap_length(max_length);
-			inpin_pipe.cap_length(max_weight);
+			inpin_pipe.cap_weight(max_weight);
+			inpin_pipe.set_overflow_policy(policy);
+			inpin_pipe.meter(d_node_p->d_budget_sp);
+
+			d_pipe_sp = pipe_sp;
 		}
 		else
 		{
 			// The inpin has no pipe, make a new one.
-			pipe<T> p(pin<T>::name() + "_to_" + inpin_r.pin<T>::name(), this, &inpin_r, max_length, max_weight);
-			d_pipe_sp = inpin_r.pin<T>::d_pipe_sp = std::make_shared<std::pair<pipe<T>, std::unique_ptr<std::mutex>>>(std::make_pair(std::move(p), std::unique_ptr<std::mutex>(new std::mutex()))); 
+			const std::string name(pin<T>::name() + "_to_" + inpin_r.pin<T>::name());
+
+			std::unique_ptr<pipe<T>> p;
+			if(kind == pipe_type::ring)
+			{
+				p.reset(new ring_pipe<T>(name, this, &inpin_r, max_length, max_weight, policy));
+			}
+			else
+			{
+				p.reset(new pipe<T>(name, this, &inpin_r, max_length, max_weight, policy));
+			}
+
+			// Metered before it is shared with the inpin, so that no packet goes through it unaccounted for.
+			p->meter(d_node_p->d_budget_sp);
+
+			d_pipe_sp = inpin_r.pin<T>::d_pipe_sp = std::make_shared<std::pair<std::unique_ptr<pipe<T>>, std::unique_ptr<std::mutex>>>(std::move(p), std::unique_ptr<std::mutex>(new std::mutex()));
 		}
 	}
 
+	//!\brief Makes the pipe count against a memory budget, or none if \c nullptr.
+	void meter(const std::shared_ptr<detail::budget>& budget_sp)
+	{
+		if(!d_pipe_sp) return;
+
+		std::unique_lock<std::mutex> ul(pin<T>::lock_pipe());
+		d_pipe_sp->first->meter(budget_sp);
+	}
+
+	//!\brief Sets the priority of the pipe.
+	//!
+	//!\return \c false if this outpin is not connected.
+	bool prioritize(const int priority)
+	{
+		if(!d_pipe_sp) return false;
+
+		std::unique_lock<std::mutex> ul(pin<T>::lock_pipe());
+		d_pipe_sp->first->prioritize(priority);
+
+		return true;
+	}
+
+	//!\brief Notifies this pin that room has been made in a pipe whose overflow policy is overflow::block.
+	void vacated()
+	{
+		d_node_p->wake();
+	}
+
+	//!\brief Whether a push that was refused should be attempted again.
+	//!
+	//! True if the pipe is blocking, the packet was not discarded and the producing node is still started.
+	bool retry(const std::unique_ptr<packet<T>>& packet_p, const overflow::type policy) const
+	{
+		return policy == overflow::block && packet_p && d_node_p->state() == state::started;
+	}
+
 	friend class producer<T>;
+	friend class inpin<T>;
+
+public:
+	//!\param name_r The name to give this outpin.
+	//!\param node_p Pointer to the node that owns this pin.
+	outpin(const std::string& name_r, node *node_p) : pin<T>(name_r), d_node_p(node_p) {}
+
+	virtual ~outpin() {}
+
+	//!\brief Overrides named::rename.
+	//!
+	//! Ensures pipe is also renamed.
+	//!
+	//!\param name_r New name to give this outpin.
+	virtual std::string rename(const std::string& name_r)
+	{
+		if(d_pipe_sp)
+		{
+			std::lock_guard<std::mutex> lg(*d_pipe_sp->second);
+			if(d_pipe_sp->first->output())
+			{
+				d_pipe_sp->first->rename(name_r + "_to_" + d_pipe_sp->first->output()->name());
+			}
+		}
+
+		return named::rename(name_r);
+	}
+
+	//!\brief Whether this outpin is connected to a pipe.
+	virtual bool connected() const
+	{
+		return d_pipe_sp != nullptr;
+	}
+
+	//!\brief The number of packets in the pipe.
+	//!
+	//!\return 0 if there is no pipe.
+	virtual size_t length() const
+	{
+		if(d_pipe_sp)
+		{
+			std::unique_lock<std::mutex> ul(pin<T>::lock_pipe());
+			return d_pipe_sp->first->length();
+		}
+
+		return 0;
+	}
+
+	//!\brief A snapshot of the counters of the pipe.
+	//!
+	//! This outpin must be connected.
+	virtual pipe_metrics metrics() const
+	{
+		std::unique_lock<std::mutex> ul(pin<T>::lock_pipe());
+		return d_pipe_sp->first->metrics();
+	}
+
+	//!\brief Whether this outpin is connected to a pipe that may refuse packets, i.e. one with a maximum length or weight.
+	virtual bool capped() const
+	{
+		if(!d_pipe_sp) return false;
+
+		std::unique_lock<std::mutex> ul(pin<T>::lock_pipe());
+		return d_pipe_sp->first->max_length() || d_pipe_sp->first->max_weight();
+	}
+
+	//!\brief Whether this outpin is connected to a pipe that has reached its maximum length or weight.
+	virtual bool full() const
+	{
+		if(!d_pipe_sp) return false;
 
-public:
-	//!\param name_r The name to give this outpin.
-	outpin(const std::string& name_r) : pin<T>(name_r) {}
+		std::unique_lock<std::mutex> ul(pin<T>::lock_pipe());
+		const pipe<T> &p = *d_pipe_sp->first;
 
-	virtual ~outpin() {}
+		return (p.max_length() && p.length() >= p.max_length()) || (p.max_weight() && p.weight() >= p.max_weight());
+	}
 
-	//!\brief Overrides named::rename.
-	//!
-	//! Ensures pipe is also renamed.
-	//!
-	//!\param name_r New name to give this outpin.
-	virtual std::string rename(const std::string& name_r)
+	//!\brief Whether this outpin is connected to a pipe whose overflow policy is overflow::block.
+	virtual bool blocking() const
 	{
-		if(d_pipe_sp)
-		{
-			std::lock_guard<std::mutex> lg(*d_pipe_sp->second);
-			if(d_pipe_sp->first.output())
-			{
-				d_pipe_sp->first.rename(name_r + "_to_" + d_pipe_sp->first.output()->name());
-			}
-		}
+		if(!d_pipe_sp) return false;
 
-		return named::rename(name_r);
+		std::unique_lock<std::mutex> ul(pin<T>::lock_pipe());
+		return d_pipe_sp->first->overflow_policy() == overflow::block;
 	}
 
 	//!\brief Moves a packet to the pipe.
 	//!
 	//! Attempts to move the packet on the pipe.
-	//! If the pipe has reached capacity, the call to pipe::push will fail and packet_p will remain valid.
+	//! If the pipe has reached capacity, the pipe's overflow policy applies.
+	//! With overflow::block, this call waits until the consuming node makes room or until the producing node is no longer started.
 	//!
 	//!\return \c true if the packet was successfully moved to the pipe, false otherwise.
 	virtual bool push(std::unique_ptr<packet<T>>& packet_p)
 	{
 		if(!d_pipe_sp) return false;
 
+		// The push is timed before the packet is in the pipe, so that it is never recorded after the packet's pop.
+		const packet<T> *traced_p = packet_p.get();
+		std::int64_t traced_at = 0;
+
 		inpin<T>* inpin_p = 0;
+		while(true)
 		{
-			std::lock_guard<std::mutex> lg(*d_pipe_sp->second);
-			if(d_pipe_sp->first.push(packet_p))
+			// Any room made after the ticket is taken ends the wait.
+			const unsigned ticket = d_node_p->d_wakeup_e.ticket();
+			overflow::type policy;
+			traced_at = detail::trace_time();
 			{
-				inpin_p = d_pipe_sp->first.output();
+				std::unique_lock<std::mutex> ul(pin<T>::lock_pipe());
+				if(d_pipe_sp->first->push(packet_p))
+				{
+					inpin_p = d_pipe_sp->first->output();
+				}
+				policy = d_pipe_sp->first->overflow_policy();
 			}
+
+			if(inpin_p || !retry(packet_p, policy)) break;
+
+			d_node_p->d_wakeup_e.wait(ticket);
 		}
 
 		if(inpin_p)
 		{
+			detail::trace(hook::push, d_node_p, traced_p, 1, traced_at);
 			inpin_p->incoming();
 		}
 
 		return inpin_p != 0;
 	}
-};
-
-//!\brief Base class common to all nodes.
-class node : public named
-{
-	state::type d_state_a; //!< The state of this node.
 
-	//!\brief Changes this node's state.
+	//!\brief Moves many packets to the pipe under a single lock.
 	//!
-	//!\param s The new state.
-	virtual void transition(state::type s)
+	//! The consuming node is notified once per lock, no matter how many packets were moved.
+	//! With overflow::block, this call waits until all packets are moved or until the producing node is no longer started.
+	//!
+	//!\param packets The packets to move.
+	//!				  Packets moved to the pipe or discarded are removed from the front of \c packets, the others remain.
+	//!
+	//!\return The number of packets moved to the pipe.
+	virtual size_t push_n(typename pipe<T>::packets_t& packets)
 	{
-		std::unique_lock<std::mutex> ul(d_transition_m);
-
-		d_state_a = s;
+		if(!d_pipe_sp) return 0;
 
-		// Notify the concrete class.
-		switch(s)
+		size_t total = 0;
+		while(true)
 		{
-		case state::started: started(); break;
-		case state::paused: paused(); break;
-		case state::stopped: stopped(); break;
-		default: break;
-		}
-
-		// Notify the execution loop.
-		d_transition_cv.notify_one();
-	}
-
-	friend class graph;
+			const unsigned ticket = d_node_p->d_wakeup_e.ticket();
+			size_t n = 0;
+			overflow::type policy;
+			inpin<T>* inpin_p = 0;
+			const packet<T> *traced_p = packets.empty() ? nullptr : packets.front().get();
+			const std::int64_t traced_at = detail::trace_time();
+			{
+				std::unique_lock<std::mutex> ul(pin<T>::lock_pipe());
+				if((n = d_pipe_sp->first->push_n(packets)))
+				{
+					inpin_p = d_pipe_sp->first->output();
+				}
+				policy = d_pipe_sp->first->overflow_policy();
+			}
 
-protected:
-	std::condition_variable d_transition_cv;	//!< The condition variable to monitor the node's state.
-	std::mutex d_transition_m;					//!< The mutex to lock when waiting on d_transition_cv.
+			if(inpin_p)
+			{
+				detail::trace(hook::push, d_node_p, traced_p, n, traced_at);
+				inpin_p->incoming();
+			}
 
-	//!\brief Disconnect all pins.
-	virtual void sever() = 0;
+			total += n;
 
-public:
-	//! Constructor.
-	//!
-	//!\param name_r The name to give this node.
-	node(const std::string& name_r) : named(name_r), d_state_a(state::paused)
-	{}
+			if(packets.empty() || !retry(packets.front(), policy)) break;
 
-	//!\brief Move constructor.
-	node(node&& node_rr) : named(std::move(node_rr)), d_state_a(node_rr.d_state_a)
-	{}
-	
-	virtual ~node() {}
+			d_node_p->d_wakeup_e.wait(ticket);
+		}
 
-	//!\brief Returns the node's state
-	virtual state::type state() const
-	{
-		return d_state_a;
+		return total;
 	}
-	
-	//!\brief Indicates the node has been started.
-	//!
-	//! Concrete nodes can override this function to be notified of the state transition.
-	virtual void started() {}
-
-	//!\brief Indicates the node has been paused.
-	//!
-	//! Concrete nodes can override this function to be notified of the state transition.
-	virtual void paused() {}
-
-	//!\brief Indicates the node has been stopped.
-	//!
-	//! Concrete nodes can override this function to be notified of the state transition.
-	virtual void stopped() {}
-
-	//!\brief The node's execution function.
-	//!
-	//! When the node is started, this function is called.
-	//! It will exit when the node is stopped.
-	virtual void operator()() = 0;
 };
 
 //!\cond
@@ -381,6 +904,20 @@ class producer
 {
 public:
 	virtual ~producer() {}
+
+	virtual size_t outs() const = 0;
+
+	// Whether the pipe connected to an outpin can refuse packets.
+	virtual bool capped(const size_t n) const = 0;
+
+	// The number of packets pushed to the pipe connected to an outpin, 0 if it is not connected.
+	virtual size_t pushed(const size_t n) const = 0;
+
+	// Makes the pipes connected to all outpins count against a memory budget.
+	virtual void meter(const std::shared_ptr<budget>& budget_sp) = 0;
+
+	// Sets the priority of the pipe connected to an outpin. False if it is not connected.
+	virtual bool prioritize(const size_t n, const int priority) = 0;
 };
 
 class transformer
@@ -393,6 +930,11 @@ class consumer
 {
 public:
 	virtual ~consumer() {}
+
+	virtual size_t ins() const = 0;
+
+	// The number of packets waiting at all inpins.
+	virtual size_t queued() const = 0;
 };
 
 }
@@ -409,7 +951,21 @@ class producer : public virtual node, public detail::producer
 	typedef std::vector<outpin<T>> outputs_t;
 	outputs_t d_outputs;
 
+	packet_pool<T> d_pool;
+
 protected:
+	//!\brief Makes a packet from this node's \ref packet_pool "pool".
+	//!
+	//! The memory of a packet made this way is recycled after the packet is consumed.
+	//! Must be called from this node's thread of execution.
+	//!
+	//!\param args The arguments forwarded to the packet's constructor.
+	template<typename... Args>
+	std::unique_ptr<packet<T>> make_packet(Args&&... args)
+	{
+		return d_pool.make_packet(std::forward<Args>(args)...);
+	}
+
 	//!\brief Connect this producer to a consumer.
 	//!
 	//!\param p_pin The index of this node's output pin.
@@ -417,9 +973,11 @@ protected:
 	//!\param c_pin The index of the consumer node's input pin.
 	//!\param max_length The maximum length to give the pipe. Do not set or set to 0 for uncapped length.
 	//!\param max_weight The maximum weight to give the pipe. Do not set or set to 0 for uncapped weight.
-	virtual void connect(size_t p_pin, consumer<T>* consumer_p, size_t c_pin, const size_t max_length = 0, const size_t max_weight = 0)
+	//!\param kind The implementation of the pipe to make.
+	//!\param policy What the pipe does with packets that do not fit.
+	virtual void connect(size_t p_pin, consumer<T>* consumer_p, size_t c_pin, const size_t max_length = 0, const size_t max_weight = 0, const pipe_type::type kind = pipe_type::deque, const overflow::type policy = overflow::reject)
 	{
-		output(p_pin).connect(consumer_p->input(c_pin), max_length, max_weight);
+		output(p_pin).connect(consumer_p->input(c_pin), max_length, max_weight, kind, policy);
 	}
 
 	//!\brief Disconnect an outpin of this producer.
@@ -451,6 +1009,7 @@ protected:
 		{
 			if(s == state::paused)
 			{
+				detail::stopwatch sw(d_waiting_ns);
 				std::unique_lock<std::mutex> ul(d_transition_m);
 				d_transition_cv.wait(ul, [&s, this](){ return (s = this->state()) != state::paused; });
 			}
@@ -461,11 +1020,30 @@ protected:
 
 			if(s == state::started)
 			{
+				detail::stopwatch sw(d_busy_ns);
+				detail::trace_scope ts(hook::produce, this);
 				produce();
 			}
 		}
 	}
 
+	//!\brief Produces once, when the node runs on a scheduler.
+	virtual void step()
+	{
+		if(state() == state::started)
+		{
+			detail::stopwatch sw(d_busy_ns);
+			detail::trace_scope ts(hook::produce, this);
+			produce();
+		}
+	}
+
+	//!\brief A started producer always has something to do.
+	virtual bool runnable()
+	{
+		return state() == state::started;
+	}
+
 	friend class graph;
 
 public:
@@ -475,15 +1053,56 @@ public:
 	{
 		for(size_t i = 0; i != outs; ++i)
 		{
-			d_outputs.push_back(outpin<T>(name_r + "_out" + static_cast<char>('0' + i)));
+			d_outputs.push_back(outpin<T>(name_r + "_out" + std::to_string(i), this));
 		}
 	}
 
 	virtual ~producer() {}
 
+	//!\brief A producer blocks if it pushes to a pipe whose overflow policy is overflow::block.
+	virtual bool blocks() const
+	{
+		for(auto& outpin : d_outputs)
+		{
+			if(outpin.blocking())
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
 	//!\brief Returns the number of output pins.
 	virtual size_t outs() const { return d_outputs.size(); }
 
+	//!\brief Whether the pipe connected to an output pin has a maximum length or weight.
+	//!
+	//!\param n The index of the output pin.
+	virtual bool capped(const size_t n) const { return d_outputs[n].capped(); }
+
+	//!\brief The number of packets pushed so far to the pipe connected to an output pin, 0 if it is not connected.
+	//!
+	//!\param n The index of the output pin.
+	virtual size_t pushed(const size_t n) const { return d_outputs[n].connected() ? d_outputs[n].metrics().pushed : 0; }
+
+	//!\brief Makes the pipes connected to the output pins count against a memory budget, or none if \c nullptr.
+	virtual void meter(const std::shared_ptr<detail::budget>& budget_sp)
+	{
+		for(auto& outpin : d_outputs)
+		{
+			outpin.meter(budget_sp);
+		}
+	}
+
+	//!\brief Sets the priority of the pipe connected to an output pin.
+	//!
+	//!\param n The index of the output pin.
+	//!\param priority The pipe's new priority.
+	//!
+	//!\return \c false if the output pin is not connected.
+	virtual bool prioritize(const size_t n, const int priority) { return d_outputs[n].prioritize(priority); }
+
 	//!\brief Returns a reference to an outpin pin.
 	//!
 	//!\param n The index of the output pin.
@@ -500,6 +1119,24 @@ public:
 	//!\brief Returns a const reference to the container of output pins.
 	virtual const outputs_t& outputs() const { return d_outputs; }
 
+	//!\brief Returns a reference to the pool from which this node makes its packets.
+	virtual packet_pool<T>& pool() { return d_pool; }
+
+	//!\brief Returns a const reference to the pool from which this node makes its packets.
+	virtual const packet_pool<T>& pool() const { return d_pool; }
+
+	//!\brief Appends a snapshot of the counters of the pipes connected to this node's outpins.
+	virtual void pipes_metrics(std::vector<pipe_metrics>& metrics_r) const
+	{
+		for(auto& outpin : d_outputs)
+		{
+			if(outpin.connected())
+			{
+				metrics_r.push_back(outpin.metrics());
+			}
+		}
+	}
+
 	//!\brief Overrides named::rename.
 	//!
 	//! Ensure pins are also renamed.
@@ -511,7 +1148,7 @@ public:
 	{
 		for(size_t i = 0; i != outs(); ++i)
 		{
-			output(i).outpin<T>::rename(name_r + "_out" + static_cast<char>('0' + i));
+			output(i).outpin<T>::rename(name_r + "_out" + std::to_string(i));
 		}
 
 		return named::rename(name_r);
@@ -536,7 +1173,91 @@ class consumer : public virtual node, public detail::consumer
 	typedef std::vector<inpin<T>> inputs_t;
 	inputs_t d_inputs;
 
+	size_t d_max_batch;
+	typename pipe<T>::packets_t d_batch;
+
+	std::atomic<service_order::type> d_order_a;
+	size_t d_next;	// Where the search for the inpin to service starts, so that ties are broken in turn.
+
+	// Services one inpin once, if packets are waiting there.
+	bool serve(const size_t i)
+	{
+		if(d_max_batch)
+		{
+			// The batch is timed from before it is extracted, so that its pop falls within the call to ready_batch.
+			const std::int64_t popped_at = detail::trace_time();
+			if(input(i).pop_n(d_batch, d_max_batch))
+			{
+				detail::trace_scope ts(hook::ready, this, i, popped_at);
+				ready_batch(i, d_batch);
+				d_batch.clear();
+				return true;
+			}
+		}
+		else if(input(i).peek())
+		{
+			detail::trace_scope ts(hook::ready, this, i);
+			ready(i);
+			return true;
+		}
+
+		return false;
+	}
+
+	// The inpin of highest priority or whose next packet is due first, ins() if no packets are waiting.
+	size_t pick(const service_order::type order)
+	{
+		size_t chosen = ins();
+		int highest = 0;
+		typename packet<T>::time_point_type earliest;
+
+		for(size_t k = 0; k != ins(); ++k)
+		{
+			const size_t i = (d_next + k) % ins();
+
+			if(order == service_order::priority)
+			{
+				if(input(i).peek() && (chosen == ins() || input(i).priority() > highest))
+				{
+					chosen = i;
+					highest = input(i).priority();
+				}
+			}
+			else
+			{
+				typename packet<T>::time_point_type t;
+				if(input(i).due(t) && (chosen == ins() || t < earliest))
+				{
+					chosen = i;
+					earliest = t;
+				}
+			}
+		}
+
+		if(chosen != ins())
+		{
+			d_next = chosen + 1;
+		}
+
+		return chosen;
+	}
+
 protected:
+	//!\brief Makes the execution function deliver packets in batches.
+	//!
+	//! When batching is enabled, ready_batch() is called instead of ready().
+	//! The packets waiting at an input are all extracted under a single lock, up to \c max_batch of them.
+	//!
+	//!\tparam Derived The concrete class, which must override ready_batch().
+	//!\param max_batch The maximum number of packets per batch. 0 disables batching.
+	template<typename Derived>
+	void batch(const size_t max_batch = default_max_batch)
+	{
+		static_assert(!std::is_same<decltype(&Derived::ready_batch), decltype(&consumer<T>::ready_batch)>::value, "a consumer that batches must override ready_batch");
+
+		d_max_batch = max_batch;
+	}
+
 	//!\brief Disconnect an inpin of this consumer.
 	//!
 	//!\param pin Index of the pin to disconnect.
@@ -544,6 +1265,20 @@ protected:
 	{
 		input(pin).disconnect();
 	}
+
+	//!\brief Makes the inpins raise a flag when a packet arrives, for nodes that override service() to visit only those inpins.
+	//!
+	//! A flag is raised after the packet is moved to the pipe, so a node that lowers a flag and then extracts all packets from the pipe never misses one.
+	//!
+	//!\param arrivals_p The flags, one per inpin, or \c nullptr to stop tracking.
+	virtual void track(detail::arrivals *arrivals_p)
+	{
+		for(size_t i = 0; i != d_inputs.size(); ++i)
+		{
+			d_inputs[i].d_arrivals_p = arrivals_p;
+			d_inputs[i].d_index = i;
+		}
+	}
 	
 	//!\brief Disconnect all pins.
 	virtual void sever()
@@ -578,42 +1313,97 @@ protected:
 		
 		while(s != state::stopped)
 		{
-			bool p = false;
-
 			if(s == state::paused)
 			{
+				detail::stopwatch sw(d_waiting_ns);
 				std::unique_lock<std::mutex> ul(d_transition_m);
 				d_transition_cv.wait(ul, [&s, this](){ return (s = this->state()) != state::paused; });
 			}
 			else if(s == state::started)
 			{
-				std::unique_lock<std::mutex> ul(d_transition_m);
-				d_transition_cv.wait(ul, [&s, &p, this](){ return ((s = this->state()) != state::started) || (p = this->incoming()); });
-			}
+				// Any packet that arrives after the ticket is taken ends the wait.
+				const unsigned ticket = d_wakeup_e.ticket();
 
-			if(p)
-			{
-				for(size_t i = 0; i != ins(); ++i)
+				bool serviced;
 				{
-					if(input(i).peek())
-					{
-						ready(i);
-					}
+					detail::stopwatch sw(d_busy_ns);
+					serviced = service();
 				}
+
+				// Only wait once there was nothing left to service.
+				if(!serviced && state() == state::started)
+				{
+					detail::stopwatch sw(d_waiting_ns);
+					d_wakeup_e.wait(ticket);
+				}
+			}
+
+			s = state();
+		}
+	}
+
+	//!\brief Signals the packets waiting at the inpins to the concrete class.
+	//!
+	//! Which inpins are serviced depends on the \ref set_order "service order".
+	//! Under service_order::round_robin, each inpin is serviced once, in order.
+	//! Under service_order::weighted, each inpin is serviced up to its share of times, in order.
+	//! Under service_order::priority and service_order::earliest, a single inpin is serviced, ties going to each inpin in turn.
+	//!
+	//!\return \c true if packets were waiting at any inpin.
+	virtual bool service()
+	{
+		const service_order::type order = d_order_a.load(std::memory_order_relaxed);
+
+		if(order == service_order::priority || order == service_order::earliest)
+		{
+			const size_t i = pick(order);
+			return i != ins() && serve(i);
+		}
+
+		bool serviced = false;
+
+		for(size_t i = 0; i != ins(); ++i)
+		{
+			const size_t times = order == service_order::weighted ? input(i).share() : 1;
+
+			for(size_t t = 0; t != times && serve(i); ++t)
+			{
+				serviced = true;
 			}
 		}
+
+		return serviced;
+	}
+
+	//!\brief Services the inpins once, when the node runs on a scheduler.
+	virtual void step()
+	{
+		if(state() == state::started)
+		{
+			detail::stopwatch sw(d_busy_ns);
+			service();
+		}
+	}
+
+	//!\brief A started consumer has something to do when packets are waiting at its inpins.
+	virtual bool runnable()
+	{
+		return state() == state::started && incoming();
 	}
 
 	friend class graph;
 
 public:
+	//!\brief The maximum number of packets per batch used when batch() is called with no argument.
+	static const size_t default_max_batch = 64;
+
 	//!\param name_r The name to give this node.
 	//!\param ins Numbers of input pins.
-	consumer(const std::string& name_r, const size_t ins) : node(name_r)
+	consumer(const std::string& name_r, const size_t ins) : node(name_r), d_max_batch(0), d_order_a(service_order::round_robin), d_next(0)
 	{
 		for(size_t i = 0; i != ins; ++i)
 		{
-			d_inputs.push_back(inpin<T>(name_r + "_in" + static_cast<char>('0' + i), &d_transition_cv, &d_transition_m));
+			d_inputs.push_back(inpin<T>(name_r + "_in" + std::to_string(i), this));
 		}
 	}
 
@@ -622,6 +1412,34 @@ public:
 	//!\brief Returns the number of input pins.
 	virtual size_t ins() const { return d_inputs.size(); }
 
+	//!\brief How this consumer chooses which of its inpins to service.
+	virtual service_order::type order() const
+	{
+		return d_order_a.load(std::memory_order_relaxed);
+	}
+
+	//!\brief Sets how this consumer chooses which of its inpins to service.
+	//!
+	//! Nodes that override service() choose for themselves and ignore the order.
+	//!
+	//!\return The previous order.
+	virtual service_order::type set_order(const service_order::type order)
+	{
+		return d_order_a.exchange(order, std::memory_order_relaxed);
+	}
+
+	//!\brief Returns the number of packets waiting at all input pins.
+	virtual size_t queued() const
+	{
+		size_t n = 0;
+		for(auto& inpin : d_inputs)
+		{
+			n += inpin.length();
+		}
+
+		return n;
+	}
+
 	//!\brief Returns a reference to an input pin.
 	//!
 	//!\param n The index of the input pin.
@@ -647,7 +1465,7 @@ public:
 	{
 		for(size_t i = 0; i != ins(); ++i)
 		{
-			input(i).inpin<T>::rename(name_r + "_in" + static_cast<char>('0' + i));
+			input(i).inpin<T>::rename(name_r + "_in" + std::to_string(i));
 		}
 
 		return named::rename(name_r);
@@ -661,8 +1479,21 @@ public:
 	//!
 	//! param n The index of the input pin at which a packet has arrived.
 	virtual void ready(size_t n) = 0;
+
+	//!\brief Batch consuming function.
+	//!
+	//! This function is called from the operator()() execution function instead of ready() when batching is enabled with batch(),
+	//! which only concrete classes that override it can do.
+	//! The packets have already been extracted from the input pin.
+	//! Concrete classes may move packets out of the container, it is cleared after this function returns.
+	//!
+	//! The arguments are the index of the input pin at which the packets have arrived and the packets, in the order they arrived.
+	virtual void ready_batch(size_t, typename pipe<T>::packets_t&) {}
 };
 
+template<typename T>
+const size_t consumer<T>::default_max_batch;
+
 //!\brief Base class from which concrete transformers derive.
 //!
 //!\tparam C The type of data this node consumes.
@@ -683,6 +1514,12 @@ protected:
 
 	//!\brief Implementation of node::operator()().
 	virtual void operator()() { consumer<C>::operator()(); }
+
+	//!\brief Implementation of detail::task::step().
+	virtual void step() { consumer<C>::step(); }
+
+	//!\brief Implementation of detail::task::runnable().
+	virtual bool runnable() { return consumer<C>::runnable(); }
 	
 public:
 	//!\param name_r The name to give this node.
@@ -702,12 +1539,12 @@ public:
 	{
 		for(size_t i = 0; i != producer<P>::outs(); ++i)
 		{
-			producer<P>::output(i).outpin<P>::rename(name_r + "_out" + static_cast<char>('0' + i));
+			producer<P>::output(i).outpin<P>::rename(name_r + "_out" + std::to_string(i));
 		}
 
 		for(size_t i = 0; i != consumer<C>::ins(); ++i)
 		{
-			consumer<C>::input(i).inpin<C>::rename(name_r + "_in" + static_cast<char>('0' + i));
+			consumer<C>::input(i).inpin<C>::rename(name_r + "_in" + std::to_string(i));
 		}
 
 		return named::rename(name_r);
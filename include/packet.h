@@ -2,56 +2,254 @@
 	 #define FLOW_PACKET_H
 
 #include <chrono>
+#include <cstddef>
+#include <new>
+#include <string>
 #include <vector>
 
 //!\file packet.h
 //!
-//!\brief Defines the flow::packet class.
+//!\brief Defines the flow::packet class and the flow::weight and flow::packet_traits traits.
 
 namespace flow
 {
 
+//!\brief Computes the number of bytes a packet's data occupies, which is the weight of the packet.
+//!
+//! Pipes add up the weights of the packets they carry and compare the sum to their maximum weight.
+//! By default, the weight of data is its sizeof.
+//! Specialize this trait for data types that own memory on the heap so that a maximum weight actually bounds memory.
+//! The weight of data must not change while the data is in a pipe.
+//!
+//!\tparam T The type of data.
+template<typename T>
+struct weight
+{
+	//!\brief The weight of \c t.
+	static size_t of(const T& t)
+	{
+		return sizeof(t);
+	}
+};
+
+//!\brief The weight of a string is its size plus the memory it has allocated for its characters.
+template<typename C, typename Tr, typename A>
+struct weight<std::basic_string<C, Tr, A>>
+{
+	//!\brief The weight of \c s.
+	static size_t of(const std::basic_string<C, Tr, A>& s)
+	{
+		return sizeof(s) + s.capacity() * sizeof(C);
+	}
+};
+
+//!\brief The weight of a vector is its size plus the memory it has allocated for its elements.
+//!
+//! Memory owned by the elements themselves is not accounted for.
+template<typename T, typename A>
+struct weight<std::vector<T, A>>
+{
+	//!\brief The weight of \c v.
+	static size_t of(const std::vector<T, A>& v)
+	{
+		return sizeof(v) + v.capacity() * sizeof(T);
+	}
+};
+
+//!\brief Describes the packets that carry data of type T.
+//!
+//! By default, packets carry an optional consumption time and have a virtual destructor so that they can be derived from.
+//! Specialize this trait for small data types that need neither to make their packets smaller,
+//! e.g. a \c packet<int> then occupies 4 bytes instead of 24.
+//! Deriving the specialization from \ref flow::slim_packet "slim_packet" turns both off.
+//!
+//!\tparam T The type of data.
+template<typename T>
+struct packet_traits
+{
+	//!\brief Whether packets have a consumption time.
+	//!
+	//! Packets that do not always report no consumption time and cannot be made with one.
+	static const bool timestamped = true;
+
+	//!\brief Whether packets have a virtual destructor.
+	static const bool polymorphic = true;
+};
+
+//!\brief Base for \ref flow::packet_traits "packet_traits" specializations of data carried by packets without a consumption time nor a virtual destructor.
+//!
+//! For instance:
+//!\code
+//! namespace flow { template<> struct packet_traits<int> : slim_packet {}; }
+//!\endcode
+struct slim_packet
+{
+	static const bool timestamped = false;	//!< Packets have no consumption time.
+	static const bool polymorphic = false;	//!< Packets have no virtual destructor.
+};
+
+//!\cond
+namespace detail
+{
+
+typedef std::chrono::time_point<std::chrono::high_resolution_clock> time_point_type;
+
+// Holds the consumption time of a packet, or not.
+template<bool Timestamped>
+class timestamp
+{
+	time_point_type d_consumption_time;
+
+protected:
+	timestamp() {}
+
+	timestamp(const time_point_type& consumption_time) : d_consumption_time(consumption_time) {}
+
+public:
+	time_point_type& consumption_time() { return d_consumption_time; }
+
+	const time_point_type& consumption_time() const { return d_consumption_time; }
+};
+
+template<>
+class timestamp<false>
+{
+protected:
+	timestamp() {}
+
+public:
+	time_point_type consumption_time() const { return time_point_type(); }
+};
+
+// Gives a packet a virtual destructor, or not.
+template<bool Polymorphic>
+class destructor
+{
+public:
+	virtual ~destructor() {}
+};
+
+template<>
+class destructor<false>
+{};
+
+// Something that takes back the memory of deleted packets, i.e. a packet_pool.
+class recycler
+{
+public:
+	virtual ~recycler() {}
+
+	virtual void recycle(void* block_p) = 0;
+};
+
+// Placed in front of every packet in memory.
+// Tells packet::operator delete where the packet's memory should go.
+struct block_header
+{
+	recycler *recycler_p;	// Null when the packet was allocated with plain new.
+};
+
+// Size of the block header rounded up to keep the packet that follows it suitably aligned.
+const size_t block_header_size = (sizeof(block_header) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+inline block_header* header_of(void* p)
+{
+	return reinterpret_cast<block_header*>(static_cast<char*>(p) - block_header_size);
+}
+
+inline void* storage_of(block_header* header_p)
+{
+	return reinterpret_cast<char*>(header_p) + block_header_size;
+}
+
+}
+//!\endcond
+
 //!\brief Object that carries data from node to node through a pipe.
 //!
 //! Associated with a packet is an optional time of consumption.
 //! A consumer node ought to wait before consuming the data in this packet if it arrives to the node early.
 //! If the packet arrives too late, the consumer node ought to discard it.
+//!
+//! What a packet holds besides its data is set by \ref flow::packet_traits "packet_traits<T>".
+//! Its member functions are not virtual.
 template<typename T>
-class packet
+class packet : public detail::timestamp<packet_traits<T>::timestamped>, public detail::destructor<packet_traits<T>::polymorphic>
 {
 public:
 	//!\brief Convenience typedef for time_point type used.
-	typedef std::chrono::time_point<std::chrono::high_resolution_clock> time_point_type;
+	typedef detail::time_point_type time_point_type;
 
 private:
-	T d_data;
+	typedef detail::timestamp<packet_traits<T>::timestamped> timestamp_t;
 
-	time_point_type d_consumption_time;
+	T d_data;
 
 public:
 	//!\brief Constructor.
 	//!
 	//!\param data Data to be put in the packet.
-	//!\param consumption_time The time at which a consumer node should consume the data. Optional.
-	packet(T data, const time_point_type& consumption_time = time_point_type())
-		: d_data(std::move(data)), d_consumption_time(consumption_time) {}
+	packet(T data) : d_data(std::move(data)) {}
+
+	//!\brief Constructor.
+	//!
+	//! Only for packets that are \ref flow::packet_traits::timestamped "timestamped".
+	//!
+	//!\param data Data to be put in the packet.
+	//!\param consumption_time The time at which a consumer node should consume the data.
+	packet(T data, const time_point_type& consumption_time) : timestamp_t(consumption_time), d_data(std::move(data)) {}
 
-	virtual ~packet() {}
+	//!\brief Allocates memory for a packet that is not taken from a \ref flow::packet_pool "packet_pool".
+	static void* operator new(size_t size)
+	{
+		detail::block_header *header_p = static_cast<detail::block_header*>(::operator new(detail::block_header_size + size));
+		header_p->recycler_p = nullptr;
 
-	//!\brief Returns the number of bytes in this packet.
-	static size_t size() { return sizeof(T); }
+		return detail::storage_of(header_p);
+	}
 
-	//!\brief Reference to the data this packet is carrying.
-	virtual T& data() { return d_data; }
+	//!\brief Placement new, so that it is not hidden by packet::operator new.
+	static void* operator new(size_t, void* p)
+	{
+		return p;
+	}
+
+	//!\brief Releases the memory of a packet.
+	//!
+	//! If the packet was made by a \ref flow::packet_pool "packet_pool", its memory is returned to that pool.
+	static void operator delete(void* p)
+	{
+		if(!p) return;
+
+		detail::block_header *header_p = detail::header_of(p);
+
+		if(header_p->recycler_p)
+		{
+			header_p->recycler_p->recycle(header_p);
+		}
+		else
+		{
+			::operator delete(header_p);
+		}
+	}
+
+	//!\brief Placement delete, matches placement new.
+	static void operator delete(void*, void*) {}
+
+	//!\brief Returns the number of bytes in this packet, as computed by \ref flow::weight "weight<T>".
+	size_t size() const { return weight<T>::of(d_data); }
 
 	//!\brief Reference to the data this packet is carrying.
-	virtual const T& data() const { return d_data; }
+	T& data() { return d_data; }
 
-	//!\brief Reference to the time of consumption.
-	virtual time_point_type& consumption_time() { return d_consumption_time; }
+	//!\brief Reference to the data this packet is carrying.
+	const T& data() const { return d_data; }
 
-    //!\brief Reference to the time of consumption.
-    virtual const time_point_type& consumption_time() const { return d_consumption_time; }
+	//!\brief The time of consumption.
+	//!
+	//! Returns a reference to it, unless the packet is not \ref flow::packet_traits::timestamped "timestamped".
+	//! Such packets have no consumption time and cannot be given one.
+	using timestamp_t::consumption_time;
 };
 
 }
@@ -0,0 +1,357 @@
+#if !defined(FLOW_PARALLEL_H)
+	 #define FLOW_PARALLEL_H
+
+#include "node.h"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//!\file parallel.h
+//!
+//!\brief Defines the \ref flow::parallel class template and the \ref flow::splitter and \ref flow::merger nodes it is made of.
+
+namespace flow
+{
+
+//!\namespace flow::distribution
+//!
+//!\brief Contains the different distribution values.
+namespace distribution
+{
+
+//!\enum type
+//!
+//!\brief How a \ref flow::splitter "splitter" chooses the outpin of each packet.
+enum type
+{
+	round_robin,	//!< Every outpin in turn.
+	least_loaded	//!< The outpin whose pipe holds the fewest packets, ties going to each outpin in turn.
+};
+
+}
+
+//!\namespace flow::ordering
+//!
+//!\brief Contains the different ordering values.
+namespace ordering
+{
+
+//!\enum type
+//!
+//!\brief The order in which a \ref flow::merger "merger" pushes the packets it receives.
+enum type
+{
+	arrival,	//!< As they arrive.
+	sequence	//!< In the order the matching packets arrived at the splitter.
+};
+
+}
+
+//!\cond
+namespace detail
+{
+
+// The outpin a splitter gave each packet, in the order the packets arrived at the splitter.
+// The merger takes its inpins in that order, so that packets leave in the order they came in.
+struct sequence
+{
+	std::deque<size_t> pins;
+	std::mutex m;
+};
+
+// Used to deduce the types a transformer consumes and produces.
+template<typename C, typename P>
+C consumed(const flow::transformer<C, P>*);
+
+template<typename C, typename P>
+P produced(const flow::transformer<C, P>*);
+
+}
+//!\endcond
+
+//!\brief Distributes the packets arriving at its inpin across its outpins.
+//!
+//! Unlike \ref flow::samples::generic::tee "tee", which copies every packet to all its outpins, a splitter gives every packet to a single outpin.
+//!
+//!\tparam T The type of data this node splits.
+template<typename T>
+class splitter : public transformer<T, T>
+{
+	const distribution::type d_distribution;
+	size_t d_next;	// The outpin to consider first for the next packet.
+
+	std::shared_ptr<detail::sequence> d_sequence_sp;
+
+	size_t pick()
+	{
+		const size_t outs = producer<T>::outs();
+		size_t chosen = d_next % outs;
+
+		if(d_distribution == distribution::least_loaded)
+		{
+			size_t least = producer<T>::output(chosen).length();
+			for(size_t k = 1; k != outs && least; ++k)
+			{
+				const size_t o = (d_next + k) % outs;
+				const size_t length = producer<T>::output(o).length();
+				if(length < least)
+				{
+					chosen = o;
+					least = length;
+				}
+			}
+		}
+
+		d_next = chosen + 1;
+
+		return chosen;
+	}
+
+public:
+	//!\param name_r The name to give this node.
+	//!\param outs The number of output pins.
+	//!\param d How the outpin of each packet is chosen.
+	//!\param sequence_sp The record of the outpins chosen, shared with a merger that restores the order of the packets. Leave empty for no record.
+	splitter(const std::string& name_r, const size_t outs, const distribution::type d = distribution::round_robin, const std::shared_ptr<detail::sequence>& sequence_sp = std::shared_ptr<detail::sequence>())
+		: node(name_r), transformer<T, T>(name_r, 1, outs), d_distribution(d), d_next(0), d_sequence_sp(sequence_sp)
+	{}
+
+	virtual ~splitter() {}
+
+	//!\brief Pushes the packet waiting at the inpin to the chosen outpin.
+	virtual void ready(size_t)
+	{
+		std::unique_ptr<packet<T>> packet_p(consumer<T>::input(0).pop());
+		if(!packet_p) return;
+
+		const size_t o = pick();
+
+		if(!d_sequence_sp)
+		{
+			producer<T>::output(o).push(packet_p);
+			return;
+		}
+
+		// Recorded before the push, so the merger knows where to look as soon as the packet is out.
+		{
+			std::lock_guard<std::mutex> lg(d_sequence_sp->m);
+			d_sequence_sp->pins.push_back(o);
+		}
+
+		if(!producer<T>::output(o).push(packet_p))
+		{
+			// The merger cannot have gone past a packet that never came out, the record is still the last one.
+			std::lock_guard<std::mutex> lg(d_sequence_sp->m);
+			d_sequence_sp->pins.pop_back();
+		}
+	}
+};
+
+//!\brief Pushes the packets arriving at its inpins to its outpin.
+//!
+//! Given the record of a \ref splitter "splitter", a merger pushes packets in the order they arrived at the splitter.
+//! It then expects every packet given to an outpin of the splitter to come back as exactly one packet at the inpin of the same index.
+//! A packet that does not come back holds back all the packets that arrived after it.
+//!
+//!\tparam T The type of data this node merges.
+template<typename T>
+class merger : public transformer<T, T>
+{
+	std::shared_ptr<detail::sequence> d_sequence_sp;
+
+	// Whether the next packet in sequence is waiting.
+	bool due()
+	{
+		std::lock_guard<std::mutex> lg(d_sequence_sp->m);
+		return !d_sequence_sp->pins.empty() && consumer<T>::input(d_sequence_sp->pins.front()).peek();
+	}
+
+protected:
+	//!\brief Pushes the packets that are next in sequence, if the merger has a record to follow.
+	//!
+	//!\return \c true if any packet was pushed.
+	virtual bool service()
+	{
+		if(!d_sequence_sp) return consumer<T>::service();
+
+		bool serviced = false;
+
+		for(size_t n = 0; n != consumer<T>::default_max_batch; ++n)
+		{
+			std::unique_ptr<packet<T>> packet_p;
+			{
+				// The packet is taken under the lock so that it is matched with the record it belongs to.
+				std::lock_guard<std::mutex> lg(d_sequence_sp->m);
+				if(d_sequence_sp->pins.empty()) break;
+
+				packet_p = consumer<T>::input(d_sequence_sp->pins.front()).pop();
+				if(!packet_p) break;
+
+				d_sequence_sp->pins.pop_front();
+			}
+
+			producer<T>::output(0).push(packet_p);
+			serviced = true;
+		}
+
+		return serviced;
+	}
+
+	//!\brief A started merger has something to do when the next packet in sequence is waiting, or any packet if it has no record to follow.
+	virtual bool runnable()
+	{
+		return d_sequence_sp ? node::state() == state::started && due() : consumer<T>::runnable();
+	}
+
+public:
+	//!\param name_r The name to give this node.
+	//!\param ins The number of input pins.
+	//!\param sequence_sp The record of the splitter whose order to restore. Leave empty to push packets as they arrive.
+	merger(const std::string& name_r, const size_t ins, const std::shared_ptr<detail::sequence>& sequence_sp = std::shared_ptr<detail::sequence>())
+		: node(name_r), transformer<T, T>(name_r, ins, 1), d_sequence_sp(sequence_sp)
+	{}
+
+	virtual ~merger() {}
+
+	//!\brief Pushes the packet waiting at an inpin, when the merger has no record to follow.
+	virtual void ready(size_t i)
+	{
+		std::unique_ptr<packet<T>> packet_p(consumer<T>::input(i).pop());
+		producer<T>::output(0).push(packet_p);
+	}
+};
+
+//!\brief Replicates a transformer so that many packets are transformed at once.
+//!
+//! A \ref splitter "splitter" distributes the packets across the replicas, which run on threads of their own, and a \ref merger "merger" gathers what they push.
+//! The whole is added to a graph with \ref graph::add(const parallel<Transformer>&, const std::string&) "graph::add",
+//! after which the splitter's inpin and the merger's outpin stand for the inpin and outpin of the transformer.
+//!
+//! The transformer must have one inpin and one outpin.
+//! With ordering::sequence, it must also push exactly one packet for every packet it consumes, as map stages do.
+//!
+//!\tparam Transformer The concrete transformer to replicate.
+template<typename Transformer>
+class parallel
+{
+public:
+	//!\brief The type of data the transformer consumes.
+	typedef decltype(detail::consumed(static_cast<Transformer*>(nullptr))) consumed_type;
+
+	//!\brief The type of data the transformer produces.
+	typedef decltype(detail::produced(static_cast<Transformer*>(nullptr))) produced_type;
+
+private:
+	std::shared_ptr<flow::splitter<consumed_type>> d_splitter_sp;
+	std::vector<std::shared_ptr<Transformer>> d_replicas;
+	std::shared_ptr<flow::merger<produced_type>> d_merger_sp;
+
+	// Returns the number of replicas to make, at least one.
+	size_t assemble(const size_t n, const distribution::type d, const ordering::type o)
+	{
+		const size_t replicas = n ? n : 1;
+
+		std::shared_ptr<detail::sequence> sequence_sp;
+		if(o == ordering::sequence)
+		{
+			sequence_sp = std::make_shared<detail::sequence>();
+		}
+
+		d_splitter_sp = std::make_shared<flow::splitter<consumed_type>>("splitter", replicas, d, sequence_sp);
+		d_merger_sp = std::make_shared<flow::merger<produced_type>>("merger", replicas, sequence_sp);
+
+		return replicas;
+	}
+
+public:
+	//!\param n The number of replicas. A stage has at least one.
+	//!\param d How packets are distributed across the replicas.
+	//!\param o The order in which transformed packets leave.
+	parallel(const size_t n, const distribution::type d = distribution::round_robin, const ordering::type o = ordering::sequence)
+	{
+		const size_t replicas = assemble(n, d, o);
+
+		for(size_t i = 0; i != replicas; ++i)
+		{
+			d_replicas.push_back(std::make_shared<Transformer>());
+		}
+	}
+
+	//!\param n The number of replicas. A stage has at least one.
+	//!\param d How packets are distributed across the replicas.
+	//!\param o The order in which transformed packets leave.
+	//!\param args The arguments given to the constructor of every replica.
+	template<typename Arg, typename... Args>
+	parallel(const size_t n, const distribution::type d, const ordering::type o, Arg&& arg, Args&&... args)
+	{
+		const size_t replicas = assemble(n, d, o);
+
+		for(size_t i = 0; i != replicas; ++i)
+		{
+			d_replicas.push_back(std::make_shared<Transformer>(arg, args...));
+		}
+	}
+
+	virtual ~parallel() {}
+
+	//!\brief The number of replicas.
+	virtual size_t replicas() const
+	{
+		return d_replicas.size();
+	}
+
+	//!\brief Returns a replica.
+	//!
+	//!\param i The index of the replica.
+	virtual const std::shared_ptr<Transformer>& replica(const size_t i) const
+	{
+		return d_replicas[i];
+	}
+
+	//!\brief The node whose inpin stands for the transformer's.
+	virtual const std::shared_ptr<flow::splitter<consumed_type>>& splitter() const
+	{
+		return d_splitter_sp;
+	}
+
+	//!\brief The node whose outpin stands for the transformer's.
+	virtual const std::shared_ptr<flow::merger<produced_type>>& merger() const
+	{
+		return d_merger_sp;
+	}
+};
+
+}
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
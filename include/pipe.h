@@ -1,17 +1,22 @@
 #if !defined(FLOW_PIPE_H)
 	 #define FLOW_PIPE_H
 
+#include "budget.h"
+#include "metrics.h"
 #include "named.h"
 #include "packet.h"
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <queue>
 #include <string>
 #include <utility>
+#include <vector>
 
 //!\file pipe.h
 //!
-//!\brief Defines the \ref flow::pipe class.
+//!\brief Defines the \ref flow::pipe class and the \ref flow::ring_pipe class.
 
 namespace flow
 {
@@ -22,24 +27,77 @@ class inpin;
 template<typename T>
 class outpin;
 
+//!\namespace flow::pipe_type
+//!
+//!\brief Contains the different pipe implementation values.
+namespace pipe_type
+{
+
+//!\enum type
+//!
+//!\brief The implementation of a pipe.
+enum type
+{
+	deque,	//!< A \ref flow::pipe "pipe" guarded by a mutex. Any number of threads may push and pop.
+	ring	//!< A lock-free \ref flow::ring_pipe "ring_pipe". Only one thread may push and only one thread may pop.
+};
+
+}
+
+//!\namespace flow::overflow
+//!
+//!\brief Contains the different overflow policy values.
+namespace overflow
+{
+
+//!\enum type
+//!
+//!\brief What a pipe does with a packet pushed to it when it has reached its maximum length or weight.
+enum type
+{
+	reject,			//!< The packet is returned to the caller of push.
+	drop_newest,	//!< The packet is discarded.
+	drop_oldest,	//!< The oldest packets in the pipe are discarded to make room for the packet. A \ref flow::ring_pipe "ring_pipe" discards the packet instead.
+	block			//!< The producing node waits until the consuming node makes room for the packet.
+};
+
+}
+
 //!\brief Carries packets from one node to another node on a FIFO basis.
 //!
 //! Packets will accumulate in pipes if the node at the consuming end does not consume them fast enough.
 //! If packet accumulation is expected but memory usage is a concern, length and weight can be specified.
-//! If a pipe has reached it's length or weight limit, pushed packets will instead be discarded.
-//! A graph that produces more data than it consumes is unbalanced and should be adjusted.
+//! If a pipe has reached it's length or weight limit, its \ref overflow::type "overflow policy" decides the fate of pushed packets.
+//! A graph that produces more data than it consumes is unbalanced and should be adjusted, or throttled with overflow::block.
+//! The bytes held by all pipes of a graph can also be bounded as a whole with a \ref graph::budget "budget".
 template<typename T>
 class pipe : public named
 {
+public:
+	//!\brief Convenience typedef for a sequence of packets.
+	typedef std::vector<std::unique_ptr<packet<T>>> packets_t;
+
+private:
 	std::deque<std::unique_ptr<packet<T>>> d_packets;
 
-	outpin<T> *d_input_p;
-	inpin<T> *d_output_p;
+protected:
+	outpin<T> *d_input_p;	//!< The producing node's output pin.
+	inpin<T> *d_output_p;	//!< The consuming node's input pin.
+
+	size_t d_max_length;	//!< The maximum number of packets this pipe will carry.
+	size_t d_max_weight;	//!< The maximum number of bytes this pipe will carry.
 
-	size_t d_max_length;
-	size_t d_max_weight;
+	size_t d_weight;		//!< The sum of all bytes of all packets in the pipe.
 
-	size_t d_weight;
+	overflow::type d_overflow;	//!< What to do with packets that do not fit.
+
+	detail::counter d_pushed;		//!< The number of packets moved to the pipe.
+	detail::counter d_dropped;		//!< The number of packets refused by the pipe.
+	detail::counter d_high_water;	//!< The greatest length reached.
+
+	detail::account d_account;		//!< This pipe's share of its graph's memory budget, and its priority.
+
+	friend class outpin<T>;
 
 public:
 	//!\brief Constructor for a new pipe.
@@ -49,17 +107,28 @@ public:
 	//!\param input_p The input pin of the consuming node.
 	//!\param max_length The maximum number of nodes this pipe will carry. Do not set or set to 0 for uncapped length.
 	//!\param max_weight The maximum number of bytes this pipe will carry. Do not set or set to 0 for uncapped weight.
-	pipe(const std::string& name_r, outpin<T> *output_p, inpin<T> *input_p, const size_t max_length = 0, const size_t max_weight = 0)
-		: named(name_r), d_input_p(output_p), d_output_p(input_p), d_max_length(max_length), d_max_weight(max_weight), d_weight(0)
+	//!\param policy What to do with packets that do not fit.
+	pipe(const std::string& name_r, outpin<T> *output_p, inpin<T> *input_p, const size_t max_length = 0, const size_t max_weight = 0, const overflow::type policy = overflow::reject)
+		: named(name_r), d_input_p(output_p), d_output_p(input_p), d_max_length(max_length), d_max_weight(max_weight), d_weight(0), d_overflow(policy)
 	{}
 
 	//!\brief Move constructor.
 	pipe(pipe&& pipe_rr) : named(std::move(pipe_rr)), d_packets(std::move(pipe_rr.d_packets)), d_input_p(std::move(pipe_rr.d_input_p)), d_output_p(std::move(pipe_rr.d_output_p)),
-		d_max_length(std::move(pipe_rr.d_max_length)), d_max_weight(std::move(pipe_rr.d_max_weight)), d_weight(std::move(pipe_rr.d_weight))
+		d_max_length(std::move(pipe_rr.d_max_length)), d_max_weight(std::move(pipe_rr.d_max_weight)), d_weight(std::move(pipe_rr.d_weight)), d_overflow(pipe_rr.d_overflow),
+		d_pushed(pipe_rr.d_pushed), d_dropped(pipe_rr.d_dropped), d_high_water(pipe_rr.d_high_water), d_account(pipe_rr.d_account.priority())
 	{}
 
 	virtual ~pipe() {}
 
+	//!\brief Whether push and pop can be called without holding the pipe's mutex.
+	//!
+	//! A pipe guarded by a mutex returns \c false.
+	//! Pins will lock the mutex they share with the pipe before calling push, pop or length.
+	virtual bool concurrent() const
+	{
+		return false;
+	}
+
 	//!\brief Pointer to the producing node's output pin.
 	virtual outpin<T>* input() const
 	{
@@ -78,6 +147,14 @@ public:
 		return d_packets.size();
 	}
 
+	//!\brief The next packet to be extracted, left in the pipe.
+	//!
+	//!\return \c nullptr if the pipe is empty.
+	virtual const packet<T>* front() const
+	{
+		return d_packets.empty() ? nullptr : d_packets.front().get();
+	}
+
 	//!\brief The maximum number of packets this pipe will carry.
 	//!
 	//! If 0, then uncapped.
@@ -100,6 +177,23 @@ public:
 		return d_max_weight;
 	}
 
+	//!\brief A snapshot of this pipe's counters.
+	//!
+	//! Can be called from any thread while packets flow through the pipe.
+	virtual pipe_metrics metrics() const
+	{
+		pipe_metrics m;
+
+		m.name = name();
+		m.pushed = d_pushed.value();
+		m.dropped = d_dropped.value();
+		m.high_water = d_high_water.value();
+		m.length = length();
+		m.weight = weight();
+
+		return m;
+	}
+
 	//!\brief Sets the maximum length.
 	virtual size_t cap_length(const size_t max_length)
 	{
@@ -115,6 +209,50 @@ public:
 		d_max_weight = max_weight;
 		return previous_cap;
 	}
+
+	//!\brief What this pipe does with packets that do not fit.
+	virtual overflow::type overflow_policy() const
+	{
+		return d_overflow;
+	}
+
+	//!\brief Sets what this pipe does with packets that do not fit.
+	//!
+	//!\return The previous policy.
+	virtual overflow::type set_overflow_policy(const overflow::type policy)
+	{
+		overflow::type previous = d_overflow;
+		d_overflow = policy;
+		return previous;
+	}
+
+	//!\brief The priority of this pipe.
+	//!
+	//! When a graph's budget is exhausted and its policy is budget_policy::shed, packets pushed to the pipes of lowest priority are discarded first.
+	//! The default priority is 0.
+	virtual int priority() const
+	{
+		return d_account.priority();
+	}
+
+	//!\brief Sets the priority of this pipe.
+	//!
+	//!\return The previous priority.
+	virtual int prioritize(const int priority)
+	{
+		return d_account.prioritize(priority);
+	}
+
+	//!\brief Makes the packets this pipe holds count against a graph's memory budget.
+	//!
+	//! The packets already in the pipe are charged to the budget right away.
+	//! Must not be called while packets are pushed to or popped from the pipe.
+	//!
+	//!\param budget_sp The budget, or \c nullptr to stop counting.
+	virtual void meter(const std::shared_ptr<detail::budget>& budget_sp)
+	{
+		d_account.meter(budget_sp, weight());
+	}
 	
 	//!\brief Discards all packets.
 	virtual size_t flush()
@@ -122,26 +260,69 @@ public:
 		size_t s = d_packets.size();
 		d_packets.clear();
 
+		d_account.release(d_weight);
+		d_weight = 0;
+
 		return s;
 	}
 
 	//!\brief Queues a packet in the pipe.
 	//!
 	//! Used by the producer node to move a packet it produced to the pipe.
-	//! If the packet does not fit in the pipe, it will not be moved.
+	//! If the packet does not fit in the pipe, the overflow policy applies.
+	//! With overflow::drop_oldest, the oldest packets are discarded until the packet fits.
 	//!
 	//!\param packet_p A pointer to the packet.
-	//!				   If this call is unsuccessful, packet_p will still point to the packet after the call.
+	//!				   If this call is unsuccessful, packet_p will still point to the packet after the call,
+	//!				   unless the policy is overflow::drop_newest or overflow::drop_oldest in which case it was discarded.
 	//!
 	//!\return true if the packet was successfully moved to the pipe, false otherwise.
 	virtual bool push(std::unique_ptr<packet<T>>& packet_p)
 	{
-		if(d_max_length && (d_packets.size() == d_max_length)) return false;
-		if(d_max_weight && (d_weight + packet_p->size() > d_max_weight)) return false;
+		if(d_overflow == overflow::drop_oldest)
+		{
+			while(!fits(*packet_p) && !d_packets.empty())
+			{
+				pop();
+				d_dropped.add(1);
+			}
+		}
+
+		if(!fits(*packet_p))
+		{
+			refuse(packet_p);
+			return false;
+		}
+
+		if(!d_account.admit(packet_p->size()))
+		{
+			// The graph's budget is exhausted. With budget_policy::drop_oldest, this pipe's oldest packets make room for the packet.
+			bool admitted = false;
+			if(d_account.policy() == budget_policy::drop_oldest)
+			{
+				while(!admitted && !d_packets.empty())
+				{
+					pop();
+					d_dropped.add(1);
+					d_account.shed(1);
+
+					admitted = d_account.admit(packet_p->size());
+				}
+			}
+
+			if(!admitted)
+			{
+				overdrawn(packet_p);
+				return false;
+			}
+		}
 
 		d_weight += packet_p->size();
 		d_packets.push_back(std::move(packet_p));
 
+		d_pushed.add(1);
+		d_high_water.raise(d_packets.size());
+
 		return true;
 	}
 	
@@ -158,11 +339,450 @@ public:
 		
 		d_packets.pop_front();
 		d_weight -= packet_p->size();
+		d_account.release(packet_p->size());
 
 		return packet_p;
 	}
+
+	//!\brief Queues many packets in the pipe.
+	//!
+	//! Packets are queued in order.
+	//! With overflow::reject and overflow::block, queuing stops at the first packet that does not fit.
+	//!
+	//!\param packets The packets to queue.
+	//!				  Packets moved to the pipe or discarded are removed from the front of \c packets, the others remain.
+	//!
+	//!\return The number of packets moved to the pipe.
+	virtual size_t push_n(packets_t& packets)
+	{
+		size_t n = 0, i = 0;
+		for(; i != packets.size(); ++i)
+		{
+			if(push(packets[i]))
+			{
+				++n;
+			}
+			else if(packets[i])
+			{
+				// The packet was refused rather than discarded.
+				break;
+			}
+		}
+
+		packets.erase(packets.begin(), packets.begin() + i);
+
+		// push counted the packet that was refused, count the ones after it.
+		if(!packets.empty() && d_overflow == overflow::reject)
+		{
+			d_dropped.add(packets.size() - 1);
+		}
+
+		return n;
+	}
+
+	//!\brief Extracts many packets from the pipe.
+	//!
+	//!\param packets The container to which extracted packets are appended.
+	//!\param max_n The maximum number of packets to extract. Do not set to extract all packets.
+	//!
+	//!\return The number of packets extracted.
+	virtual size_t pop_n(packets_t& packets, const size_t max_n = static_cast<size_t>(-1))
+	{
+		const size_t n = std::min(max_n, d_packets.size());
+		size_t removed = 0;
+
+		for(size_t i = 0; i != n; ++i)
+		{
+			removed += d_packets.front()->size();
+			packets.push_back(std::move(d_packets.front()));
+			d_packets.pop_front();
+		}
+
+		d_weight -= removed;
+		d_account.release(removed);
+
+		return n;
+	}
+
+protected:
+	//!\brief Applies the overflow policy to a packet that does not fit.
+	//!
+	//! Counts the packet as dropped, unless the producer will wait to push it again.
+	void refuse(std::unique_ptr<packet<T>>& packet_p)
+	{
+		if(d_overflow != overflow::block)
+		{
+			d_dropped.add(1);
+		}
+
+		if(d_overflow == overflow::drop_newest || d_overflow == overflow::drop_oldest)
+		{
+			packet_p.reset();
+		}
+	}
+
+	//!\brief Applies the budget policy to a packet the graph's budget has no room for.
+	//!
+	//! With budget_policy::backpressure, the packet is refused as if the pipe were full. Otherwise it is discarded.
+	void overdrawn(std::unique_ptr<packet<T>>& packet_p)
+	{
+		if(d_account.policy() == budget_policy::backpressure)
+		{
+			refuse(packet_p);
+		}
+		else
+		{
+			d_dropped.add(1);
+			d_account.shed(1);
+			packet_p.reset();
+		}
+	}
+
+private:
+	bool fits(const packet<T>& packet_r) const
+	{
+		return (!d_max_length || d_packets.size() < d_max_length) &&
+			   (!d_max_weight || d_weight + packet_r.size() <= d_max_weight);
+	}
+};
+
+//!\cond
+namespace detail
+{
+
+// The assumed size of a cache line.
+const size_t cache_line_size = 64;
+
+// An atomic index alone on its cache line so that a producer and a consumer
+// updating their respective index do not invalidate each other's cache.
+struct padded_index
+{
+	std::atomic<size_t> value;
+	size_t cached;	// Last value read of the opposite index. Only accessed by the thread that owns this index.
+
+	char padding[cache_line_size - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+	padded_index() : value(0), cached(0) {}
 };
 
+}
+//!\endcond
+
+//!\brief Lock-free, bounded, single-producer single-consumer pipe.
+//!
+//! Packets are stored in a circular buffer allocated when the pipe is constructed.
+//! The producing pin and the consuming pin each own an index to that buffer and never need to lock the pipe's mutex.
+//! Only one thread may push to a ring_pipe and only one thread may pop from it.
+//! Since the storage is allocated up front, a ring_pipe always has a capacity.
+//! If no maximum length is specified, \ref default_capacity is used.
+//! Since only the consuming thread may pop, overflow::drop_oldest discards the pushed packet instead, like overflow::drop_newest.
+template<typename T>
+class ring_pipe : public pipe<T>
+{
+	std::vector<std::unique_ptr<packet<T>>> d_ring;
+	const size_t d_mask;
+
+	std::atomic<size_t> d_capacity_a;
+	std::atomic<size_t> d_max_weight_a;
+	std::atomic<size_t> d_weight_a;
+
+	char d_padding[detail::cache_line_size];
+
+	detail::padded_index d_head;	// Written by the producer.
+	detail::padded_index d_tail;	// Written by the consumer.
+
+	// Smallest power of two greater than or equal to n.
+	static size_t round_up(const size_t n)
+	{
+		size_t r = 1;
+		while(r < n)
+		{
+			r <<= 1;
+		}
+
+		return r;
+	}
+
+public:
+	//!\brief The capacity given to a ring_pipe constructed with no maximum length.
+	static const size_t default_capacity = 1024;
+
+	//!\brief Constructor for a new ring pipe.
+	//!
+	//!\param name_r Name of this pipe. This will be typically generated from the names of the producing and consuming nodes.
+	//!\param output_p The output pin of the producing node.
+	//!\param input_p The input pin of the consuming node.
+	//!\param max_length The capacity of the ring. Do not set or set to 0 for \ref default_capacity.
+	//!\param max_weight The maximum number of bytes this pipe will carry. Do not set or set to 0 for uncapped weight.
+	//!\param policy What to do with packets that do not fit.
+	ring_pipe(const std::string& name_r, outpin<T> *output_p, inpin<T> *input_p, const size_t max_length = 0, const size_t max_weight = 0, const overflow::type policy = overflow::reject)
+		: pipe<T>(name_r, output_p, input_p, max_length ? max_length : default_capacity, max_weight, policy),
+		  d_ring(round_up(pipe<T>::d_max_length)), d_mask(d_ring.size() - 1), d_capacity_a(pipe<T>::d_max_length), d_max_weight_a(max_weight), d_weight_a(0)
+	{}
+
+	virtual ~ring_pipe() {}
+
+	//!\brief A ring_pipe needs no mutex.
+	virtual bool concurrent() const
+	{
+		return true;
+	}
+
+	//!\brief The pipe's current length. The number of packets in the pipe.
+	virtual size_t length() const
+	{
+		const size_t tail = d_tail.value.load(std::memory_order_acquire);
+		return d_head.value.load(std::memory_order_acquire) - tail;
+	}
+
+	//!\brief The next packet to be extracted, left in the pipe.
+	//!
+	//! Must only be called from the consuming thread.
+	//!
+	//!\return \c nullptr if the pipe is empty.
+	virtual const packet<T>* front() const
+	{
+		const size_t tail = d_tail.value.load(std::memory_order_relaxed);
+		if(tail == d_head.value.load(std::memory_order_acquire)) return nullptr;
+
+		return d_ring[tail & d_mask].get();
+	}
+
+	//!\brief The capacity of the ring.
+	virtual size_t max_length() const
+	{
+		return d_capacity_a.load(std::memory_order_relaxed);
+	}
+
+	//!\brief The pipe's current weight. The sum of all bytes of all packets in the pipe.
+	virtual size_t weight() const
+	{
+		return d_weight_a.load(std::memory_order_relaxed);
+	}
+
+	//!\brief The maximum number of bytes this pipe will carry.
+	//!
+	//! If 0, then uncapped.
+	virtual size_t max_weight() const
+	{
+		return d_max_weight_a.load(std::memory_order_relaxed);
+	}
+
+	//!\brief Sets the capacity of the ring.
+	//!
+	//! The storage of the ring is not reallocated.
+	//! The capacity can be lowered but not raised beyond the storage allocated at construction.
+	//! If 0, the capacity is set to that storage.
+	virtual size_t cap_length(const size_t max_length)
+	{
+		pipe<T>::d_max_length = max_length ? std::min(max_length, d_ring.size()) : d_ring.size();
+		return d_capacity_a.exchange(pipe<T>::d_max_length);
+	}
+
+	//!\brief Sets the maximum weight.
+	virtual size_t cap_weight(const size_t max_weight)
+	{
+		pipe<T>::d_max_weight = max_weight;
+		return d_max_weight_a.exchange(max_weight);
+	}
+
+	//!\brief Discards all packets.
+	//!
+	//! Must be called from the consuming thread.
+	virtual size_t flush()
+	{
+		size_t s = 0;
+		while(pop())
+		{
+			++s;
+		}
+
+		return s;
+	}
+
+	//!\brief Queues a packet in the pipe.
+	//!
+	//! Must only be called from the producing thread.
+	//!
+	//!\param packet_p A pointer to the packet.
+	//!				   If this call is unsuccessful, packet_p will still point to the packet after the call.
+	//!
+	//!\return true if the packet was successfully moved to the pipe, false otherwise.
+	virtual bool push(std::unique_ptr<packet<T>>& packet_p)
+	{
+		const size_t head = d_head.value.load(std::memory_order_relaxed);
+		const size_t capacity = d_capacity_a.load(std::memory_order_relaxed);
+
+		if(head - d_head.cached >= capacity)
+		{
+			// The ring looked full the last time we checked, see how far the consumer has gone since.
+			d_head.cached = d_tail.value.load(std::memory_order_acquire);
+			if(head - d_head.cached >= capacity)
+			{
+				pipe<T>::refuse(packet_p);
+				return false;
+			}
+		}
+
+		const size_t max_weight = d_max_weight_a.load(std::memory_order_relaxed);
+		if(max_weight && (d_weight_a.load(std::memory_order_relaxed) + packet_p->size() > max_weight))
+		{
+			pipe<T>::refuse(packet_p);
+			return false;
+		}
+
+		// The ring cannot discard its oldest packets from the producing side, budget_policy::drop_oldest discards the packet instead.
+		if(!pipe<T>::d_account.admit(packet_p->size()))
+		{
+			pipe<T>::overdrawn(packet_p);
+			return false;
+		}
+
+		d_weight_a.fetch_add(packet_p->size(), std::memory_order_relaxed);
+		d_ring[head & d_mask] = std::move(packet_p);
+		d_head.value.store(head + 1, std::memory_order_release);
+
+		pipe<T>::d_pushed.add(1);
+		pipe<T>::d_high_water.raise(head + 1 - d_tail.value.load(std::memory_order_relaxed));
+
+		return true;
+	}
+
+	//!\brief Extracts a packet from the pipe.
+	//!
+	//! Must only be called from the consuming thread.
+	//!
+	//!\return A pointer to the next packet in the pipe, empty pointer if there is no packet.
+	virtual std::unique_ptr<packet<T>> pop()
+	{
+		const size_t tail = d_tail.value.load(std::memory_order_relaxed);
+
+		if(tail == d_tail.cached)
+		{
+			// The ring looked empty the last time we checked, see how far the producer has gone since.
+			d_tail.cached = d_head.value.load(std::memory_order_acquire);
+			if(tail == d_tail.cached) return std::unique_ptr<packet<T>>();
+		}
+
+		std::unique_ptr<packet<T>> packet_p(std::move(d_ring[tail & d_mask]));
+		d_tail.value.store(tail + 1, std::memory_order_release);
+		d_weight_a.fetch_sub(packet_p->size(), std::memory_order_relaxed);
+		pipe<T>::d_account.release(packet_p->size());
+
+		return packet_p;
+	}
+
+	//!\brief Queues many packets in the pipe.
+	//!
+	//! Must only be called from the producing thread.
+	//! The packets are published to the consumer all at once.
+	//!
+	//!\param packets The packets to queue.
+	//!				  Packets moved to the pipe or discarded are removed from the front of \c packets, the others remain.
+	//!
+	//!\return The number of packets moved to the pipe.
+	virtual size_t push_n(typename pipe<T>::packets_t& packets)
+	{
+		const size_t head = d_head.value.load(std::memory_order_relaxed);
+		const size_t capacity = d_capacity_a.load(std::memory_order_relaxed);
+
+		if(head - d_head.cached + packets.size() > capacity)
+		{
+			d_head.cached = d_tail.value.load(std::memory_order_acquire);
+		}
+
+		const size_t room = capacity > head - d_head.cached ? capacity - (head - d_head.cached) : 0;
+		const size_t max_weight = d_max_weight_a.load(std::memory_order_relaxed);
+		size_t weight = d_weight_a.load(std::memory_order_relaxed), added = 0;
+
+		size_t n = 0;
+		bool overdrawn = false;
+		for(; n != std::min(room, packets.size()); ++n)
+		{
+			if(max_weight && (weight + added + packets[n]->size() > max_weight)) break;
+
+			if(!pipe<T>::d_account.admit(packets[n]->size()))
+			{
+				overdrawn = true;
+				break;
+			}
+
+			added += packets[n]->size();
+			d_ring[(head + n) & d_mask] = std::move(packets[n]);
+		}
+
+		d_weight_a.fetch_add(added, std::memory_order_relaxed);
+		d_head.value.store(head + n, std::memory_order_release);
+
+		pipe<T>::d_pushed.add(n);
+		pipe<T>::d_high_water.raise(head + n - d_tail.value.load(std::memory_order_relaxed));
+
+		const overflow::type policy = pipe<T>::d_overflow;
+		if(overdrawn && pipe<T>::d_account.policy() != budget_policy::backpressure)
+		{
+			// The graph's budget is exhausted, the packets left are discarded.
+			pipe<T>::d_dropped.add(packets.size() - n);
+			pipe<T>::d_account.shed(packets.size() - n);
+			packets.clear();
+
+			return n;
+		}
+
+		if(policy != overflow::block)
+		{
+			pipe<T>::d_dropped.add(packets.size() - n);
+		}
+
+		if(policy == overflow::drop_newest || policy == overflow::drop_oldest)
+		{
+			packets.clear();
+		}
+		else
+		{
+			packets.erase(packets.begin(), packets.begin() + n);
+		}
+
+		return n;
+	}
+
+	//!\brief Extracts many packets from the pipe.
+	//!
+	//! Must only be called from the consuming thread.
+	//! The space used by the packets is released to the producer all at once.
+	//!
+	//!\param packets The container to which extracted packets are appended.
+	//!\param max_n The maximum number of packets to extract. Do not set to extract all packets.
+	//!
+	//!\return The number of packets extracted.
+	virtual size_t pop_n(typename pipe<T>::packets_t& packets, const size_t max_n = static_cast<size_t>(-1))
+	{
+		const size_t tail = d_tail.value.load(std::memory_order_relaxed);
+
+		if(d_tail.cached - tail < max_n)
+		{
+			d_tail.cached = d_head.value.load(std::memory_order_acquire);
+		}
+
+		const size_t n = std::min(max_n, d_tail.cached - tail);
+		size_t removed = 0;
+
+		for(size_t i = 0; i != n; ++i)
+		{
+			removed += d_ring[(tail + i) & d_mask]->size();
+			packets.push_back(std::move(d_ring[(tail + i) & d_mask]));
+		}
+
+		d_tail.value.store(tail + n, std::memory_order_release);
+		d_weight_a.fetch_sub(removed, std::memory_order_relaxed);
+		pipe<T>::d_account.release(removed);
+
+		return n;
+	}
+};
+
+template<typename T>
+const size_t ring_pipe<T>::default_capacity;
+
 }
 
 #endif
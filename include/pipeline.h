@@ -0,0 +1,277 @@
+#if !defined(FLOW_PIPELINE_H)
+	 #define FLOW_PIPELINE_H
+
+#include "node.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+//!\file pipeline.h
+//!
+//!\brief Defines the \ref flow::static_pipeline class and the functions that build and wrap one.
+
+namespace flow
+{
+
+//!\cond
+namespace detail
+{
+
+// Calls the stages of a tuple from I to N - 1, each with the result of the one before.
+template<size_t I, size_t N, bool Last = I + 1 == N>
+struct chain
+{
+	template<typename Stages, typename A>
+	static auto call(Stages& stages, A&& a) -> decltype(chain<I + 1, N>::call(stages, std::get<I>(stages)(std::forward<A>(a))))
+	{
+		return chain<I + 1, N>::call(stages, std::get<I>(stages)(std::forward<A>(a)));
+	}
+};
+
+// The last stage's result, if any, is the result of the pipeline.
+template<size_t I, size_t N>
+struct chain<I, N, true>
+{
+	template<typename Stages, typename A>
+	static auto call(Stages& stages, A&& a) -> decltype(std::get<I>(stages)(std::forward<A>(a)))
+	{
+		return std::get<I>(stages)(std::forward<A>(a));
+	}
+};
+
+}
+//!\endcond
+
+//!\brief A sequence of stages composed at compile time.
+//!
+//! A stage is any callable: a function, a functor or a lambda.
+//! Calling the pipeline calls the first stage with the argument, every following stage with the result of the one before,
+//! and returns the result of the last stage, if any.
+//!
+//! Calls between stages are direct and can be inlined.
+//! Stages that do not fit together are a compile-time error.
+//! Unlike a \ref graph, the stages of a pipeline run on the thread calling the pipeline and its topology cannot change.
+//! To make a pipeline part of a graph, wrap it in a node with \ref make_transformer or \ref make_consumer.
+//!
+//! Build pipelines with \ref pipeline.
+//!
+//!\tparam Stages The types of the stages.
+template<typename... Stages>
+class static_pipeline
+{
+	static_assert(sizeof...(Stages) != 0, "A pipeline needs at least one stage.");
+
+	typedef std::tuple<Stages...> stages_t;
+	stages_t d_stages;
+
+public:
+	//!\param stages The stages, in order.
+	template<typename... Args>
+	explicit static_pipeline(Args&&... stages) : d_stages(std::forward<Args>(stages)...) {}
+
+	//!\brief Runs an argument through all stages.
+	//!
+	//!\return The result of the last stage.
+	template<typename A>
+	auto operator()(A&& a) -> decltype(detail::chain<0, sizeof...(Stages)>::call(std::declval<stages_t&>(), std::forward<A>(a)))
+	{
+		return detail::chain<0, sizeof...(Stages)>::call(d_stages, std::forward<A>(a));
+	}
+
+	//!\brief The number of stages.
+	static size_t size()
+	{
+		return sizeof...(Stages);
+	}
+
+	//!\brief Access to a stage.
+	template<size_t I>
+	typename std::tuple_element<I, stages_t>::type& stage()
+	{
+		return std::get<I>(d_stages);
+	}
+};
+
+//!\brief Builds a pipeline out of stages.
+//!
+//! For instance:
+//!\code
+//! auto p = flow::pipeline([](int i){ return i + 1; }, [](int i){ return std::to_string(i); });
+//! std::string s = p(41);	// "42"
+//!\endcode
+//!
+//!\param stages The stages, in order. They are copied or moved into the pipeline.
+template<typename... Stages>
+static_pipeline<typename std::decay<Stages>::type...> pipeline(Stages&&... stages)
+{
+	return static_pipeline<typename std::decay<Stages>::type...>(std::forward<Stages>(stages)...);
+}
+
+//!\brief Concrete transformer that runs its packets through a \ref static_pipeline "static_pipeline".
+//!
+//! A whole pipeline costs one pop and one push, however many stages it has.
+//! When the pipeline's result is of the same type as its argument, packets are reused and keep their consumption time.
+//!
+//! Made by \ref make_transformer.
+//!
+//!\tparam C The type of data this node consumes, the pipeline's argument.
+//!\tparam P The type of data this node produces, the pipeline's result.
+//!\tparam Pipeline The type of the pipeline.
+template<typename C, typename P, typename Pipeline>
+class pipeline_transformer : public transformer<C, P>
+{
+	Pipeline d_pipeline;
+
+	typename pipe<P>::packets_t d_results;
+
+	// The pipeline's result replaces the data of the packet.
+	void run(std::unique_ptr<packet<C>>& packet_p, std::true_type)
+	{
+		packet_p->data() = d_pipeline(std::move(packet_p->data()));
+		d_results.push_back(std::move(packet_p));
+	}
+
+	// The pipeline's result goes in a new packet.
+	void run(std::unique_ptr<packet<C>>& packet_p, std::false_type)
+	{
+		d_results.push_back(producer<P>::make_packet(d_pipeline(std::move(packet_p->data()))));
+	}
+
+public:
+	//! This transformer has only one input and one output.
+	//!
+	//!\param pipeline The pipeline to run packets through.
+	//!\param name_r The name to give this node.
+	pipeline_transformer(Pipeline pipeline, const std::string& name_r = "pipeline") : node(name_r), transformer<C, P>(name_r, 1, 1), d_pipeline(std::move(pipeline))
+	{
+		consumer<C>::template batch<pipeline_transformer>();
+	}
+
+	virtual ~pipeline_transformer() {}
+
+	//!\brief Implementation of consumer::ready().
+	virtual void ready(size_t)
+	{
+		std::unique_ptr<packet<C>> packet_p = consumer<C>::input(0).pop();
+
+		run(packet_p, std::is_same<C, P>());
+
+		producer<P>::output(0).push_n(d_results);
+		d_results.clear();
+	}
+
+	//!\brief Implementation of consumer::ready_batch().
+	virtual void ready_batch(size_t, typename pipe<C>::packets_t& packets)
+	{
+		for(auto& packet_p : packets)
+		{
+			run(packet_p, std::is_same<C, P>());
+		}
+
+		producer<P>::output(0).push_n(d_results);
+		d_results.clear();
+	}
+};
+
+//!\brief Concrete consumer that runs its packets through a \ref static_pipeline "static_pipeline" and discards the results.
+//!
+//! Typically, the last stage of such a pipeline returns nothing.
+//!
+//! Made by \ref make_consumer.
+//!
+//!\tparam C The type of data this node consumes, the pipeline's argument.
+//!\tparam Pipeline The type of the pipeline.
+template<typename C, typename Pipeline>
+class pipeline_consumer : public consumer<C>
+{
+	Pipeline d_pipeline;
+
+public:
+	//! This consumer has only one input.
+	//!
+	//!\param pipeline The pipeline to run packets through.
+	//!\param name_r The name to give this node.
+	pipeline_consumer(Pipeline pipeline, const std::string& name_r = "pipeline") : node(name_r), consumer<C>(name_r, 1), d_pipeline(std::move(pipeline))
+	{
+		consumer<C>::template batch<pipeline_consumer>();
+	}
+
+	virtual ~pipeline_consumer() {}
+
+	//!\brief Implementation of consumer::ready().
+	virtual void ready(size_t)
+	{
+		d_pipeline(std::move(consumer<C>::input(0).pop()->data()));
+	}
+
+	//!\brief Implementation of consumer::ready_batch().
+	virtual void ready_batch(size_t, typename pipe<C>::packets_t& packets)
+	{
+		for(auto& packet_p : packets)
+		{
+			d_pipeline(std::move(packet_p->data()));
+		}
+	}
+};
+
+//!\brief Wraps a pipeline in a transformer node.
+//!
+//! The type of data the node produces is the pipeline's result, decayed.
+//!
+//!\tparam C The type of data the node consumes.
+//!\param pipeline The pipeline to run packets through.
+//!\param name_r The name to give the node.
+template<typename C, typename Pipeline>
+std::shared_ptr<pipeline_transformer<C, typename std::decay<decltype(std::declval<Pipeline&>()(std::declval<C>()))>::type, Pipeline>> make_transformer(Pipeline pipeline, const std::string& name_r = "pipeline")
+{
+	typedef typename std::decay<decltype(std::declval<Pipeline&>()(std::declval<C>()))>::type P;
+
+	return std::make_shared<pipeline_transformer<C, P, Pipeline>>(std::move(pipeline), name_r);
+}
+
+//!\brief Wraps a pipeline in a consumer node.
+//!
+//!\tparam C The type of data the node consumes.
+//!\param pipeline The pipeline to run packets through.
+//!\param name_r The name to give the node.
+template<typename C, typename Pipeline>
+std::shared_ptr<pipeline_consumer<C, Pipeline>> make_consumer(Pipeline pipeline, const std::string& name_r = "pipeline")
+{
+	return std::make_shared<pipeline_consumer<C, Pipeline>>(std::move(pipeline), name_r);
+}
+
+}
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,238 @@
+#if !defined(FLOW_POOL_H)
+	 #define FLOW_POOL_H
+
+#include "packet.h"
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <utility>
+
+//!\file pool.h
+//!
+//!\brief Defines the \ref flow::packet_pool class.
+
+namespace flow
+{
+
+//!\brief Recycles the memory of packets.
+//!
+//! Packets made by a pool are wrapped in a regular std::unique_ptr.
+//! When such a packet is deleted, whichever the thread, its memory goes back to the pool that made it instead of to the global allocator.
+//! After a warm-up period, a producer that makes its packets with a pool no longer allocates memory.
+//!
+//! Packets can be made by only one thread at a time, typically the thread of the node that owns the pool.
+//! Packets can be deleted by any thread and can outlive the pool that made them.
+template<typename T>
+class packet_pool
+{
+	class state : public detail::recycler
+	{
+		// A free block holds the link to the next one where the packet goes, which can be smaller than a pointer.
+		static const size_t block_size = detail::block_header_size + (sizeof(packet<T>) > sizeof(detail::block_header*) ? sizeof(packet<T>) : sizeof(detail::block_header*));
+
+		std::atomic<detail::block_header*> d_returned_a;	// Blocks of deleted packets. Pushed to by any thread.
+		detail::block_header *d_free_p;						// Blocks ready for reuse. Only accessed by the allocating thread.
+
+		std::atomic<size_t> d_refs_a;		// One for each packet in circulation plus one for the owning packet_pool.
+		std::atomic<bool> d_orphaned_a;		// Set when the owning packet_pool is destroyed.
+		std::atomic<size_t> d_allocated_a;	// Number of blocks allocated with the global allocator.
+
+		static detail::block_header*& next(detail::block_header* header_p)
+		{
+			return *static_cast<detail::block_header**>(detail::storage_of(header_p));
+		}
+
+		static void free_all(detail::block_header* header_p)
+		{
+			while(header_p)
+			{
+				detail::block_header *next_p = next(header_p);
+				::operator delete(header_p);
+				header_p = next_p;
+			}
+		}
+
+		void release()
+		{
+			if(d_refs_a.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				delete this;
+			}
+		}
+
+	public:
+		state() : d_returned_a(nullptr), d_free_p(nullptr), d_refs_a(1), d_orphaned_a(false), d_allocated_a(0) {}
+
+		virtual ~state()
+		{
+			free_all(d_free_p);
+			free_all(d_returned_a.exchange(nullptr));
+		}
+
+		// Returns storage for a packet.
+		void* acquire()
+		{
+			if(!d_free_p)
+			{
+				d_free_p = d_returned_a.exchange(nullptr, std::memory_order_acquire);
+			}
+
+			detail::block_header *header_p = d_free_p;
+			if(header_p)
+			{
+				d_free_p = next(header_p);
+			}
+			else
+			{
+				header_p = static_cast<detail::block_header*>(::operator new(block_size));
+				d_allocated_a.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			header_p->recycler_p = this;
+			d_refs_a.fetch_add(1, std::memory_order_relaxed);
+
+			return detail::storage_of(header_p);
+		}
+
+		// Returns storage obtained from acquire that was not used to construct a packet.
+		void unacquire(void* p)
+		{
+			detail::block_header *header_p = detail::header_of(p);
+
+			next(header_p) = d_free_p;
+			d_free_p = header_p;
+
+			release();
+		}
+
+		// Allocates blocks ahead of time.
+		void reserve(size_t n)
+		{
+			while(n--)
+			{
+				detail::block_header *header_p = static_cast<detail::block_header*>(::operator new(block_size));
+				d_allocated_a.fetch_add(1, std::memory_order_relaxed);
+
+				next(header_p) = d_free_p;
+				d_free_p = header_p;
+			}
+		}
+
+		size_t allocated() const
+		{
+			return d_allocated_a.load(std::memory_order_relaxed);
+		}
+
+		// Called by packet::operator delete.
+		virtual void recycle(void* block_p)
+		{
+			detail::block_header *header_p = static_cast<detail::block_header*>(block_p);
+
+			if(d_orphaned_a.load(std::memory_order_acquire))
+			{
+				::operator delete(header_p);
+			}
+			else
+			{
+				next(header_p) = d_returned_a.load(std::memory_order_relaxed);
+				while(!d_returned_a.compare_exchange_weak(next(header_p), header_p, std::memory_order_release, std::memory_order_relaxed));
+			}
+
+			release();
+		}
+
+		// Called when the owning packet_pool is destroyed.
+		// Packets still in circulation will be freed when deleted. The last one to go takes this state with it.
+		void orphan()
+		{
+			d_orphaned_a.store(true, std::memory_order_release);
+
+			free_all(d_free_p);
+			d_free_p = nullptr;
+			free_all(d_returned_a.exchange(nullptr, std::memory_order_acquire));
+
+			release();
+		}
+	};
+
+	state *d_state_p;
+
+	packet_pool(const packet_pool&);
+	packet_pool& operator=(const packet_pool&);
+
+public:
+	packet_pool() : d_state_p(new state) {}
+
+	virtual ~packet_pool()
+	{
+		d_state_p->orphan();
+	}
+
+	//!\brief Makes a packet whose memory comes from this pool.
+	//!
+	//! Must only be called by one thread at a time.
+	//!
+	//!\param args The arguments forwarded to the packet's constructor.
+	template<typename... Args>
+	std::unique_ptr<packet<T>> make_packet(Args&&... args)
+	{
+		void *p = d_state_p->acquire();
+
+		try
+		{
+			return std::unique_ptr<packet<T>>(::new(p) packet<T>(std::forward<Args>(args)...));
+		}
+		catch(...)
+		{
+			d_state_p->unacquire(p);
+			throw;
+		}
+	}
+
+	//!\brief Allocates memory for \c n packets ahead of time.
+	//!
+	//! Must only be called by the thread that makes packets.
+	virtual void reserve(const size_t n)
+	{
+		d_state_p->reserve(n);
+	}
+
+	//!\brief The number of times this pool had to allocate memory for a packet.
+	virtual size_t allocated() const
+	{
+		return d_state_p->allocated();
+	}
+};
+
+}
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
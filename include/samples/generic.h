@@ -1,15 +1,22 @@
 #if !defined(FLOW_GENERIC_H)
 	 #define FLOW_GENERIC_H
 
+#include "delivery.h"
+#include "metrics.h"
 #include "node.h"
 #include "timer.h"
 
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <iostream>
 #include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
 #include <thread>
+#include <vector>
 
 //!\file generic.h
 //!
@@ -34,16 +41,39 @@ class generator : public producer<T>
 	std::mutex d_awaken_m;
 	bool d_awaken;
 
+	timer &d_timer_r;
+	size_t d_token;
+
 public:
 	//!\param timer_r Timer that will signal when to produce a packet.
 	//!\param gen_f The functor to be called. The return value of this functor will be considered a packet.
 	//!\param name_r The name to give this node.
-	generator(timer& timer_r, const std::function<T ()>& gen_f, const std::string& name_r = "generator") : node(name_r), producer<T>(name_r, 1), d_gen_f(gen_f), d_awaken(false)
+	generator(timer& timer_r, const std::function<T ()>& gen_f, const std::string& name_r = "generator") : node(name_r), producer<T>(name_r, 1), d_gen_f(gen_f), d_awaken(false), d_timer_r(timer_r)
+	{
+		d_token = timer_r.listen(std::bind(&generator::timer_fired, this));
+	}
+
+	//!\param timer_r Timer that will signal when to produce a packet. It can be shared by many generators running at different rates.
+	//!\param interval The time between packets. Must be a duration typedef from \<chrono\>.
+	//!\param gen_f The functor to be called. The return value of this functor will be considered a packet.
+	//!\param name_r The name to give this node.
+	template<typename Duration>
+	generator(multirate_timer& timer_r, const Duration& interval, const std::function<T ()>& gen_f, const std::string& name_r = "generator") : node(name_r), producer<T>(name_r, 1), d_gen_f(gen_f), d_awaken(false), d_timer_r(timer_r)
+	{
+		d_token = timer_r.listen(std::bind(&generator::timer_fired, this), interval);
+	}
+
+	//!\brief Stops listening to the timer, which must outlive this generator.
+	virtual ~generator()
 	{
-		timer_r.listen(std::bind(&generator::timer_fired, this));
+		d_timer_r.ignore(d_token);
 	}
 
-	virtual ~generator() {}
+	//!\brief A generator waits on its timer.
+	virtual bool blocks() const
+	{
+		return true;
+	}
 
 	//!\brief implementation of node::stopped().
 	virtual void stopped()
@@ -75,7 +105,7 @@ public:
 
 		if(node::state() == state::started)
 		{
-			std::unique_ptr<packet<T>> packet_p(new packet<T>(d_gen_f()));
+			std::unique_ptr<packet<T>> packet_p(producer<T>::make_packet(d_gen_f()));
 
 			producer<T>::output(0).push(packet_p);
 		}
@@ -100,9 +130,16 @@ public:
 
 	virtual ~ostreamer() {}
 
+	//!\brief An ostreamer waits until the consumption time of the packets it receives.
+	virtual bool blocks() const
+	{
+		return true;
+	}
+
 	//!\brief Implementation of node::stopped().
 	virtual void stopped()
 	{
+		std::lock_guard<std::mutex> lg(d_stopped_m);
 		d_stopped_cv.notify_one();
 	}
 
@@ -126,9 +163,7 @@ public:
 			// This packet must be consumed at a set time.
 			// Wait until then or until this node is stopped.
 			std::unique_lock<std::mutex> l_stopped(d_stopped_m);
-			d_stopped_cv.wait_until(l_stopped, packet_p->consumption_time());
-
-			if(node::state() == state::started)
+			if(!d_stopped_cv.wait_until(l_stopped, packet_p->consumption_time(), [this]{ return node::state() != state::started; }))
 			{
 				d_o_r << packet_p->data() << std::endl;
 			}
@@ -136,16 +171,239 @@ public:
 	}
 };
 
+//!\cond
+namespace detail
+{
+
+// A stream buffer that appends characters to a string.
+class appender : public std::streambuf
+{
+	std::string *d_string_p;
+
+protected:
+	virtual int_type overflow(int_type c)
+	{
+		if(!traits_type::eq_int_type(c, traits_type::eof()))
+		{
+			d_string_p->push_back(traits_type::to_char_type(c));
+		}
+
+		return traits_type::not_eof(c);
+	}
+
+	virtual std::streamsize xsputn(const char* s, std::streamsize n)
+	{
+		d_string_p->append(s, static_cast<size_t>(n));
+
+		return n;
+	}
+
+public:
+	appender(std::string* string_p) : d_string_p(string_p) {}
+};
+
+}
+//!\endcond
+
+//!\brief Concrete consumer that outputs packets to a parameter std::ostream from a thread of its own.
+//!
+//! Packets are formatted in a memory buffer, one per line, and the buffer is handed to a writer thread to be written out and flushed.
+//! While the writer thread writes one buffer, packets are formatted in the other.
+//! The consuming thread never waits on the output stream, so a buffered_ostreamer does not block and can run on a \ref flow::scheduler.
+//!
+//! The buffer is handed over when it reaches a given size or when a given interval has passed, whichever comes first.
+//! It is also handed over when the node is paused or stopped and when the node is destroyed.
+//! If the stream is slower than the packets coming in, the buffer keeps growing.
+//!
+//! Unlike \ref ostreamer, consumption times are ignored, packets are formatted as soon as they arrive.
+//! A \ref deliverer upstream holds packets until their consumption time.
+//!
+//! The stream must not be used by anything else while this node exists.
+template<typename T>
+class buffered_ostreamer : public consumer<T>
+{
+	std::ostream& d_o_r;
+
+	const size_t d_flush_size;
+	const std::chrono::milliseconds d_flush_interval;
+
+	std::string d_front;		// Packets are formatted here.
+	std::string d_back;			// Being written out by the writer thread.
+	detail::appender d_appender;
+	std::ostream d_format;		// Formats to d_front.
+
+	size_t d_formatted;			// Bytes formatted so far.
+	size_t d_written;			// Bytes written to the stream so far.
+	bool d_full;				// Whether d_front has reached d_flush_size.
+	bool d_flushing;			// Whether d_front was asked to be handed over before it is full.
+	bool d_quit;
+
+	std::condition_variable d_write_cv;
+	std::condition_variable d_written_cv;
+	std::mutex d_m;
+
+	std::thread d_writer;
+
+	// Formats a packet's data. Must be called with d_m locked.
+	void format(const T& t)
+	{
+		const size_t before = d_front.size();
+
+		d_format << t << '\n';
+
+		d_formatted += d_front.size() - before;
+
+		if(!d_full && d_front.size() >= d_flush_size)
+		{
+			d_full = true;
+			d_write_cv.notify_one();
+		}
+	}
+
+	void write()
+	{
+		std::unique_lock<std::mutex> ul(d_m);
+
+		while(true)
+		{
+			d_write_cv.wait_for(ul, d_flush_interval, [this]{ return d_full || d_flushing || d_quit; });
+
+			d_full = d_flushing = false;
+
+			if(d_front.empty())
+			{
+				if(d_quit) return;
+
+				continue;
+			}
+
+			d_front.swap(d_back);
+
+			ul.unlock();
+
+			d_o_r.write(d_back.data(), d_back.size());
+			d_o_r.flush();
+
+			ul.lock();
+
+			d_written += d_back.size();
+			d_back.clear();
+
+			d_written_cv.notify_all();
+		}
+	}
+
+	// Hands the buffer over to the writer thread without waiting for it to be written.
+	void hand_over()
+	{
+		std::lock_guard<std::mutex> lg(d_m);
+		d_flushing = true;
+		d_write_cv.notify_one();
+	}
+
+public:
+	//! This consumer has only one input.
+	//!
+	//!\param o_r Reference to the output stream.
+	//!\param flush_size The number of bytes to format before handing the buffer over to the writer thread.
+	//!\param flush_interval The longest time formatted packets wait before being handed over.
+	//!\param name_r The name to give this node.
+	buffered_ostreamer(std::ostream& o_r, const size_t flush_size = 1 << 16, const std::chrono::milliseconds& flush_interval = std::chrono::milliseconds(100), const std::string& name_r = "buffered_ostreamer") :
+		 node(name_r), consumer<T>(name_r, 1), d_o_r(o_r), d_flush_size(flush_size), d_flush_interval(flush_interval),
+		 d_appender(&d_front), d_format(&d_appender), d_formatted(0), d_written(0), d_full(false), d_flushing(false), d_quit(false)
+	{
+		d_front.reserve(d_flush_size);
+		d_back.reserve(d_flush_size);
+
+		consumer<T>::template batch<buffered_ostreamer>();
+
+		d_writer = std::thread([this]{ this->write(); });
+	}
+
+	//!\brief Writes out whatever was formatted and joins the writer thread.
+	virtual ~buffered_ostreamer()
+	{
+		{
+			std::lock_guard<std::mutex> lg(d_m);
+			d_quit = true;
+			d_write_cv.notify_one();
+		}
+
+		d_writer.join();
+	}
+
+	//!\brief The number of bytes written to the stream so far.
+	virtual size_t written()
+	{
+		std::lock_guard<std::mutex> lg(d_m);
+		return d_written;
+	}
+
+	//!\brief Waits until everything formatted so far is written to the stream.
+	//!
+	//! This function is meant to be called from outside the graph, the consuming thread itself never waits for the stream.
+	virtual void flush()
+	{
+		std::unique_lock<std::mutex> ul(d_m);
+
+		const size_t formatted = d_formatted;
+
+		d_flushing = true;
+		d_write_cv.notify_one();
+
+		d_written_cv.wait(ul, [this, formatted]{ return d_written >= formatted; });
+	}
+
+	//!\brief Implementation of node::paused().
+	virtual void paused()
+	{
+		hand_over();
+	}
+
+	//!\brief Implementation of node::stopped().
+	virtual void stopped()
+	{
+		hand_over();
+	}
+
+	//!\brief Implementation of consumer::ready().
+	virtual void ready(size_t)
+	{
+		std::unique_ptr<packet<T>> packet_p = consumer<T>::input(0).pop();
+
+		std::lock_guard<std::mutex> lg(d_m);
+		format(packet_p->data());
+	}
+
+	//!\brief Implementation of consumer::ready_batch().
+	virtual void ready_batch(size_t, typename pipe<T>::packets_t& packets)
+	{
+		std::lock_guard<std::mutex> lg(d_m);
+		for(auto& packet_p : packets)
+		{
+			format(packet_p->data());
+		}
+	}
+};
+
 //!\brief Concrete transformer that clones one input packet to multiple output packets.
+//!
+//! Clones are copies of the original packet.
+//! To broadcast a large payload without copying it, make T a \ref flow::shared "shared" payload.
 template<typename T>
 class tee : public transformer<T, T>
 {
+	typename pipe<T>::packets_t d_copies;
+
 public:
 	//! The number of ouput pins specified is the number of clones this node will output.
 	//!
 	//!\param outs Number of output pins.
 	//!\param name_r The name to give this node.
-	tee(const size_t outs = 2, const std::string& name_r = "tee") : node(name_r), transformer<T, T>(name_r, 1, outs) {}
+	tee(const size_t outs = 2, const std::string& name_r = "tee") : node(name_r), transformer<T, T>(name_r, 1, outs)
+	{
+		consumer<T>::template batch<tee>();
+	}
 
 	virtual ~tee() {}
 
@@ -158,12 +416,221 @@ public:
 		
 		for(size_t s = 1; s != producer<T>::outs(); ++s)
 		{
-			std::unique_ptr<packet<T>> copy_p(new packet<T>(*packet_p));
+			std::unique_ptr<packet<T>> copy_p(producer<T>::make_packet(*packet_p));
 			producer<T>::output(s).push(copy_p);
 		}
 
 		producer<T>::output(0).push(packet_p);
 	}
+
+	//!\brief Implementation of consumer::ready_batch().
+	//!
+	//! The original input packets are moved to the first output pipe after they are copied into the rest of the ouput pipes.
+	virtual void ready_batch(size_t, typename pipe<T>::packets_t& packets)
+	{
+		for(size_t s = 1; s != producer<T>::outs(); ++s)
+		{
+			for(auto& packet_p : packets)
+			{
+				d_copies.push_back(producer<T>::make_packet(*packet_p));
+			}
+
+			producer<T>::output(s).push_n(d_copies);
+			d_copies.clear();
+		}
+
+		producer<T>::output(0).push_n(packets);
+	}
+};
+
+//!\brief Concrete transformer that holds packets until their consumption time.
+//!
+//! Packets are kept ordered by consumption time, so a packet that arrives later but is due earlier goes out first.
+//! They are pushed to the output by the \ref flow::delivery "delivery" given at construction time, on its thread.
+//! This node never blocks, and neither does the consumer it feeds, which can consume packets as soon as they arrive.
+//!
+//! Packets with no consumption time are passed on right away, in order.
+//! Packets whose consumption time has already passed when they arrive are discarded and counted as late.
+//! Packets still held when the node is stopped are discarded.
+//!
+//! The output must not be connected with overflow::block, the delivery's thread would wait for room.
+template<typename T>
+class deliverer : public transformer<T, T>
+{
+	typedef typename packet<T>::time_point_type time_point_type;
+
+	struct entry
+	{
+		time_point_type due;
+		size_t order;	// Breaks ties so that packets due at the same time keep their order.
+		std::unique_ptr<packet<T>> packet_p;
+
+		// Orders a heap with the earliest at the front.
+		bool operator<(const entry& other) const
+		{
+			return due != other.due ? due > other.due : order > other.order;
+		}
+	};
+
+	delivery &d_delivery_r;
+
+	std::vector<entry> d_held;	// A min-heap of packets by consumption time.
+	size_t d_order;
+	mutable std::mutex d_held_m;
+
+	flow::detail::counter d_late;
+
+	class timed : public flow::detail::timed
+	{
+		deliverer &d_deliverer_r;
+
+	protected:
+		virtual time_point_type release(const time_point_type& now)
+		{
+			return d_deliverer_r.release(now);
+		}
+
+	public:
+		timed(deliverer& deliverer_r) : d_deliverer_r(deliverer_r) {}
+	} d_timed;
+
+	typename pipe<T>::packets_t d_due;	// Only accessed by the delivery's thread.
+
+	time_point_type release(const time_point_type& now)
+	{
+		time_point_type next;
+		{
+			std::lock_guard<std::mutex> lg(d_held_m);
+
+			while(!d_held.empty() && d_held.front().due <= now)
+			{
+				std::pop_heap(d_held.begin(), d_held.end());
+				d_due.push_back(std::move(d_held.back().packet_p));
+				d_held.pop_back();
+			}
+
+			if(!d_held.empty())
+			{
+				next = d_held.front().due;
+			}
+		}
+
+		producer<T>::output(0).push_n(d_due);
+		d_due.clear();
+
+		return next;
+	}
+
+	// Must be called with d_held_m held. Returns true if the packet is due earlier than all others.
+	bool hold(std::unique_ptr<packet<T>>& packet_p, const time_point_type& now)
+	{
+		time_point_type due = packet_p->consumption_time();
+
+		if(due == time_point_type())
+		{
+			due = now;
+		}
+		else if(due < now)
+		{
+			d_late.add(1);
+			return false;
+		}
+
+		entry e = { due, d_order++, std::move(packet_p) };
+		d_held.push_back(std::move(e));
+		std::push_heap(d_held.begin(), d_held.end());
+
+		return d_held.front().order == d_order - 1;
+	}
+
+public:
+	//! This transformer has only one input and one output.
+	//!
+	//!\param delivery_r The delivery that releases the packets. It must outlive this node.
+	//!\param name_r The name to give this node.
+	deliverer(delivery& delivery_r, const std::string& name_r = "deliverer") : node(name_r), transformer<T, T>(name_r, 1, 1), d_delivery_r(delivery_r), d_order(0), d_timed(*this)
+	{
+		consumer<T>::template batch<deliverer>();
+	}
+
+	virtual ~deliverer()
+	{
+		d_delivery_r.cancel(&d_timed);
+	}
+
+	//!\brief The number of packets discarded because they arrived after their consumption time.
+	virtual size_t late() const
+	{
+		return static_cast<size_t>(d_late.value());
+	}
+
+	//!\brief The number of packets held until their consumption time.
+	virtual size_t pending() const
+	{
+		std::lock_guard<std::mutex> lg(d_held_m);
+		return d_held.size();
+	}
+
+	//!\brief Implementation of node::stopped().
+	virtual void stopped()
+	{
+		d_delivery_r.cancel(&d_timed);
+
+		std::lock_guard<std::mutex> lg(d_held_m);
+		d_held.clear();
+	}
+
+	//!\brief Implementation of consumer::ready().
+	virtual void ready(size_t)
+	{
+		std::unique_ptr<packet<T>> packet_p = consumer<T>::input(0).pop();
+		const time_point_type now = std::chrono::high_resolution_clock::now();
+
+		bool earliest;
+		{
+			std::lock_guard<std::mutex> lg(d_held_m);
+			earliest = hold(packet_p, now);
+		}
+
+		if(earliest)
+		{
+			reschedule();
+		}
+	}
+
+	//!\brief Implementation of consumer::ready_batch().
+	virtual void ready_batch(size_t, typename pipe<T>::packets_t& packets)
+	{
+		const time_point_type now = std::chrono::high_resolution_clock::now();
+
+		bool earliest = false;
+		{
+			std::lock_guard<std::mutex> lg(d_held_m);
+			for(auto& packet_p : packets)
+			{
+				earliest = hold(packet_p, now) || earliest;
+			}
+		}
+
+		if(earliest)
+		{
+			reschedule();
+		}
+	}
+
+private:
+	void reschedule()
+	{
+		time_point_type due;
+		{
+			std::lock_guard<std::mutex> lg(d_held_m);
+			if(d_held.empty()) return;
+
+			due = d_held.front().due;
+		}
+
+		d_delivery_r.schedule(&d_timed, due);
+	}
 };
 
 //!\brief Concrete transformer that adds a delay to a packet's consumption time.
@@ -176,7 +643,10 @@ public:
 	//!\param offset_r The delay to add to the packets' consumption time.
 	//!\param name_r The name to give this node.
 	template<typename Duration>
-	delay(const Duration& offset_r, const std::string& name_r = "delay") : node(name_r), transformer<T, T>(name_r, 1, 1), d_offset(offset_r) {}
+	delay(const Duration& offset_r, const std::string& name_r = "delay") : node(name_r), transformer<T, T>(name_r, 1, 1), d_offset(offset_r)
+	{
+		consumer<T>::template batch<delay>();
+	}
 
 	virtual ~delay() {}
 
@@ -187,16 +657,37 @@ public:
 	{
 		std::unique_ptr<packet<T>> packet_p = consumer<T>::input(0).pop();
 		
-		if(packet_p->consumption_time() == typename packet<T>::time_point_type())
+		postpone(*packet_p, std::chrono::high_resolution_clock::now());
+
+		producer<T>::output(0).push(packet_p);
+	}
+
+	//!\brief Implementation of consumer::ready_batch().
+	//!
+	//! Packets with no set consumption time all get the same consumption time.
+	virtual void ready_batch(size_t, typename pipe<T>::packets_t& packets)
+	{
+		const typename packet<T>::time_point_type now = std::chrono::high_resolution_clock::now();
+
+		for(auto& packet_p : packets)
 		{
-			packet_p->consumption_time() = std::chrono::high_resolution_clock::now() + d_offset;
+			postpone(*packet_p, now);
+		}
+
+		producer<T>::output(0).push_n(packets);
+	}
+
+private:
+	void postpone(packet<T>& packet_r, const typename packet<T>::time_point_type& now)
+	{
+		if(packet_r.consumption_time() == typename packet<T>::time_point_type())
+		{
+			packet_r.consumption_time() = now + d_offset;
 		}
 		else
 		{
-			packet_p->consumption_time() += d_offset;
+			packet_r.consumption_time() += d_offset;
 		}
-
-		producer<T>::output(0).push(packet_p);
 	}
 };
 
@@ -0,0 +1,428 @@
+#if !defined(FLOW_SAMPLES_IO_H)
+	 #define FLOW_SAMPLES_IO_H
+
+#include "node.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FLOW_SAMPLES_IO_MMAP
+#endif
+
+//!\file io.h
+//!
+//!\brief Defines sample concrete node classes that read and write files of fixed-layout records.
+//!
+//! They are meant for replaying large capture files through a graph, no formatting is involved.
+
+//!\namespace flow::samples::io
+//!
+//!\brief Concrete nodes that read and write files.
+namespace flow { namespace samples { namespace io {
+
+//!\cond
+namespace detail
+{
+
+// The contents of a file, memory-mapped where supported and read in memory otherwise.
+class mapping
+{
+	const char *d_data_p;
+	size_t d_size;
+
+#if defined(FLOW_SAMPLES_IO_MMAP)
+	void *d_mapped_p;
+#endif
+	std::vector<char> d_read;
+
+	mapping(const mapping&);
+	mapping& operator=(const mapping&);
+
+public:
+	mapping(const std::string& path_r) : d_data_p(nullptr), d_size(0)
+#if defined(FLOW_SAMPLES_IO_MMAP)
+		, d_mapped_p(MAP_FAILED)
+#endif
+	{
+#if defined(FLOW_SAMPLES_IO_MMAP)
+		const int fd = ::open(path_r.c_str(), O_RDONLY);
+		if(fd == -1) return;
+
+		struct stat s;
+		if(::fstat(fd, &s) == 0 && s.st_size > 0)
+		{
+			d_mapped_p = ::mmap(nullptr, static_cast<size_t>(s.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if(d_mapped_p != MAP_FAILED)
+			{
+				// Records are read once, front to back.
+				::madvise(d_mapped_p, static_cast<size_t>(s.st_size), MADV_SEQUENTIAL);
+
+				d_data_p = static_cast<const char*>(d_mapped_p);
+				d_size = static_cast<size_t>(s.st_size);
+			}
+		}
+
+		::close(fd);
+#else
+		std::ifstream file(path_r.c_str(), std::ios::binary | std::ios::ate);
+		if(!file) return;
+
+		d_read.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		if(!d_read.empty() && file.read(&d_read[0], d_read.size()))
+		{
+			d_data_p = &d_read[0];
+			d_size = d_read.size();
+		}
+#endif
+	}
+
+	~mapping()
+	{
+#if defined(FLOW_SAMPLES_IO_MMAP)
+		if(d_mapped_p != MAP_FAILED)
+		{
+			::munmap(d_mapped_p, d_size);
+		}
+#endif
+	}
+
+	const char* data() const
+	{
+		return d_data_p;
+	}
+
+	size_t size() const
+	{
+		return d_size;
+	}
+};
+
+}
+//!\endcond
+
+//!\brief A range of records that lives in a memory-mapped file.
+//!
+//! Copying a range does not copy the records, it only shares the mapping, which stays valid as long as any range refers to it.
+//!
+//!\tparam R The type of record. It must be trivially copyable and laid out in the file exactly as in memory.
+template<typename R>
+class records
+{
+	std::shared_ptr<const detail::mapping> d_mapping_sp;
+	const R *d_begin_p;
+	size_t d_size;
+
+public:
+	typedef const R* const_iterator;
+
+	records() : d_begin_p(nullptr), d_size(0) {}
+
+	//!\param mapping_sp The mapping the records are in.
+	//!\param begin_p The first record.
+	//!\param size The number of records.
+	records(const std::shared_ptr<const detail::mapping>& mapping_sp, const R* begin_p, const size_t size) : d_mapping_sp(mapping_sp), d_begin_p(begin_p), d_size(size) {}
+
+	//!\brief The number of records.
+	size_t size() const
+	{
+		return d_size;
+	}
+
+	//!\brief Whether there are no records.
+	bool empty() const
+	{
+		return d_size == 0;
+	}
+
+	//!\brief The record at index \c i.
+	const R& operator[](const size_t i) const
+	{
+		return d_begin_p[i];
+	}
+
+	//!\brief The first record.
+	const R* data() const
+	{
+		return d_begin_p;
+	}
+
+	const_iterator begin() const
+	{
+		return d_begin_p;
+	}
+
+	const_iterator end() const
+	{
+		return d_begin_p + d_size;
+	}
+};
+
+//!\cond
+namespace detail
+{
+
+// The bytes of a record.
+template<typename T>
+inline void append(std::vector<char>& buffer_r, const T& t)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "records must be trivially copyable");
+
+	const char *p = reinterpret_cast<const char*>(&t);
+	buffer_r.insert(buffer_r.end(), p, p + sizeof(T));
+}
+
+// The bytes of a range of records, as they are in the mapped file.
+template<typename R>
+inline void append(std::vector<char>& buffer_r, const records<R>& r)
+{
+	const char *p = reinterpret_cast<const char*>(r.data());
+	buffer_r.insert(buffer_r.end(), p, p + r.size() * sizeof(R));
+}
+
+}
+//!\endcond
+
+//!\brief Concrete producer that hands out the records of a file, without copying them.
+//!
+//! The file is memory-mapped and every packet carries a \ref records range that points into the mapping.
+//! Only packets are allocated, the records themselves are paged in from the file as they are read.
+//! Once all records were produced, the node only sleeps until rewound, callers may pause it once \ref remaining returns 0.
+//!
+//! Trailing bytes that do not make up a whole record are ignored.
+//!
+//!\tparam R The type of record. It must be trivially copyable and laid out in the file exactly as in memory.
+template<typename R>
+class mapped_source : public producer<records<R>>
+{
+	std::shared_ptr<const detail::mapping> d_mapping_sp;
+	const size_t d_records_per_packet;
+
+	size_t d_next;	// Index of the next record to produce.
+
+public:
+	//! This producer has only one output.
+	//!
+	//!\param path_r The path of the file to read.
+	//!\param records_per_packet The maximum number of records carried by one packet.
+	//!\param name_r The name to give this node.
+	mapped_source(const std::string& path_r, const size_t records_per_packet = 1024, const std::string& name_r = "mapped_source") :
+		 node(name_r), producer<records<R>>(name_r, 1), d_mapping_sp(std::make_shared<detail::mapping>(path_r)), d_records_per_packet(records_per_packet ? records_per_packet : 1), d_next(0)
+	{
+		static_assert(std::is_trivially_copyable<R>::value, "records must be trivially copyable");
+	}
+
+	virtual ~mapped_source() {}
+
+	//!\brief Whether the file could be opened and mapped. An empty file cannot be mapped.
+	virtual bool is_open() const
+	{
+		return d_mapping_sp->data() != nullptr;
+	}
+
+	//!\brief The number of whole records in the file.
+	virtual size_t size() const
+	{
+		return d_mapping_sp->size() / sizeof(R);
+	}
+
+	//!\brief The number of records not produced yet.
+	virtual size_t remaining() const
+	{
+		return size() - d_next;
+	}
+
+	//!\brief Starts over from the first record.
+	//!
+	//! Must not be called while the node is started.
+	virtual void rewind()
+	{
+		d_next = 0;
+	}
+
+	//!\brief Implementation of producer::produce().
+	//!
+	//! Pushes a packet with the next \c records_per_packet records, fewer for the last one.
+	//! When none are left, it sleeps for a millisecond rather than spin.
+	virtual void produce()
+	{
+		const size_t n = std::min(d_records_per_packet, remaining());
+
+		if(!n)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			return;
+		}
+
+		const R *begin_p = reinterpret_cast<const R*>(d_mapping_sp->data()) + d_next;
+		d_next += n;
+
+		std::unique_ptr<packet<records<R>>> packet_p(producer<records<R>>::make_packet(records<R>(d_mapping_sp, begin_p, n)));
+		producer<records<R>>::output(0).push(packet_p);
+	}
+};
+
+//!\brief Concrete consumer that writes the raw bytes of the data it receives to a file.
+//!
+//! Bytes are gathered in a buffer and written to the file in large blocks, the file is never flushed for a single packet.
+//! The buffer is written out when full, when the node is paused or stopped, when flush() is called and when the node is destroyed.
+//!
+//! Writing the \ref records produced by a \ref mapped_source copies them straight from the mapping to the buffer.
+//!
+//!\tparam T The type of data, either a trivially copyable record or \ref records of them.
+template<typename T>
+class file_sink : public consumer<T>
+{
+	std::ofstream d_file;
+
+	std::vector<char> d_buffer;
+	const size_t d_buffer_size;
+	std::mutex d_buffer_m;		// The buffer is flushed from the graph's thread when the node is paused and stopped.
+
+	size_t d_written;	// Bytes written to the file so far.
+
+	void write()
+	{
+		if(!d_buffer.empty())
+		{
+			d_file.write(&d_buffer[0], d_buffer.size());
+			d_written += d_buffer.size();
+			d_buffer.clear();
+		}
+	}
+
+public:
+	//! This consumer has only one input.
+	//!
+	//!\param path_r The path of the file to write. It is truncated.
+	//!\param buffer_size The number of bytes to gather before writing them out.
+	//!\param name_r The name to give this node.
+	file_sink(const std::string& path_r, const size_t buffer_size = 1 << 20, const std::string& name_r = "file_sink") :
+		 node(name_r), consumer<T>(name_r, 1), d_file(path_r.c_str(), std::ios::binary | std::ios::trunc), d_buffer_size(buffer_size), d_written(0)
+	{
+		d_buffer.reserve(d_buffer_size);
+
+		consumer<T>::template batch<file_sink>();
+	}
+
+	//!\brief Writes out whatever is left in the buffer.
+	virtual ~file_sink()
+	{
+		flush();
+	}
+
+	//!\brief Whether the file could be opened and all writes succeeded so far.
+	virtual bool good()
+	{
+		std::lock_guard<std::mutex> lg(d_buffer_m);
+		return d_file.good();
+	}
+
+	//!\brief The number of bytes written to the file so far, not counting the bytes still in the buffer.
+	virtual size_t written()
+	{
+		std::lock_guard<std::mutex> lg(d_buffer_m);
+		return d_written;
+	}
+
+	//!\brief Writes the buffer out and flushes the file.
+	virtual void flush()
+	{
+		std::lock_guard<std::mutex> lg(d_buffer_m);
+		write();
+		d_file.flush();
+	}
+
+	//!\brief Implementation of node::paused().
+	virtual void paused()
+	{
+		flush();
+	}
+
+	//!\brief Implementation of node::stopped().
+	virtual void stopped()
+	{
+		flush();
+	}
+
+	//!\brief Implementation of consumer::ready().
+	virtual void ready(size_t)
+	{
+		std::unique_ptr<packet<T>> packet_p = consumer<T>::input(0).pop();
+
+		if(!packet_p)
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lg(d_buffer_m);
+		detail::append(d_buffer, packet_p->data());
+		if(d_buffer.size() >= d_buffer_size)
+		{
+			write();
+		}
+	}
+
+	//!\brief Implementation of consumer::ready_batch().
+	virtual void ready_batch(size_t, typename pipe<T>::packets_t& packets)
+	{
+		std::lock_guard<std::mutex> lg(d_buffer_m);
+		for(auto& packet_p : packets)
+		{
+			detail::append(d_buffer, packet_p->data());
+			if(d_buffer.size() >= d_buffer_size)
+			{
+				write();
+			}
+		}
+	}
+};
+
+}}}
+
+#if defined(FLOW_SAMPLES_IO_MMAP)
+#undef FLOW_SAMPLES_IO_MMAP
+#endif
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
@@ -1,71 +1,72 @@
 #if !defined(FLOW_MATH_H)
 	 #define FLOW_MATH_H
 
+#include "batch.h"
+#include "join.h"
 #include "node.h"
 
 #include <algorithm>
 #include <memory>
+#include <numeric>
 #include <utility>
 #include <vector>
 
 //!\file math.h
 //!
 //!\brief Defines sample concrete node classes that perform mathematical operations on their inputs.
+//!
+//! All of them work on \ref flow::batch "batches" of values as well as on single values.
 
 //!\namespace flow::samples::math
 //!
 //!\brief Concrete nodes that perform mathematical operations on their inputs.
 namespace flow { namespace samples { namespace math {
 
+//!\cond
+namespace detail
+{
+
+// The sum of the values of a container.
+template<typename C>
+typename C::value_type total(const C& c)
+{
+	return std::accumulate(c.begin(), c.end(), typename C::value_type());
+}
+
+template<typename T, size_t N>
+T total(const batch<T, N>& b)
+{
+	return b.sum();
+}
+
+}
+//!\endcond
+
 //!\brief Concrete transformer that uses operator+= to sum input packets.
 template<typename T>
-class adder : public transformer<T, T>
+class adder : public join<T, T>
 {
 public:
 	//!\brief Default constructor with two inputs.
 	//!
 	//!\param ins The number of inputs.
 	//!\param name_r The name to give this node.
-	adder(size_t ins = 2, const std::string& name_r = "adder") : node(name_r), transformer<T, T>(name_r, ins, 1) {}
+	//!\param a How packets are matched across inputs.
+	adder(size_t ins = 2, const std::string& name_r = "adder", const alignment::type a = alignment::arrival) : node(name_r), join<T, T>(name_r, ins, 1, a) {}
 
 	virtual ~adder() {}
 
-	//!\brief Implementation of consumer::ready().
+	//!\brief Implementation of join::joined().
 	//!
-	//! When at least one packet is ready at each inputs, one packet from each input is popped.
-	//! They are then all summed and the sum is moved to the output.
-	virtual void ready(size_t n)
+	//! The packets are all summed and the sum is moved to the output, in the packet popped from the first input.
+	virtual void joined(typename join<T, T>::set_t& terms)
 	{
-		// Check that a packet is ready at all inputs. If not, return and try again when another packet arrives.
-		for(size_t i = 0; i != consumer<T>::ins(); ++i)
-		{
-			if(!consumer<T>::input(i).peek())
-			{
-				return;
-			}
-		}
-
-		// Gather the terms in a container.
-		std::vector<std::unique_ptr<packet<T>>> terms;
-
-		for(auto& inpin : consumer<T>::inputs())
-		{
-			terms.emplace_back(move(inpin.pop()));
-		}
-
-		// Start the sum as equal to the first term.
-		T sum(terms[0]->data());
-
-		// Add to the sum the value of all other packets.
-		std::for_each(terms.begin() + 1, terms.end(), [&sum](const std::unique_ptr<packet<T>>& packet_up_r){
-			sum += packet_up_r->data();
+		// The first packet carries the sum.
+		std::for_each(terms.begin() + 1, terms.end(), [&terms](const std::unique_ptr<packet<T>>& packet_up_r){
+			terms[0]->data() += packet_up_r->data();
 		});
 
-		// Make a packet with the sum data.
-		std::unique_ptr<packet<T>> sum_up(new packet<T>(sum));
-
-		// Output it.
-		producer<T>::output(0).push(sum_up);
+		producer<T>::output(0).push(terms[0]);
 	}
 };
 
@@ -78,7 +79,10 @@ class const_adder : public transformer<T, T>
 public:
 	//!\param addend The constan value to add to input packets.
 	//!\param name_r The name to give to this node.
-	const_adder(const T& addend, const std::string& name_r = "const_adder") : node(name_r), transformer<T, T>(name_r, 1, 1), d_addend(addend) {}
+	const_adder(const T& addend, const std::string& name_r = "const_adder") : node(name_r), transformer<T, T>(name_r, 1, 1), d_addend(addend)
+	{
+		consumer<T>::template batch<const_adder>();
+	}
 
 	virtual ~const_adder() {}
 
@@ -91,6 +95,129 @@ public:
 
 		producer<T>::output(0).push(packet_p);
 	}
+
+	//!\brief Implementation of consumer::ready_batch().
+	virtual void ready_batch(size_t, typename pipe<T>::packets_t& packets)
+	{
+		for(auto& packet_p : packets)
+		{
+			packet_p->data() += d_addend;
+		}
+
+		producer<T>::output(0).push_n(packets);
+	}
+};
+
+//!\brief Concrete transformer that uses operator*= to multiply input packets.
+template<typename T>
+class multiplier : public join<T, T>
+{
+public:
+	//!\brief Default constructor with two inputs.
+	//!
+	//!\param ins The number of inputs.
+	//!\param name_r The name to give this node.
+	//!\param a How packets are matched across inputs.
+	multiplier(size_t ins = 2, const std::string& name_r = "multiplier", const alignment::type a = alignment::arrival) : node(name_r), join<T, T>(name_r, ins, 1, a) {}
+
+	virtual ~multiplier() {}
+
+	//!\brief Implementation of join::joined().
+	//!
+	//! The packets are all multiplied and the product is moved to the output, in the packet popped from the first input.
+	virtual void joined(typename join<T, T>::set_t& factors)
+	{
+		// The first packet carries the product.
+		for(size_t i = 1; i != factors.size(); ++i)
+		{
+			factors[0]->data() *= factors[i]->data();
+		}
+
+		producer<T>::output(0).push(factors[0]);
+	}
+};
+
+//!\brief Concrete transformer that uses operator*= to multiply input packets by a constant factor.
+//!
+//!\tparam T The type of data.
+//!\tparam F The type of the factor, e.g. the type of values for \ref flow::batch "batches".
+template<typename T, typename F = T>
+class scaler : public transformer<T, T>
+{
+	const F d_factor;
+
+public:
+	//!\param factor The constant value by which to multiply input packets.
+	//!\param name_r The name to give to this node.
+	scaler(const F& factor, const std::string& name_r = "scaler") : node(name_r), transformer<T, T>(name_r, 1, 1), d_factor(factor)
+	{
+		consumer<T>::template batch<scaler>();
+	}
+
+	virtual ~scaler() {}
+
+	//!\brief Implementation of consumer::ready().
+	virtual void ready(size_t)
+	{
+		std::unique_ptr<packet<T>> packet_p = consumer<T>::input(0).pop();
+
+		packet_p->data() *= d_factor;
+
+		producer<T>::output(0).push(packet_p);
+	}
+
+	//!\brief Implementation of consumer::ready_batch().
+	virtual void ready_batch(size_t, typename pipe<T>::packets_t& packets)
+	{
+		for(auto& packet_p : packets)
+		{
+			packet_p->data() *= d_factor;
+		}
+
+		producer<T>::output(0).push_n(packets);
+	}
+};
+
+//!\brief Concrete transformer that reduces input packets to the sum of the values they hold.
+//!
+//! Works with \ref flow::batch "batches" and with any container of values.
+//!
+//!\tparam T The type of data consumed, a container of values.
+template<typename T>
+class reducer : public transformer<T, typename T::value_type>
+{
+	typedef typename T::value_type V;
+
+	typename pipe<V>::packets_t d_sums;
+
+public:
+	//!\param name_r The name to give to this node.
+	reducer(const std::string& name_r = "reducer") : node(name_r), transformer<T, V>(name_r, 1, 1)
+	{
+		consumer<T>::template batch<reducer>();
+	}
+
+	virtual ~reducer() {}
+
+	//!\brief Implementation of consumer::ready().
+	virtual void ready(size_t)
+	{
+		std::unique_ptr<packet<V>> sum_p(producer<V>::make_packet(detail::total(consumer<T>::input(0).pop()->data())));
+
+		producer<V>::output(0).push(sum_p);
+	}
+
+	//!\brief Implementation of consumer::ready_batch().
+	virtual void ready_batch(size_t, typename pipe<T>::packets_t& packets)
+	{
+		for(auto& packet_p : packets)
+		{
+			d_sums.push_back(producer<V>::make_packet(detail::total(packet_p->data())));
+		}
+
+		producer<V>::output(0).push_n(d_sums);
+		d_sums.clear();
+	}
 };
 
 }}}
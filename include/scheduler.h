@@ -0,0 +1,288 @@
+#if !defined(FLOW_SCHEDULER_H)
+	 #define FLOW_SCHEDULER_H
+
+#include "affinity.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//!\file scheduler.h
+//!
+//!\brief Defines the \ref flow::scheduler class.
+
+namespace flow
+{
+
+class scheduler;
+
+//!\cond
+namespace detail
+{
+
+// A unit of work that can be queued on a scheduler. Nodes are tasks.
+class task
+{
+	std::atomic<bool> d_scheduled_a;	// True from the time the task is queued until it has run.
+
+	friend class flow::scheduler;
+
+protected:
+	// Performs a bounded amount of work. Must not block.
+	virtual void step() = 0;
+
+	// Whether the task has work to do and should be queued again.
+	virtual bool runnable() = 0;
+
+public:
+	task() : d_scheduled_a(false) {}
+
+	virtual ~task() {}
+
+	// Whether the task is queued or running.
+	bool scheduled() const
+	{
+		return d_scheduled_a;
+	}
+};
+
+}
+//!\endcond
+
+//!\brief A fixed-size pool of threads that run nodes as tasks.
+//!
+//! Every thread of the pool has its own queue of tasks.
+//! A task queued from one of the pool's threads goes to that thread's queue, keeping data hot in its cache.
+//! Threads that run out of tasks steal from the other queues before going to sleep.
+//! A task is never queued twice, so a node never runs on two threads at once.
+class scheduler
+{
+	struct worker
+	{
+		std::deque<detail::task*> tasks;
+		std::mutex m;
+	};
+
+	std::vector<std::unique_ptr<worker>> d_workers;
+	std::vector<std::thread> d_threads;
+
+	std::atomic<size_t> d_pending_a;	// Number of tasks in all queues.
+	std::atomic<size_t> d_sleeping_a;	// Number of threads waiting for tasks.
+	std::atomic<size_t> d_next_a;		// Next queue for tasks queued from outside the pool.
+	std::atomic<bool> d_stop_a;
+
+	std::condition_variable d_idle_cv;
+	std::mutex d_idle_m;
+
+	scheduler(const scheduler&);
+	scheduler& operator=(const scheduler&);
+
+	// The index of the calling thread's worker in the pool, or the number of workers if the calling thread is not from this pool.
+	size_t current() const
+	{
+		const std::thread::id id = std::this_thread::get_id();
+
+		for(size_t i = 0; i != d_threads.size(); ++i)
+		{
+			if(d_threads[i].get_id() == id)
+			{
+				return i;
+			}
+		}
+
+		return d_workers.size();
+	}
+
+	void enqueue(detail::task *task_p, size_t w)
+	{
+		if(w == d_workers.size())
+		{
+			w = d_next_a.fetch_add(1, std::memory_order_relaxed) % d_workers.size();
+		}
+
+		{
+			std::lock_guard<std::mutex> lg(d_workers[w]->m);
+			d_workers[w]->tasks.push_back(task_p);
+		}
+
+		d_pending_a.fetch_add(1);
+
+		if(d_sleeping_a.load())
+		{
+			std::lock_guard<std::mutex> lg(d_idle_m);
+			d_idle_cv.notify_one();
+		}
+	}
+
+	// Takes the oldest task of a thread's own queue or steals the newest task of another queue.
+	detail::task* dequeue(const size_t w)
+	{
+		for(size_t i = 0; i != d_workers.size(); ++i)
+		{
+			worker &victim = *d_workers[(w + i) % d_workers.size()];
+
+			std::lock_guard<std::mutex> lg(victim.m);
+			if(!victim.tasks.empty())
+			{
+				detail::task *task_p;
+
+				if(i == 0)
+				{
+					task_p = victim.tasks.front();
+					victim.tasks.pop_front();
+				}
+				else
+				{
+					task_p = victim.tasks.back();
+					victim.tasks.pop_back();
+				}
+
+				d_pending_a.fetch_sub(1);
+
+				return task_p;
+			}
+		}
+
+		return nullptr;
+	}
+
+	void run(const size_t w)
+	{
+		while(true)
+		{
+			detail::task *task_p = dequeue(w);
+
+			if(task_p)
+			{
+				task_p->step();
+
+				task_p->d_scheduled_a.store(false);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+
+				// Work may have arrived while the task was running. Whoever wanted to queue it then saw it was still scheduled.
+				if(task_p->runnable())
+				{
+					schedule(task_p);
+				}
+			}
+			else
+			{
+				std::unique_lock<std::mutex> ul(d_idle_m);
+
+				++d_sleeping_a;
+				d_idle_cv.wait(ul, [this](){ return d_stop_a || d_pending_a; });
+				--d_sleeping_a;
+
+				if(d_stop_a)
+				{
+					return;
+				}
+			}
+		}
+	}
+
+public:
+	//!\param threads The number of threads in the pool. Do not set or set to 0 for as many threads as there are cores.
+	scheduler(size_t threads = 0) : d_pending_a(0), d_sleeping_a(0), d_next_a(0), d_stop_a(false)
+	{
+		if(!threads)
+		{
+			threads = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		for(size_t i = 0; i != threads; ++i)
+		{
+			d_workers.push_back(std::unique_ptr<worker>(new worker));
+		}
+
+		std::lock_guard<std::mutex> lg(d_idle_m);	// Keep the workers from looking up their own thread before d_threads is filled.
+		for(size_t i = 0; i != threads; ++i)
+		{
+			d_threads.push_back(std::thread([this, i]{ this->run(i); }));
+		}
+	}
+
+	//!\brief Joins all threads of the pool.
+	//!
+	//! Tasks still queued are not run.
+	virtual ~scheduler()
+	{
+		{
+			std::lock_guard<std::mutex> lg(d_idle_m);
+			d_stop_a = true;
+			d_idle_cv.notify_all();
+		}
+
+		for(auto& thread : d_threads)
+		{
+			thread.join();
+		}
+	}
+
+	//!\brief The number of threads in the pool.
+	virtual size_t threads() const
+	{
+		return d_threads.size();
+	}
+
+	//!\brief Restricts one of the threads of the pool to run on a set of CPUs.
+	//!
+	//! Tasks queued from a thread stay on that thread's queue unless stolen,
+	//! so pinning threads keeps the nodes that feed one another close to one another.
+	//!
+	//!\param thread The index of the thread in the pool.
+	//!\param cpus The CPUs the thread may run on. An empty set allows all CPUs.
+	//!\return \c false if there is no such thread or if it could not be pinned.
+	virtual bool pin(const size_t thread, const cpus_t& cpus)
+	{
+		return thread < d_threads.size() && flow::pin_thread(d_threads[thread], cpus);
+	}
+
+	//!\brief Queues a task, unless it is already queued or running.
+	void schedule(detail::task *task_p)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if(!task_p->d_scheduled_a.exchange(true))
+		{
+			enqueue(task_p, current());
+		}
+	}
+};
+
+}
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,107 @@
+#if !defined(FLOW_SHARED_H)
+	 #define FLOW_SHARED_H
+
+#include "packet.h"
+
+#include <memory>
+#include <utility>
+
+//!\file shared.h
+//!
+//!\brief Defines the \ref flow::shared class.
+
+namespace flow
+{
+
+//!\brief A payload shared by many packets and copied only when it is modified.
+//!
+//! Copying a packet<shared<T>> does not copy the T it carries, it only adds a reference to it.
+//! Broadcasting nodes like \ref flow::samples::generic::tee "tee" therefore hand out the same buffer to all of their outputs.
+//! A node that needs to modify the payload calls write(), which copies the T first if it is still shared with other packets.
+//!
+//! The reference count is thread-safe, the T itself is never modified while shared.
+//!
+//!\tparam T The type of the payload.
+template<typename T>
+class shared
+{
+	std::shared_ptr<T> d_sp;
+
+public:
+	//!\param t The payload.
+	shared(T t = T()) : d_sp(std::make_shared<T>(std::move(t))) {}
+
+	//!\brief Read-only access to the payload.
+	const T& read() const
+	{
+		return *d_sp;
+	}
+
+	//!\brief Read-only access to the payload.
+	operator const T&() const
+	{
+		return *d_sp;
+	}
+
+	//!\brief Read-write access to the payload.
+	//!
+	//! If other packets share this payload, it is copied first so that they are unaffected.
+	T& write()
+	{
+		if(!unique())
+		{
+			d_sp = std::make_shared<T>(*d_sp);
+		}
+
+		return *d_sp;
+	}
+
+	//!\brief Whether no other packet shares this payload.
+	bool unique() const
+	{
+		return d_sp.use_count() == 1;
+	}
+};
+
+//!\brief The weight of a shared payload is the weight of the payload, even though it may be shared with other packets.
+template<typename T>
+struct weight<shared<T>>
+{
+	//!\brief The weight of \c s.
+	static size_t of(const shared<T>& s)
+	{
+		return sizeof(s) + weight<T>::of(s.read());
+	}
+};
+
+}
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,681 @@
+#if !defined(FLOW_SHM_H)
+	 #define FLOW_SHM_H
+
+#include "node.h"
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+//!\brief Defined when shared-memory rings are available, i.e. on POSIX systems.
+#define FLOW_SHM_SUPPORTED
+#endif
+
+//!\file shm.h
+//!
+//!\brief Defines the \ref flow::shm_ring class and the nodes that connect graphs of different processes through it.
+
+namespace flow
+{
+
+//!\namespace flow::shm_end
+//!
+//!\brief Contains the ends of a shared-memory ring.
+namespace shm_end
+{
+
+//!\enum type
+//!
+//!\brief The end of a \ref flow::shm_ring "shm_ring" a process holds.
+enum type
+{
+	writer,	//!< The end records are pushed to. Only one process may hold it.
+	reader	//!< The end records are popped from. Only one process may hold it.
+};
+
+}
+
+#if defined(FLOW_SHM_SUPPORTED)
+
+//!\cond
+namespace detail
+{
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be plain 32-bit integers");
+
+// Waits until a word in shared memory no longer holds a value, is woken or the timeout elapses.
+// Where futexes are not available, it sleeps briefly instead and the caller polls.
+inline void shm_wait(std::atomic<uint32_t>& word_r, const uint32_t expected, const std::chrono::microseconds& timeout)
+{
+#if defined(__linux__)
+	timespec ts;
+	ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000);
+	ts.tv_nsec = static_cast<long>(timeout.count() % 1000000) * 1000;
+
+	::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word_r), FUTEX_WAIT, expected, &ts, nullptr, 0);
+#else
+	if(word_r.load() == expected)
+	{
+		std::this_thread::sleep_for(std::min(timeout, std::chrono::microseconds(100)));
+	}
+#endif
+}
+
+// Wakes the processes waiting on a word in shared memory.
+inline void shm_wake(std::atomic<uint32_t>& word_r)
+{
+#if defined(__linux__)
+	::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word_r), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+	(void)word_r;
+#endif
+}
+
+// An index of the ring alone on its cache line, with the counter the opposite end waits on.
+struct shm_index
+{
+	std::atomic<uint64_t> value;
+	std::atomic<uint32_t> sequence;	// Bumped after value changes while the opposite end waits. The futex word.
+	std::atomic<uint32_t> waiting;	// Set while the opposite end waits for value to change.
+
+	char padding[cache_line_size - sizeof(std::atomic<uint64_t>) - 2 * sizeof(std::atomic<uint32_t>)];
+};
+
+// The start of a segment. The slots of the ring follow it.
+struct shm_header
+{
+	static const uint32_t magic = 0x666c6f77;	// "flow"
+
+	std::atomic<uint32_t> ready;	// Set to magic once the creator has initialized the segment.
+	uint32_t record_size;
+	uint64_t capacity;				// A power of two.
+
+	std::atomic<uint32_t> attached;	// The number of ends holding the segment.
+	std::atomic<uint32_t> ends;		// One bit for each end that ever attached.
+
+	char padding[cache_line_size - 3 * sizeof(uint32_t) - sizeof(uint64_t) - sizeof(std::atomic<uint32_t>)];
+
+	shm_index head;	// Written by the writer.
+	shm_index tail;	// Written by the reader.
+};
+
+}
+//!\endcond
+
+//!\brief A single-producer single-consumer ring of records that lives in a named shared-memory segment.
+//!
+//! One process opens the writer end and another opens the reader end under the same name, in either order.
+//! Whichever comes first creates and sizes the segment, the other attaches to it.
+//! Records are copied straight into the slots of the segment: there is no serialization, no system call and no lock
+//! unless one end has to wait for the other, in which case it sleeps on a futex where available.
+//!
+//! The segment is unlinked once both ends have attached and then detached.
+//! Records pushed before the reader attaches stay in the segment until it does.
+//!
+//!\tparam T The type of record. It must be trivially copyable, as it is copied byte for byte between address spaces.
+template<typename T>
+class shm_ring
+{
+	static_assert(std::is_trivially_copyable<T>::value, "records carried across processes must be trivially copyable");
+
+	const std::string d_name;
+	const shm_end::type d_end;
+
+	detail::shm_header *d_header_p;
+	T *d_slots_p;
+	size_t d_size;		// The size of the mapping in bytes.
+	uint64_t d_mask;
+
+	uint64_t d_cached;	// Last value read of the opposite index.
+
+	shm_ring(const shm_ring&);
+	shm_ring& operator=(const shm_ring&);
+
+	// Smallest power of two greater than or equal to n.
+	static uint64_t round_up(const size_t n)
+	{
+		uint64_t r = 1;
+		while(r < n)
+		{
+			r <<= 1;
+		}
+
+		return r;
+	}
+
+	static size_t segment_size(const uint64_t capacity)
+	{
+		return sizeof(detail::shm_header) + static_cast<size_t>(capacity) * sizeof(T);
+	}
+
+	bool map(const int fd, const size_t size)
+	{
+		void *p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if(p == MAP_FAILED)
+		{
+			return false;
+		}
+
+		d_header_p = static_cast<detail::shm_header*>(p);
+		d_size = size;
+
+		return true;
+	}
+
+	// Creates and initializes the segment, or attaches to the one created by the other end.
+	void open(const size_t capacity)
+	{
+		int fd = ::shm_open(d_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		if(fd != -1)
+		{
+			const uint64_t c = round_up(capacity ? capacity : default_capacity);
+
+			if(::ftruncate(fd, static_cast<off_t>(segment_size(c))) == 0 && map(fd, segment_size(c)))
+			{
+				// The new segment is zero-filled, which leaves the indices at 0.
+				d_header_p->record_size = static_cast<uint32_t>(sizeof(T));
+				d_header_p->capacity = c;
+				d_header_p->ready.store(detail::shm_header::magic, std::memory_order_release);
+			}
+
+			::close(fd);
+		}
+		else if((fd = ::shm_open(d_name.c_str(), O_RDWR, 0600)) != -1)
+		{
+			// Give the creator a moment to size and initialize it.
+			struct stat s;
+			for(int i = 0; i != 1000 && ::fstat(fd, &s) == 0 && static_cast<size_t>(s.st_size) < sizeof(detail::shm_header); ++i)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+
+			if(::fstat(fd, &s) == 0 && static_cast<size_t>(s.st_size) >= sizeof(detail::shm_header) && map(fd, static_cast<size_t>(s.st_size)))
+			{
+				for(int i = 0; i != 1000 && d_header_p->ready.load(std::memory_order_acquire) != detail::shm_header::magic; ++i)
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+
+				if(d_header_p->ready.load(std::memory_order_acquire) != detail::shm_header::magic ||
+				   d_header_p->record_size != sizeof(T) || d_size < segment_size(d_header_p->capacity))
+				{
+					::munmap(d_header_p, d_size);
+					d_header_p = nullptr;
+				}
+			}
+
+			::close(fd);
+		}
+
+		if(!d_header_p)
+		{
+			return;
+		}
+
+		d_slots_p = reinterpret_cast<T*>(d_header_p + 1);
+		d_mask = d_header_p->capacity - 1;
+
+		d_header_p->attached.fetch_add(1);
+		d_header_p->ends.fetch_or(1u << d_end);
+
+		d_cached = d_end == shm_end::writer ? d_header_p->tail.value.load(std::memory_order_acquire) : d_header_p->head.value.load(std::memory_order_acquire);
+	}
+
+	// Waits for the opposite index to move past an expected value.
+	// Returns false if it still has not when the timeout elapses.
+	template<typename Rep, typename Period>
+	bool await(detail::shm_index& index_r, const uint64_t expected, const std::chrono::duration<Rep, Period>& timeout)
+	{
+		const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+
+		while(true)
+		{
+			const uint32_t ticket = index_r.sequence.load(std::memory_order_acquire);
+
+			index_r.waiting.store(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			if((d_cached = index_r.value.load(std::memory_order_acquire)) != expected)
+			{
+				break;
+			}
+
+			const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			if(now >= deadline)
+			{
+				break;
+			}
+
+			detail::shm_wait(index_r.sequence, ticket, std::chrono::duration_cast<std::chrono::microseconds>(deadline - now) + std::chrono::microseconds(1));
+		}
+
+		index_r.waiting.store(0, std::memory_order_relaxed);
+
+		return d_cached != expected;
+	}
+
+	// Publishes a new value of this end's index and wakes the opposite end if it waits for it.
+	static void publish(detail::shm_index& index_r, const uint64_t value)
+	{
+		index_r.value.store(value, std::memory_order_release);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if(index_r.waiting.load(std::memory_order_relaxed))
+		{
+			index_r.sequence.fetch_add(1, std::memory_order_release);
+			detail::shm_wake(index_r.sequence);
+		}
+	}
+
+public:
+	//!\brief The capacity given to the segment when none is specified.
+	static const size_t default_capacity = 1024;
+
+	//!\param name_r The name of the segment, starting with a slash, e.g. "/ticks".
+	//!\param end Which end of the ring this process holds.
+	//!\param capacity The number of records the ring holds, rounded up to a power of two.
+	//! Only used by the end that creates the segment. Do not set or set to 0 for \ref default_capacity.
+	shm_ring(const std::string& name_r, const shm_end::type end, const size_t capacity = default_capacity)
+		: d_name(name_r), d_end(end), d_header_p(nullptr), d_slots_p(nullptr), d_size(0), d_mask(0), d_cached(0)
+	{
+		open(capacity);
+	}
+
+	//!\brief Detaches from the segment, unlinking it if both ends have come and gone.
+	virtual ~shm_ring()
+	{
+		if(d_header_p)
+		{
+			const bool both = d_header_p->ends.load() == ((1u << shm_end::writer) | (1u << shm_end::reader));
+			const bool last = d_header_p->attached.fetch_sub(1) == 1;
+
+			::munmap(d_header_p, d_size);
+
+			if(both && last)
+			{
+				::shm_unlink(d_name.c_str());
+			}
+		}
+	}
+
+	//!\brief Removes a segment, e.g. one left behind by a process that did not detach.
+	//!
+	//! Processes that still have it mapped keep using it.
+	static bool unlink(const std::string& name_r)
+	{
+		return ::shm_unlink(name_r.c_str()) == 0;
+	}
+
+	//!\brief The name of the segment.
+	virtual const std::string& name() const
+	{
+		return d_name;
+	}
+
+	//!\brief Whether the segment could be opened and mapped and holds records of the right size.
+	virtual bool is_open() const
+	{
+		return d_header_p != nullptr;
+	}
+
+	//!\brief The number of records the ring holds.
+	virtual size_t capacity() const
+	{
+		return d_header_p ? static_cast<size_t>(d_header_p->capacity) : 0;
+	}
+
+	//!\brief The number of records in the ring.
+	virtual size_t length() const
+	{
+		if(!d_header_p) return 0;
+
+		const uint64_t tail = d_header_p->tail.value.load(std::memory_order_acquire);
+		return static_cast<size_t>(d_header_p->head.value.load(std::memory_order_acquire) - tail);
+	}
+
+	//!\brief Whether the reader end was ever attached.
+	virtual bool connected() const
+	{
+		return d_header_p && (d_header_p->ends.load() & (1u << shm_end::reader));
+	}
+
+	//!\brief Copies a record to the ring.
+	//!
+	//! Must only be called from the writer end.
+	//!
+	//!\param t The record.
+	//!\param timeout How long to wait for room if the ring is full.
+	//!
+	//!\return \c false if the ring is not open or was still full when the timeout elapsed.
+	template<typename Rep, typename Period>
+	bool push(const T& t, const std::chrono::duration<Rep, Period>& timeout)
+	{
+		if(!d_header_p) return false;
+
+		const uint64_t head = d_header_p->head.value.load(std::memory_order_relaxed);
+
+		if(head - d_cached > d_mask)
+		{
+			d_cached = d_header_p->tail.value.load(std::memory_order_acquire);
+
+			if(head - d_cached > d_mask && !await(d_header_p->tail, d_cached, timeout))
+			{
+				return false;
+			}
+		}
+
+		std::memcpy(static_cast<void*>(d_slots_p + (head & d_mask)), &t, sizeof(T));
+		publish(d_header_p->head, head + 1);
+
+		return true;
+	}
+
+	//!\brief Copies a record to the ring if there is room.
+	//!
+	//! Must only be called from the writer end.
+	bool push(const T& t)
+	{
+		return push(t, std::chrono::microseconds(0));
+	}
+
+	//!\brief Copies the oldest record out of the ring.
+	//!
+	//! Must only be called from the reader end.
+	//!
+	//!\param t_r Where to copy the record.
+	//!\param timeout How long to wait for a record if the ring is empty.
+	//!
+	//!\return \c false if the ring is not open or was still empty when the timeout elapsed.
+	template<typename Rep, typename Period>
+	bool pop(T& t_r, const std::chrono::duration<Rep, Period>& timeout)
+	{
+		if(!d_header_p) return false;
+
+		const uint64_t tail = d_header_p->tail.value.load(std::memory_order_relaxed);
+
+		if(tail == d_cached)
+		{
+			d_cached = d_header_p->head.value.load(std::memory_order_acquire);
+
+			if(tail == d_cached && !await(d_header_p->head, tail, timeout))
+			{
+				return false;
+			}
+		}
+
+		std::memcpy(static_cast<void*>(&t_r), d_slots_p + (tail & d_mask), sizeof(T));
+		publish(d_header_p->tail, tail + 1);
+
+		return true;
+	}
+
+	//!\brief Copies the oldest record out of the ring if there is one.
+	//!
+	//! Must only be called from the reader end.
+	bool pop(T& t_r)
+	{
+		return pop(t_r, std::chrono::microseconds(0));
+	}
+};
+
+//!\brief Concrete consumer that copies the data it receives to a \ref shm_ring for a graph of another process.
+//!
+//! It holds the writer end of the ring.
+//! When the ring is full, it waits for the reading process to make room.
+//! Once it is paused or stopped, it keeps waiting for at most its \ref linger "linger" time, so that the packets it holds still go across
+//! when the graph is \ref graph::drain "drained". Packets that do not fit by then are dropped.
+//! Consumption times are not carried across.
+//!
+//!\tparam T The type of data. It must be trivially copyable.
+template<typename T>
+class shm_sink : public consumer<T>
+{
+	shm_ring<T> d_ring;
+
+	std::atomic<size_t> d_sent_a;
+	std::atomic<size_t> d_dropped_a;
+	std::atomic<std::chrono::milliseconds::rep> d_linger_a;
+
+	// Copies data to the ring, waiting for room.
+	// Once the node is no longer started, it only waits until a deadline, which is set the first time it has to wait.
+	// Data sent to a ring that could not be opened is dropped.
+	void send(const T& t, std::chrono::steady_clock::time_point& deadline_r)
+	{
+		if(!d_ring.is_open())
+		{
+			++d_dropped_a;
+			return;
+		}
+
+		if(deadline_r != std::chrono::steady_clock::time_point() && std::chrono::steady_clock::now() >= deadline_r)
+		{
+			++(d_ring.push(t) ? d_sent_a : d_dropped_a);
+			return;
+		}
+
+		while(!d_ring.push(t, std::chrono::milliseconds(10)))
+		{
+			if(node::state() != state::started)
+			{
+				const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+				if(deadline_r == std::chrono::steady_clock::time_point())
+				{
+					deadline_r = now + std::chrono::milliseconds(d_linger_a.load());
+				}
+				else if(now >= deadline_r)
+				{
+					++d_dropped_a;
+					return;
+				}
+			}
+		}
+
+		++d_sent_a;
+	}
+
+public:
+	//! This consumer has only one input.
+	//!
+	//!\param segment_r The name of the shared-memory segment, starting with a slash.
+	//!\param capacity The number of records the ring holds, if this node creates the segment.
+	//!\param name_r The name to give this node.
+	shm_sink(const std::string& segment_r, const size_t capacity = shm_ring<T>::default_capacity, const std::string& name_r = "shm_sink") :
+		 node(name_r), consumer<T>(name_r, 1), d_ring(segment_r, shm_end::writer, capacity), d_sent_a(0), d_dropped_a(0), d_linger_a(1000)
+	{
+		consumer<T>::template batch<shm_sink>();
+	}
+
+	virtual ~shm_sink() {}
+
+	//!\brief Whether the segment could be opened.
+	virtual bool is_open() const
+	{
+		return d_ring.is_open();
+	}
+
+	//!\brief The name of the segment.
+	virtual const std::string& segment() const
+	{
+		return d_ring.name();
+	}
+
+	//!\brief The number of records copied to the ring so far.
+	virtual size_t sent() const
+	{
+		return d_sent_a;
+	}
+
+	//!\brief The number of packets dropped because the ring was still full a while after this node was paused or stopped.
+	virtual size_t dropped() const
+	{
+		return d_dropped_a;
+	}
+
+	//!\brief Sets how long to keep waiting for room once this node is paused or stopped. The default is one second.
+	virtual void linger(const std::chrono::milliseconds& linger)
+	{
+		d_linger_a = linger.count();
+	}
+
+	//!\brief The segment, as a remote endpoint.
+	virtual std::string remote() const
+	{
+		return "shm:" + d_ring.name();
+	}
+
+	//!\brief Waiting on the reading process is waiting on something else than the input pins.
+	virtual bool blocks() const
+	{
+		return true;
+	}
+
+	//!\brief Implementation of consumer::ready().
+	virtual void ready(size_t)
+	{
+		std::unique_ptr<packet<T>> packet_p = consumer<T>::input(0).pop();
+
+		if(packet_p)
+		{
+			std::chrono::steady_clock::time_point deadline;
+			send(packet_p->data(), deadline);
+		}
+	}
+
+	//!\brief Implementation of consumer::ready_batch().
+	virtual void ready_batch(size_t, typename pipe<T>::packets_t& packets)
+	{
+		std::chrono::steady_clock::time_point deadline;
+		for(auto& packet_p : packets)
+		{
+			send(packet_p->data(), deadline);
+		}
+	}
+};
+
+//!\brief Concrete producer that pushes the records a graph of another process copied to a \ref shm_ring.
+//!
+//! It holds the reader end of the ring.
+//! While the ring is empty, it sleeps until the writing process pushes a record.
+//!
+//!\tparam T The type of data. It must be trivially copyable.
+template<typename T>
+class shm_source : public producer<T>
+{
+	shm_ring<T> d_ring;
+
+	std::atomic<size_t> d_received_a;
+
+public:
+	//! This producer has only one output.
+	//!
+	//!\param segment_r The name of the shared-memory segment, starting with a slash.
+	//!\param capacity The number of records the ring holds, if this node creates the segment.
+	//!\param name_r The name to give this node.
+	shm_source(const std::string& segment_r, const size_t capacity = shm_ring<T>::default_capacity, const std::string& name_r = "shm_source") :
+		 node(name_r), producer<T>(name_r, 1), d_ring(segment_r, shm_end::reader, capacity), d_received_a(0)
+	{}
+
+	virtual ~shm_source() {}
+
+	//!\brief Whether the segment could be opened.
+	virtual bool is_open() const
+	{
+		return d_ring.is_open();
+	}
+
+	//!\brief The name of the segment.
+	virtual const std::string& segment() const
+	{
+		return d_ring.name();
+	}
+
+	//!\brief The number of records taken from the ring so far.
+	virtual size_t received() const
+	{
+		return d_received_a;
+	}
+
+	//!\brief The segment, as a remote endpoint.
+	virtual std::string remote() const
+	{
+		return "shm:" + d_ring.name();
+	}
+
+	//!\brief Waiting on the writing process is waiting on something else than the input pins.
+	virtual bool blocks() const
+	{
+		return true;
+	}
+
+	//!\brief Implementation of producer::produce().
+	//!
+	//! Waits a little while for a record so that state changes are noticed promptly.
+	virtual void produce()
+	{
+		if(!d_ring.is_open())
+		{
+			std::this_thread::yield();
+			return;
+		}
+
+		T t;
+		if(d_ring.pop(t, std::chrono::milliseconds(10)))
+		{
+			++d_received_a;
+
+			std::unique_ptr<packet<T>> packet_p(producer<T>::make_packet(t));
+			producer<T>::output(0).push(packet_p);
+		}
+	}
+};
+
+#endif
+
+}
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
@@ -12,7 +12,7 @@
 
 //!\file timer.h
 //!
-//!\brief Defines the \ref flow::timer base class and the \ref flow::monotonous_timer concrete timer class.
+//!\brief Defines the \ref flow::timer base class and the \ref flow::monotonous_timer and \ref flow::multirate_timer concrete timer classes.
 
 namespace flow
 {
@@ -29,8 +29,16 @@ protected:
 
 	std::mutex d_listeners_m;	//!< Mutex to protect modifications to d_listeners.
 
+	typedef std::vector<std::pair<size_t, std::function<void ()>>> calls_t;	//!< Listeners to call, with their tokens.
+
+private:
+	bool d_calling;						// True while a listener is being called.
+	size_t d_calling_token;				// The token of the listener being called.
+	std::thread::id d_calling_id;		// The thread calling it.
+	std::condition_variable d_called_cv;	// Notified when a call returns.
+
 public:
-	timer() : d_stop_a(false), d_next_index(0) {}
+	timer() : d_stop_a(false), d_next_index(0), d_calling(false), d_calling_token(0) {}
 
 	virtual ~timer() {}
 
@@ -59,20 +67,65 @@ public:
 
 	//!\brief Removes a previously added listener.
 	//!
+	//! Waits for a call to this listener that is in progress to return, unless the listener itself is ignoring.
+	//!
 	//!\param token A value previously returned by \ref listen.
 	virtual void ignore(const size_t token)
 	{
-		std::lock_guard<std::mutex> lg(d_listeners_m);
+		std::unique_lock<std::mutex> ul(d_listeners_m);
 		d_listeners.erase(token);
+
+		d_called_cv.wait(ul, [&]{ return !d_calling || d_calling_token != token || d_calling_id == std::this_thread::get_id(); });
 	}
 
 	//!\brief Execution function to be implemented by concrete timers.
 	//!
 	//! This function must return as soon as possible after the timer is stopped.
 	virtual void operator()() = 0;
+
+protected:
+	//!\brief Copies listeners so they can be called without holding d_listeners_m.
+	//!
+	//! Copies are made into \c listeners, which is cleared first.
+	//! d_listeners_m must be held.
+	void copy_listeners(calls_t& listeners) const
+	{
+		listeners.clear();
+		for(auto& listener : d_listeners)
+		{
+			listeners.push_back(listener);
+		}
+	}
+
+	//!\brief Calls listeners previously copied.
+	//!
+	//! Listeners ignored since they were copied are skipped.
+	//! d_listeners_m must not be held.
+	void call_listeners(const calls_t& calls)
+	{
+		std::unique_lock<std::mutex> ul(d_listeners_m);
+
+		for(auto& call : calls)
+		{
+			if(!d_listeners.count(call.first)) continue;
+
+			d_calling = true;
+			d_calling_token = call.first;
+			d_calling_id = std::this_thread::get_id();
+			ul.unlock();
+
+			call.second();
+
+			ul.lock();
+			d_calling = false;
+			d_called_cv.notify_all();
+		}
+	}
 };
 
 //!\brief Concrete timer that notifies listeners repeatedly at a set interval of time.
+//!
+//! Notifications happen on a fixed schedule. The time listeners take to run does not delay the following notifications.
 class monotonous_timer : public timer
 {
 	std::chrono::milliseconds d_interval;
@@ -80,6 +133,8 @@ class monotonous_timer : public timer
 	std::condition_variable d_stopped_cv;
 	std::mutex d_stopped_m;
 
+	calls_t d_calls;
+
 public:
 	//!\param interval The time to wait between notifications. Must be a duration typedef from \<chrono\>.
 	template<typename Duration>
@@ -91,25 +146,173 @@ public:
 	{
 		timer::stop();
 
+		std::lock_guard<std::mutex> lg(d_stopped_m);
 		d_stopped_cv.notify_one();
 	}
 
 	//!\brief Implementation of timer::operator()().
+	//!
+	//! Listeners are called without holding the lock that protects them, so they may listen or ignore from within.
 	virtual void operator()()
 	{
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now();
+
 		while(!stopped())
 		{
 			{
 				std::lock_guard<std::mutex> lg(d_listeners_m);
-				for(auto& listener : d_listeners)
-				{
-					listener.second();
-				}
+				copy_listeners(d_calls);
 			}
-			
+
+			call_listeners(d_calls);
+
+			// Deadlines are accumulated so that the period does not drift.
+			deadline += d_interval;
+
 			// Wait until time has expired OR timer is stopped.
 			std::unique_lock<std::mutex> l_stopped(d_stopped_m);
-			d_stopped_cv.wait_for(l_stopped, d_interval);
+			d_stopped_cv.wait_until(l_stopped, deadline, [this](){ return this->stopped(); });
+		}
+	}
+};
+
+//!\brief Concrete timer that notifies each listener repeatedly at an interval of its own.
+//!
+//! A single multirate_timer, and a single thread, can drive any number of listeners at heterogeneous rates.
+//! Every listener has its own schedule of absolute deadlines, each one period after the previous one,
+//! so the time listeners take to run does not make their period drift.
+//! A listener that falls behind by more than one period skips the notifications it missed.
+class multirate_timer : public timer
+{
+	typedef std::chrono::steady_clock clock_type;
+
+	struct schedule
+	{
+		clock_type::duration period;
+		clock_type::time_point deadline;
+	};
+
+	std::chrono::milliseconds d_interval;
+
+	std::map<size_t, schedule> d_schedules;					// Keyed by listener token.
+	std::multimap<clock_type::time_point, size_t> d_deadlines;	// Next deadline of every listener, earliest first.
+
+	std::condition_variable d_changed_cv;	// Notified when stopped or when a listener is added.
+
+	calls_t d_calls;
+
+public:
+	//!\param interval The interval given to listeners added with listen(listener). Must be a duration typedef from \<chrono\>.
+	template<typename Duration>
+	multirate_timer(const Duration& interval) : d_interval(std::chrono::duration_cast<std::chrono::milliseconds>(interval)) {}
+
+	virtual ~multirate_timer() {}
+
+	virtual void stop()
+	{
+		timer::stop();
+
+		std::lock_guard<std::mutex> lg(d_listeners_m);
+		d_changed_cv.notify_one();
+	}
+
+	//!\brief Adds a listener to be notified at the interval given to the constructor.
+	//!
+	//!\param listener A functor that will be called at interval.
+	//!\return The token to pass to \ref ignore.
+	virtual size_t listen(const std::function<void ()>& listener)
+	{
+		return listen(listener, d_interval);
+	}
+
+	//!\brief Adds a listener to be notified at an interval of its own.
+	//!
+	//! The first notification happens one interval from now.
+	//!
+	//!\param listener A functor that will be called at interval.
+	//!\param interval The time between notifications. Must be a duration typedef from \<chrono\>.
+	//!\return The token to pass to \ref ignore.
+	template<typename Duration>
+	size_t listen(const std::function<void ()>& listener, const Duration& interval)
+	{
+		const size_t token = timer::listen(listener);
+
+		std::lock_guard<std::mutex> lg(d_listeners_m);
+
+		schedule &s = d_schedules[token];
+		s.period = std::chrono::duration_cast<clock_type::duration>(interval);
+		s.deadline = clock_type::now() + s.period;
+
+		d_deadlines.insert(std::make_pair(s.deadline, token));
+
+		d_changed_cv.notify_one();
+
+		return token;
+	}
+
+	//!\brief Removes a previously added listener.
+	//!
+	//!\param token A value previously returned by \ref listen.
+	virtual void ignore(const size_t token)
+	{
+		timer::ignore(token);
+
+		// Its entry in d_deadlines is skipped when it comes due.
+		std::lock_guard<std::mutex> lg(d_listeners_m);
+		d_schedules.erase(token);
+	}
+
+	//!\brief Implementation of timer::operator()().
+	//!
+	//! Listeners are called without holding the lock that protects them, so they may listen or ignore from within.
+	virtual void operator()()
+	{
+		std::unique_lock<std::mutex> ul(d_listeners_m);
+
+		while(!stopped())
+		{
+			if(d_deadlines.empty())
+			{
+				d_changed_cv.wait(ul);
+				continue;
+			}
+
+			const clock_type::time_point next = d_deadlines.begin()->first;
+			if(clock_type::now() < next)
+			{
+				d_changed_cv.wait_until(ul, next);
+				continue;
+			}
+
+			// Gather all listeners that are due and schedule their next notification.
+			d_calls.clear();
+
+			const clock_type::time_point now = clock_type::now();
+			while(!d_deadlines.empty() && d_deadlines.begin()->first <= now)
+			{
+				const size_t token = d_deadlines.begin()->second;
+				d_deadlines.erase(d_deadlines.begin());
+
+				auto s = d_schedules.find(token);
+				auto l = d_listeners.find(token);
+				if(s == d_schedules.end() || l == d_listeners.end()) continue;
+
+				d_calls.push_back(*l);
+
+				do
+				{
+					s->second.deadline += s->second.period;
+				}
+				while(s->second.deadline <= now);
+
+				d_deadlines.insert(std::make_pair(s->second.deadline, token));
+			}
+
+			ul.unlock();
+
+			call_listeners(d_calls);
+
+			ul.lock();
 		}
 	}
 };
@@ -0,0 +1,372 @@
+#if !defined(FLOW_TRACE_H)
+	 #define FLOW_TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//!\file trace.h
+//!
+//!\brief Defines the \ref flow::tracer class and the tracing hooks of nodes and pins.
+//!
+//! The hooks are only compiled in if \c FLOW_TRACE is defined before including any flow header.
+//! Otherwise they are empty inline functions and tracing costs nothing.
+
+#if !defined(FLOW_TRACE_CAPACITY)
+//!\brief The number of events every thread's ring holds before it overwrites its oldest ones. Must be a power of two.
+#define FLOW_TRACE_CAPACITY 16384
+#endif
+
+namespace flow
+{
+
+class node;
+
+//!\namespace flow::hook
+//!
+//!\brief Contains the different tracing hook values.
+namespace hook
+{
+
+//!\enum type
+//!
+//!\brief Where a \ref flow::trace_event "trace_event" was recorded.
+enum type
+{
+	push,		//!< Packets were moved to a pipe by an \ref flow::outpin::push "outpin".
+	pop,		//!< Packets were extracted from a pipe by an \ref flow::inpin::pop "inpin".
+	produce,	//!< A producer ran \ref flow::producer::produce "produce" and pushed packets, changed state or otherwise recorded events while doing so.
+	ready,		//!< A consumer ran \ref flow::consumer::ready "ready" or \ref flow::consumer::ready_batch "ready_batch".
+	transition	//!< A node changed \ref flow::state::type "state".
+};
+
+}
+
+//!\brief An event recorded by a tracing hook.
+struct trace_event
+{
+	hook::type what;					//!< The hook that recorded the event.
+	std::chrono::nanoseconds time;		//!< When the event happened, or began for hook::produce and hook::ready, since an arbitrary epoch.
+	std::chrono::nanoseconds duration;	//!< How long hook::produce and hook::ready lasted, 0 for the other hooks.
+	const node *node_p;					//!< The node that recorded the event.
+	const void *packet_p;				//!< For hook::push and hook::pop, the first packet moved. Matches a push to the pop of the same packet.
+	size_t arg;							//!< The number of packets moved for hook::push and hook::pop, the index of the inpin for hook::ready, the new state for hook::transition.
+	size_t thread;						//!< The ring that recorded the event, one per thread alive at the same time.
+};
+
+//!\cond
+namespace detail
+{
+
+// An event as stored in a ring. Every field is atomic so that a reader may copy an event while it is being overwritten.
+struct trace_slot
+{
+	std::atomic<std::int64_t> time_a;
+	std::atomic<std::int64_t> duration_a;
+	std::atomic<const node*> node_a;
+	std::atomic<const void*> packet_a;
+	std::atomic<size_t> arg_a;
+	std::atomic<unsigned> what_a;
+};
+
+// The events recorded by one thread. Only that thread writes to it, oldest events are overwritten first.
+class trace_ring
+{
+	std::unique_ptr<trace_slot[]> d_slots;
+	std::atomic<std::uint64_t> d_head_a;	// The number of events ever recorded.
+	const size_t d_id;
+
+	static const size_t capacity = FLOW_TRACE_CAPACITY;
+
+public:
+	trace_ring(const size_t id) : d_slots(new trace_slot[capacity]), d_head_a(0), d_id(id) {}
+
+	void record(const hook::type what, const std::int64_t time, const std::int64_t duration, const node* node_p, const void* packet_p, const size_t arg)
+	{
+		const std::uint64_t head = d_head_a.load(std::memory_order_relaxed);
+
+		// A reader that sees any of the stores below also sees that this slot's previous event is being overwritten.
+		std::atomic_thread_fence(std::memory_order_release);
+
+		trace_slot &slot_r = d_slots[head & (capacity - 1)];
+		slot_r.time_a.store(time, std::memory_order_relaxed);
+		slot_r.duration_a.store(duration, std::memory_order_relaxed);
+		slot_r.node_a.store(node_p, std::memory_order_relaxed);
+		slot_r.packet_a.store(packet_p, std::memory_order_relaxed);
+		slot_r.arg_a.store(arg, std::memory_order_relaxed);
+		slot_r.what_a.store(what, std::memory_order_relaxed);
+
+		d_head_a.store(head + 1, std::memory_order_release);
+	}
+
+	// The number of events ever recorded. Only meaningful to the recording thread.
+	std::uint64_t head() const
+	{
+		return d_head_a.load(std::memory_order_relaxed);
+	}
+
+	// Appends the events recorded at or after since, skipping those overwritten while they were copied.
+	void collect(std::vector<trace_event>& events_r, const std::int64_t since) const
+	{
+		const std::uint64_t head = d_head_a.load(std::memory_order_acquire), first = head > capacity ? head - capacity : 0;
+
+		std::vector<trace_event> copied;
+		copied.reserve(static_cast<size_t>(head - first));
+
+		for(std::uint64_t i = first; i != head; ++i)
+		{
+			const trace_slot &slot_r = d_slots[i & (capacity - 1)];
+
+			trace_event e;
+			e.what = static_cast<hook::type>(slot_r.what_a.load(std::memory_order_relaxed));
+			e.time = std::chrono::nanoseconds(slot_r.time_a.load(std::memory_order_relaxed));
+			e.duration = std::chrono::nanoseconds(slot_r.duration_a.load(std::memory_order_relaxed));
+			e.node_p = slot_r.node_a.load(std::memory_order_relaxed);
+			e.packet_p = slot_r.packet_a.load(std::memory_order_relaxed);
+			e.arg = slot_r.arg_a.load(std::memory_order_relaxed);
+			e.thread = d_id;
+
+			copied.push_back(e);
+		}
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		// The event being recorded now overwrites the slot of the event recorded capacity events before it.
+		const std::uint64_t now = d_head_a.load(std::memory_order_relaxed), valid = now >= capacity ? now - capacity + 1 : 0;
+
+		for(std::uint64_t i = std::max(first, valid); i < head; ++i)
+		{
+			const trace_event &e = copied[static_cast<size_t>(i - first)];
+			if(e.time.count() >= since)
+			{
+				events_r.push_back(e);
+			}
+		}
+	}
+};
+
+// Every ring ever made, and the ring of the calling thread.
+class trace_rings
+{
+	std::vector<std::shared_ptr<trace_ring>> d_rings;	// Every ring ever made.
+	std::vector<std::shared_ptr<trace_ring>> d_spare;	// The rings of threads that ended.
+	std::mutex d_m;
+
+	trace_rings() {}
+
+	trace_rings(const trace_rings&);
+	trace_rings& operator=(const trace_rings&);
+
+	// Gives a ring to the calling thread.
+	std::shared_ptr<trace_ring> lease()
+	{
+		std::lock_guard<std::mutex> lg(d_m);
+
+		if(!d_spare.empty())
+		{
+			std::shared_ptr<trace_ring> ring_sp = d_spare.back();
+			d_spare.pop_back();
+
+			return ring_sp;
+		}
+
+		d_rings.push_back(std::make_shared<trace_ring>(d_rings.size()));
+
+		return d_rings.back();
+	}
+
+	// Takes back the ring of a thread that ends.
+	void retire(const std::shared_ptr<trace_ring>& ring_sp)
+	{
+		std::lock_guard<std::mutex> lg(d_m);
+
+		d_spare.push_back(ring_sp);
+	}
+
+public:
+	static trace_rings& instance()
+	{
+		// Never destroyed, threads may still record events while static objects are destroyed.
+		static trace_rings *rings_p = new trace_rings;
+		return *rings_p;
+	}
+
+	// The calling thread's ring.
+	static trace_ring& local()
+	{
+		struct lessee
+		{
+			std::shared_ptr<trace_ring> ring_sp;
+
+			lessee() : ring_sp(instance().lease()) {}
+
+			~lessee() { instance().retire(ring_sp); }
+		};
+
+		static thread_local lessee l;
+
+		return *l.ring_sp;
+	}
+
+	void collect(std::vector<trace_event>& events_r, const std::int64_t since)
+	{
+		std::lock_guard<std::mutex> lg(d_m);
+
+		for(auto& ring_sp : d_rings)
+		{
+			ring_sp->collect(events_r, since);
+		}
+	}
+};
+
+// The time at which trace events start to count.
+inline const std::chrono::steady_clock::time_point& trace_epoch()
+{
+	static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	return epoch;
+}
+
+// Events recorded before this time, since the epoch, are ignored.
+inline std::atomic<std::int64_t>& trace_since()
+{
+	static std::atomic<std::int64_t> since(0);
+	return since;
+}
+
+}
+//!\endcond
+
+//!\brief Gathers the events recorded by the tracing hooks of all threads.
+//!
+//! Every thread that records an event gets a ring of \c FLOW_TRACE_CAPACITY events of its own, so recording takes no lock.
+//! When a thread ends, its ring is kept with the events it holds and given to the next thread that needs one.
+//!
+//! \ref graph::to_trace "graph::to_trace" writes the events of a graph's nodes as a Chrome trace.
+class tracer
+{
+public:
+	//!\brief Whether the tracing hooks were compiled in, i.e. whether \c FLOW_TRACE was defined.
+	static bool enabled()
+	{
+#if defined(FLOW_TRACE)
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	//!\brief The time since the epoch of trace_event::time.
+	static std::chrono::nanoseconds now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - detail::trace_epoch());
+	}
+
+	//!\brief Appends the events recorded by all threads since the last call to clear(), in no particular order.
+	//!
+	//! Can be called while events are being recorded. Events a thread overwrites while they are copied are left out.
+	static void collect(std::vector<trace_event>& events_r)
+	{
+		detail::trace_rings::instance().collect(events_r, detail::trace_since().load());
+	}
+
+	//!\brief Forgets the events recorded so far.
+	static void clear()
+	{
+		detail::trace_since() = now().count();
+	}
+};
+
+//!\cond
+namespace detail
+{
+
+// The time to give trace(), 0 if the hooks are not compiled in.
+inline std::int64_t trace_time()
+{
+#if defined(FLOW_TRACE)
+	return tracer::now().count();
+#else
+	return 0;
+#endif
+}
+
+// Records an event, if the hooks are compiled in.
+// The time can be taken earlier, e.g. before a packet is pushed so that its push is never recorded after its pop.
+inline void trace(const hook::type what, const node* node_p, const void* packet_p = nullptr, const size_t arg = 0, const std::int64_t time = trace_time())
+{
+#if defined(FLOW_TRACE)
+	trace_rings::local().record(what, time, 0, node_p, packet_p, arg);
+#else
+	(void)what; (void)node_p; (void)packet_p; (void)arg; (void)time;
+#endif
+}
+
+// Records an event that lasts for its lifetime, or from an earlier time, if the hooks are compiled in.
+// A call to produce() during which nothing else was recorded is left out, so that a polling producer does not flood the trace.
+class trace_scope
+{
+#if defined(FLOW_TRACE)
+	trace_ring &d_ring_r;
+	const std::uint64_t d_head;
+	const hook::type d_what;
+	const node *d_node_p;
+	const size_t d_arg;
+	const std::int64_t d_start;
+#endif
+
+	trace_scope(const trace_scope&);
+	trace_scope& operator=(const trace_scope&);
+
+public:
+#if defined(FLOW_TRACE)
+	trace_scope(const hook::type what, const node* node_p, const size_t arg = 0, const std::int64_t start = trace_time()) : d_ring_r(trace_rings::local()), d_head(d_ring_r.head()), d_what(what), d_node_p(node_p), d_arg(arg), d_start(start) {}
+
+	~trace_scope()
+	{
+		if(d_what == hook::produce && d_ring_r.head() == d_head) return;
+
+		d_ring_r.record(d_what, d_start, tracer::now().count() - d_start, d_node_p, nullptr, d_arg);
+	}
+#else
+	trace_scope(const hook::type, const node*, const size_t = 0, const std::int64_t = 0) {}
+#endif
+};
+
+}
+//!\endcond
+
+}
+
+#endif
+
+/*
+	(C) Copyright Thierry Seegers 2010-2012. Distributed under the following license:
+
+	Boost Software License - Version 1.0 - August 17th, 2003
+
+	Permission is hereby granted, free of charge, to any person or organization
+	obtaining a copy of the software and accompanying documentation covered by
+	this license (the "Software") to use, reproduce, display, distribute,
+	execute, and transmit the Software, and to prepare derivative works of the
+	Software, and to permit third-parties to whom the Software is furnished to
+	do so, all subject to the following:
+
+	The copyright notices in the Software and this entire statement, including
+	the above license grant, this restriction and the following disclaimer,
+	must be included in all copies of the Software, in whole or in part, and
+	all derivative works of the Software, unless such copies or derivative
+	works are solely in the form of machine-executable object code generated by
+	a source language processor.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+	SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+	FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+	ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
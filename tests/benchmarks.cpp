@@ -0,0 +1,401 @@
+#include "counted.h"
+
+#include "flow.h"
+#include "samples/generic.h"
+#include "samples/math.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+typedef chrono::steady_clock clock_type;
+
+// An int carried by packets with neither a consumption time nor a virtual destructor.
+struct slim_int
+{
+	int value;
+};
+
+namespace flow { template<> struct packet_traits<slim_int> : slim_packet {}; }
+
+// Produces a number of packets then yields its thread.
+template<typename T>
+class source : public flow::producer<T>
+{
+	size_t d_n;
+	T d_t;
+
+public:
+	source(size_t n, const T& t = T()) : flow::node("source"), flow::producer<T>("source", 1), d_n(n), d_t(t) {}
+
+	virtual ~source() {}
+
+	virtual void produce()
+	{
+		if(d_n)
+		{
+			--d_n;
+
+			unique_ptr<flow::packet<T>> packet_p(flow::producer<T>::make_packet(d_t));
+			flow::producer<T>::output(0).push(packet_p);
+		}
+		else
+		{
+			this_thread::yield();
+		}
+	}
+};
+
+// Counts the packets it consumes.
+template<typename T>
+class sink : public flow::consumer<T>
+{
+	atomic<size_t> d_received_a;
+
+public:
+	sink(size_t ins = 1) : flow::node("sink"), flow::consumer<T>("sink", ins), d_received_a(0)
+	{
+		flow::consumer<T>::template batch<sink>();
+	}
+
+	virtual ~sink() {}
+
+	virtual void ready(size_t i)
+	{
+		flow::consumer<T>::input(i).pop();
+		++d_received_a;
+	}
+
+	virtual void ready_batch(size_t, typename flow::pipe<T>::packets_t& packets)
+	{
+		d_received_a += packets.size();
+	}
+
+	virtual size_t received() const
+	{
+		return d_received_a;
+	}
+};
+
+// A consumer that is never started, used to get at an inpin.
+template<typename T>
+class idle : public flow::consumer<T>
+{
+public:
+	idle() : flow::node("idle"), flow::consumer<T>("idle", 1) {}
+
+	virtual void ready(size_t) {}
+};
+
+// A producer that is never started, used to get at an outpin.
+template<typename T>
+class manual : public flow::producer<T>
+{
+public:
+	manual() : flow::node("manual"), flow::producer<T>("manual", 1) {}
+
+	virtual void produce() {}
+
+	unique_ptr<flow::packet<T>> make(const T& t)
+	{
+		return flow::producer<T>::make_packet(t);
+	}
+
+	void connect(flow::consumer<T>& consumer_r, const flow::pipe_type::type kind)
+	{
+		flow::producer<T>::connect(0, &consumer_r, 0, 0, 0, kind);
+	}
+};
+
+// Prints one result as a line of comma-separated values.
+void report(const string& benchmark, const string& variant, const size_t parameter, const size_t packets, const clock_type::duration& elapsed)
+{
+	const double ns = static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+
+	cout << benchmark << ',' << variant << ',' << parameter << ',' << packets << ',' << ns / packets << ',' << (ns ? packets * 1e9 / ns : 0.) << endl;
+}
+
+const char* name(const flow::execution::type e)
+{
+	return e == flow::execution::pooled ? "pooled" : "threaded";
+}
+
+const char* name(const flow::pipe_type::type k)
+{
+	return k == flow::pipe_type::ring ? "ring" : "deque";
+}
+
+// Starts the graph and returns the time it took for the sinks to receive the expected number of packets each.
+template<typename T>
+clock_type::duration run(flow::graph& g, const vector<shared_ptr<sink<T>>>& sinks, const size_t expected)
+{
+	const clock_type::time_point start = clock_type::now();
+
+	g.start();
+
+	for(auto& sp_s : sinks)
+	{
+		while(sp_s->received() < expected)
+		{
+			this_thread::yield();
+		}
+	}
+
+	const clock_type::duration elapsed = clock_type::now() - start;
+
+	g.stop();
+
+	return elapsed;
+}
+
+// pipe<T>::push and pipe<T>::pop on a single thread, one packet at a time and in batches.
+template<typename T>
+void pipe_push_pop(const size_t packets, const string& prefix)
+{
+	for(auto kind : { flow::pipe_type::deque, flow::pipe_type::ring })
+	{
+		unique_ptr<flow::pipe<T>> p;
+		if(kind == flow::pipe_type::ring)
+		{
+			p.reset(new flow::ring_pipe<T>("pipe", nullptr, nullptr));
+		}
+		else
+		{
+			p.reset(new flow::pipe<T>("pipe", nullptr, nullptr));
+		}
+
+		flow::packet_pool<T> pool;
+		const size_t burst = 64, n = (packets + burst - 1) / burst * burst;
+
+		clock_type::time_point start = clock_type::now();
+		for(size_t i = 0; i != n; i += burst)
+		{
+			for(size_t j = 0; j != burst; ++j)
+			{
+				unique_ptr<flow::packet<T>> packet_p(pool.make_packet(T()));
+				p->push(packet_p);
+			}
+
+			for(size_t j = 0; j != burst; ++j)
+			{
+				p->pop();
+			}
+		}
+		report("pipe_push_pop", prefix + name(kind), 1, n, clock_type::now() - start);
+
+		typename flow::pipe<T>::packets_t batch;
+
+		start = clock_type::now();
+		for(size_t i = 0; i != n; i += burst)
+		{
+			for(size_t j = 0; j != burst; ++j)
+			{
+				batch.push_back(pool.make_packet(T()));
+			}
+			p->push_n(batch);
+
+			p->pop_n(batch);
+			batch.clear();
+		}
+		report("pipe_push_pop", prefix + name(kind), burst, n, clock_type::now() - start);
+	}
+}
+
+// outpin to inpin on a single thread, including locking and signalling the consuming node.
+void hop(const size_t packets)
+{
+	for(auto kind : { flow::pipe_type::deque, flow::pipe_type::ring })
+	{
+		manual<int> m;
+		idle<int> i;
+
+		m.connect(i, kind);
+
+		const clock_type::time_point start = clock_type::now();
+		for(size_t j = 0; j != packets; ++j)
+		{
+			unique_ptr<flow::packet<int>> packet_p(m.make(0));
+			m.output(0).push(packet_p);
+			i.input(0).pop();
+		}
+		report("hop", name(kind), 1, packets, clock_type::now() - start);
+	}
+}
+
+// One producer to a tee to many sinks.
+void tee(const size_t packets, const flow::execution::type e)
+{
+	for(size_t outs = 2; outs <= 8; outs *= 2)
+	{
+		flow::graph g("graph", e);
+
+		auto sp_p = make_shared<source<int>>(packets);
+		auto sp_t = make_shared<flow::samples::generic::tee<int>>(outs);
+		g.add(sp_p, "producer");
+		g.add(sp_t, "tee");
+		g.connect<int>(sp_p, 0, sp_t, 0);
+
+		vector<shared_ptr<sink<int>>> sinks;
+		for(size_t i = 0; i != outs; ++i)
+		{
+			sinks.push_back(make_shared<sink<int>>());
+			g.add(sinks.back(), "sink" + to_string(i));
+			g.connect<int>(sp_t, i, sinks.back(), 0);
+		}
+
+		report("tee", name(e), outs, packets * outs, run(g, sinks, packets));
+	}
+}
+
+// Many producers joined by an adder.
+void adder(const size_t packets, const flow::execution::type e)
+{
+	for(size_t ins = 2; ins <= 8; ins *= 2)
+	{
+		flow::graph g("graph", e);
+
+		auto sp_a = make_shared<flow::samples::math::adder<int>>(ins);
+		g.add(sp_a, "adder");
+
+		for(size_t i = 0; i != ins; ++i)
+		{
+			auto sp_p = make_shared<source<int>>(packets);
+			g.add(sp_p, "producer" + to_string(i));
+			g.connect<int>(sp_p, 0, sp_a, i);
+		}
+
+		vector<shared_ptr<sink<int>>> sinks(1, make_shared<sink<int>>());
+		g.add(sinks[0], "sink");
+		g.connect<int>(sp_a, 0, sinks[0], 0);
+
+		report("adder", name(e), ins, packets, run(g, sinks, packets));
+	}
+}
+
+// A producer, a chain of pass-through transformers and a sink.
+void chain(const size_t packets, const flow::execution::type e)
+{
+	for(size_t length = 1; length <= 64; length *= 4)
+	{
+		flow::graph g("graph", e);
+
+		auto sp_p = make_shared<source<int>>(packets);
+		g.add(sp_p, "producer");
+
+		shared_ptr<flow::producer<int>> sp_last = sp_p;
+		for(size_t i = 0; i != length; ++i)
+		{
+			auto sp_t = make_shared<transformation_counter<int>>();
+			g.add(sp_t, "transformer" + to_string(i));
+			g.connect<int>(sp_last, 0, sp_t, 0);
+			sp_last = sp_t;
+		}
+
+		vector<shared_ptr<sink<int>>> sinks(1, make_shared<sink<int>>());
+		g.add(sinks[0], "sink");
+		g.connect<int>(sp_last, 0, sinks[0], 0);
+
+		report("chain", name(e), length, packets, run(g, sinks, packets));
+	}
+}
+
+// A producer, a tee splitting into two chains of pass-through transformers, an adder joining them and a sink.
+void diamond(const size_t packets, const flow::execution::type e)
+{
+	for(size_t length = 1; length <= 64; length *= 4)
+	{
+		flow::graph g("graph", e);
+
+		auto sp_p = make_shared<source<int>>(packets);
+		auto sp_t = make_shared<flow::samples::generic::tee<int>>(2);
+		auto sp_a = make_shared<flow::samples::math::adder<int>>(2);
+		g.add(sp_p, "producer");
+		g.add(sp_t, "tee");
+		g.add(sp_a, "adder");
+		g.connect<int>(sp_p, 0, sp_t, 0);
+
+		for(size_t b = 0; b != 2; ++b)
+		{
+			shared_ptr<flow::producer<int>> sp_last = sp_t;
+			size_t pin = b;
+
+			for(size_t i = 0; i != length; ++i)
+			{
+				auto sp_c = make_shared<transformation_counter<int>>();
+				g.add(sp_c, "transformer" + to_string(b) + "_" + to_string(i));
+				g.connect<int>(sp_last, pin, sp_c, 0);
+				sp_last = sp_c;
+				pin = 0;
+			}
+
+			g.connect<int>(sp_last, pin, sp_a, b);
+		}
+
+		vector<shared_ptr<sink<int>>> sinks(1, make_shared<sink<int>>());
+		g.add(sinks[0], "sink");
+		g.connect<int>(sp_a, 0, sinks[0], 0);
+
+		report("diamond", name(e), length, packets, run(g, sinks, packets));
+	}
+}
+
+// A producer, a const_adder and a sink, for packets of one value and for batches of values.
+template<typename T>
+void kernel(const size_t packets, const flow::execution::type e, const T& t, const size_t values)
+{
+	flow::graph g("graph", e);
+
+	auto sp_p = make_shared<source<T>>(packets, t);
+	auto sp_a = make_shared<flow::samples::math::const_adder<T>>(t);
+	g.add(sp_p, "producer");
+	g.add(sp_a, "const_adder");
+	g.connect<T>(sp_p, 0, sp_a, 0);
+
+	vector<shared_ptr<sink<T>>> sinks(1, make_shared<sink<T>>());
+	g.add(sinks[0], "sink");
+	g.connect<T>(sp_a, 0, sinks[0], 0);
+
+	report("kernel", name(e), values, packets, run(g, sinks, packets));
+}
+
+void kernels(const size_t packets, const flow::execution::type e)
+{
+	kernel(packets, e, 1.f, 1);
+	kernel(packets, e, flow::batch<float, 256>(256, 1.f), 256);
+}
+
+// Usage: benchmarks [packets [benchmark]]
+// Results are printed as comma-separated values, one line per run.
+int main(int argc, char* argv[])
+{
+	const size_t packets = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+	const string only = argc > 2 ? argv[2] : "";
+
+	cout << "benchmark,variant,parameter,packets,ns_per_packet,packets_per_second" << endl;
+
+	if(only.empty() || only == "pipe_push_pop")
+	{
+		pipe_push_pop<int>(packets, "");
+		pipe_push_pop<slim_int>(packets, "slim_");
+	}
+	if(only.empty() || only == "hop") hop(packets);
+
+	for(auto e : { flow::execution::threaded, flow::execution::pooled })
+	{
+		if(only.empty() || only == "tee") tee(packets, e);
+		if(only.empty() || only == "adder") adder(packets, e);
+		if(only.empty() || only == "chain") chain(packets, e);
+		if(only.empty() || only == "diamond") diamond(packets, e);
+		if(only.empty() || only == "kernel") kernels(packets, e);
+	}
+
+	return 0;
+}
@@ -0,0 +1,208 @@
+#include "flow.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+typedef map<string, string> args_t;
+
+args_t make_args(const char* types[], char* values[], int c)
+{
+	args_t args;
+
+	while(c)
+	{
+		--c;
+
+		args[types[c]] = values[c];
+	}
+
+	return args;
+}
+
+flow::execution::type execution(args_t& args)
+{
+	return args["execution"] == "pooled" ? flow::execution::pooled : flow::execution::threaded;
+}
+
+#if defined(FLOW_COROUTINES)
+
+// Produces a number of increasing values, sleeping between them.
+class ticker : public flow::co_producer<int>
+{
+	const size_t d_n;
+	const chrono::milliseconds d_interval;
+
+public:
+	ticker(size_t n, chrono::milliseconds interval) : flow::node("ticker"), flow::co_producer<int>("ticker", 1), d_n(n), d_interval(interval) {}
+
+	virtual flow::routine run()
+	{
+		for(size_t i = 0; i != d_n; ++i)
+		{
+			co_await sleep_for(d_interval);
+			co_await room(0);
+
+			unique_ptr<flow::packet<int>> packet_p(make_packet(static_cast<int>(i)));
+			output(0).push(packet_p);
+		}
+	}
+};
+
+// Passes packets through.
+class relay : public flow::co_transformer<int, int>
+{
+public:
+	relay() : flow::node("relay"), flow::co_transformer<int, int>("relay", 1, 1) {}
+
+	virtual flow::routine run()
+	{
+		while(true)
+		{
+			unique_ptr<flow::packet<int>> packet_p = co_await next(0);
+
+			co_await room(0);
+			output(0).push(packet_p);
+		}
+	}
+};
+
+// Checks that values arrive in order at each of its inputs.
+class checker : public flow::co_consumer<int>
+{
+	vector<int> d_expected;
+	atomic<size_t> d_received_a;
+	atomic<bool> d_ordered_a;
+
+public:
+	checker(size_t ins) : flow::node("checker"), flow::co_consumer<int>("checker", ins), d_expected(ins, 0), d_received_a(0), d_ordered_a(true) {}
+
+	virtual flow::routine run()
+	{
+		d_expected.assign(d_expected.size(), 0);
+
+		while(true)
+		{
+			const size_t i = co_await any();
+
+			unique_ptr<flow::packet<int>> packet_p = input(i).pop();
+			if(packet_p->data() != d_expected[i]++)
+			{
+				d_ordered_a = false;
+			}
+
+			++d_received_a;
+
+			co_await yield();
+		}
+	}
+
+	size_t received() const
+	{
+		return d_received_a;
+	}
+
+	bool ordered() const
+	{
+		return d_ordered_a;
+	}
+
+	void reset()
+	{
+		d_received_a = 0;
+	}
+};
+
+// Waits for a checker to receive a number of packets, for a few seconds at most.
+bool received(const checker& checker_r, const size_t n)
+{
+	for(int i = 0; i != 1000 && checker_r.received() < n; ++i)
+	{
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+
+	return checker_r.received() == n;
+}
+
+#endif
+
+// Many tickers feed a checker through chains of relays, on a scheduler with two threads.
+// A blocking pipe throttles one ticker through room(). Stopping and starting again starts every routine over.
+bool chains(args_t args)
+{
+#if defined(FLOW_COROUTINES)
+	const size_t chains = stoul(args["chains"]), length = stoul(args["length"]), n = 5;
+
+	flow::graph g("graph", execution(args), 2);
+
+	auto sp_c = make_shared<checker>(chains);
+	g.add(sp_c, "checker");
+
+	for(size_t c = 0; c != chains; ++c)
+	{
+		auto sp_t = make_shared<ticker>(n, chrono::milliseconds(1 + c % 3));
+		g.add(sp_t, "ticker" + to_string(c));
+
+		shared_ptr<flow::producer<int>> sp_last = sp_t;
+		for(size_t i = 0; i != length; ++i)
+		{
+			auto sp_r = make_shared<relay>();
+			g.add(sp_r, "relay" + to_string(c) + "_" + to_string(i));
+
+			if(c == 0 && i == 0)
+			{
+				g.connect<int>(sp_last, 0, sp_r, 0, 1, 0, flow::pipe_type::deque, flow::overflow::block);
+			}
+			else
+			{
+				g.connect<int>(sp_last, 0, sp_r, 0);
+			}
+
+			sp_last = sp_r;
+		}
+
+		g.connect<int>(sp_last, 0, sp_c, c);
+	}
+
+	for(int run = 0; run != 2; ++run)
+	{
+		sp_c->reset();
+
+		g.start();
+
+		const bool b = received(*sp_c, chains * n);
+
+		// Nothing more comes once all tickers are done.
+		this_thread::sleep_for(chrono::milliseconds(20));
+
+		g.stop();
+
+		if(!b || sp_c->received() != chains * n || !sp_c->ordered())
+		{
+			return false;
+		}
+	}
+#endif
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	bool b = false;
+
+	if(strcmp(argv[1], "chains") == 0)
+	{
+		const char* types[] = { "chains", "length", "execution" };
+		b = chains(make_args(types, &argv[2], argc - 2));
+	}
+
+	return b ? 0 : 1;
+}
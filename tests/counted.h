@@ -23,7 +23,7 @@ public:
 
 			for(auto& outpin : flow::producer<T>::outputs())
 			{
-				std::unique_ptr<flow::packet<T>> packet_p(new flow::packet<T>(T()));
+				std::unique_ptr<flow::packet<T>> packet_p(flow::producer<T>::make_packet(T()));
 
 				outpin.push(packet_p);
 			}
@@ -80,7 +80,7 @@ public:
 
 	virtual void ready(size_t i)
 	{
-		flow::consumer<T>::input(0).pop();
+		flow::consumer<T>::input(i).pop();
 		++received[i];
 	}
 
@@ -4,15 +4,36 @@
 
 #include "flow.h"
 #include "samples/generic.h"
+#include "samples/io.h"
 #include "samples/math.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <random>
+#include <set>
+#include <sstream>
 #include <string>
 #include <thread>
+#include <type_traits>
+
+#if defined(FLOW_SHM_SUPPORTED)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Data carried by packets with neither a consumption time nor a virtual destructor.
+struct tick
+{
+	int value;
+};
+
+namespace flow { template<> struct packet_traits<tick> : slim_packet {}; }
 
 using namespace std;
 
@@ -32,6 +53,16 @@ args_t make_args(const char* types[], char* values[], int c)
 	return args;
 }
 
+flow::pipe_type::type pipe_type(args_t& args)
+{
+	return args["pipe"] == "ring" ? flow::pipe_type::ring : flow::pipe_type::deque;
+}
+
+flow::execution::type execution(args_t& args)
+{
+	return args["execution"] == "pooled" ? flow::execution::pooled : flow::execution::threaded;
+}
+
 bool empty(args_t args)
 {
 	{
@@ -88,14 +119,14 @@ bool count(args_t args)
 	auto sp_cc = make_shared<consumption_counter<int>>();
 
 	{
-		flow::graph g;
+		flow::graph g("graph", execution(args));
 
 		g.add(sp_pn);
 		g.add(sp_tc);
 		g.add(sp_cc);
 
-		g.connect<int>(sp_pn, 0, sp_tc, 0);
-		g.connect<int>(sp_tc, 0, sp_cc, 0);
+		g.connect<int>(sp_pn, 0, sp_tc, 0, 0, 0, pipe_type(args));
+		g.connect<int>(sp_tc, 0, sp_cc, 0, 0, 0, pipe_type(args));
 
 		g.start();
 
@@ -111,7 +142,7 @@ bool restart(args_t args)
 		auto sp_pn = make_shared<produce_n<int>>(3);
 		auto sp_cc = make_shared<consumption_counter<int>>();
 	
-		flow::graph g;
+		flow::graph g("graph", execution(args));
 	
 		g.add(sp_pn);
 		g.add(sp_cc);
@@ -150,6 +181,75 @@ bool restart(args_t args)
 	return true;
 }
 
+bool fused(args_t args)
+{
+	size_t n = stoul(args["count"]);
+	size_t length = stoul(args["length"]);
+
+	auto sp_pn = make_shared<produce_n<int>>(n);
+	auto sp_cc = make_shared<consumption_counter<int>>();
+	vector<shared_ptr<transformation_counter<int>>> transformers;
+
+	flow::graph g("graph", execution(args));
+
+	g.add(sp_pn);
+	g.add(sp_cc);
+
+	shared_ptr<flow::producer<int>> sp_last = sp_pn;
+	for(size_t i = 0; i != length; ++i)
+	{
+		transformers.push_back(make_shared<transformation_counter<int>>());
+		g.add(transformers.back(), "transformation_counter_" + to_string(i));
+		g.connect<int>(sp_last, 0, transformers.back(), 0);
+		sp_last = transformers.back();
+	}
+
+	g.connect<int>(sp_last, 0, sp_cc, 0);
+
+	// Run twice, pausing in between, then twice more, stopping in between.
+	for(int r = 0; r != 4; ++r)
+	{
+		g.start();
+
+		this_thread::sleep_for(chrono::milliseconds(100));
+
+		if(r % 2) g.stop();
+		else g.pause();
+
+		for(auto& sp_tc : transformers)
+		{
+			if(sp_tc->count(0) != n)
+			{
+				return false;
+			}
+
+			sp_tc->reset();
+		}
+
+		if(sp_cc->count(0) != n)
+		{
+			return false;
+		}
+
+		sp_pn->reset();
+		sp_cc->reset();
+	}
+
+	// All transformers but the first ran on the first's thread, they never waited on their own.
+	if(execution(args) == flow::execution::threaded)
+	{
+		for(auto& m : g.metrics().nodes)
+		{
+			if(m.name.find("transformation_counter_") == 0 && m.name != "transformation_counter_0" && m.waiting.count())
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
 bool tee(args_t args)
 {
 	{
@@ -158,7 +258,7 @@ bool tee(args_t args)
 		auto sp_po1 = make_shared<popper<int>>();
 		auto sp_po2 = make_shared<popper<int>>();
 
-		flow::graph g;
+		flow::graph g("graph", execution(args));
 
 		g.add(sp_pu, "pusher_1");
 		g.add(sp_t);
@@ -201,7 +301,7 @@ bool reconnect(args_t args)
 	auto sp_cc2 = make_shared<consumption_counter<int>>();
 
 	{
-		flow::graph g;
+		flow::graph g("graph", execution(args));
 
 		g.add(sp_pn);
 		g.add(sp_tc);
@@ -268,6 +368,91 @@ bool reconnect(args_t args)
 	return true;
 }
 
+bool batch(args_t args)
+{
+	size_t c = stoul(args["count"]);
+
+	auto sp_pu = make_shared<pusher<int>>();
+	auto sp_a = make_shared<flow::samples::math::const_adder<int>>(11);
+	auto sp_t = make_shared<flow::samples::generic::tee<int>>();
+	auto sp_po1 = make_shared<popper<int>>();
+	auto sp_po2 = make_shared<popper<int>>();
+
+	flow::graph g("graph", execution(args));
+
+	g.add(sp_pu, "pusher");
+	g.add(sp_a);
+	g.add(sp_t);
+	g.add(sp_po1, "popper_1");
+	g.add(sp_po2, "popper_2");
+
+	g.connect<int>(sp_pu, 0, sp_a, 0, 0, 0, pipe_type(args));
+	g.connect<int>(sp_a, 0, sp_t, 0, 0, 0, pipe_type(args));
+	g.connect<int>(sp_t, 0, sp_po1, 0, 0, 0, pipe_type(args));
+	g.connect<int>(sp_t, 1, sp_po2, 0, 0, 0, pipe_type(args));
+
+	g.start();
+
+	vector<int> ns;
+	for(size_t i = 0; i != c; ++i)
+	{
+		ns.push_back(static_cast<int>(i));
+	}
+
+	if(sp_pu->push_n(ns) != c)
+	{
+		return false;
+	}
+
+	// Packets must come out in the order they were pushed.
+	for(size_t i = 0; i != c; ++i)
+	{
+		if(sp_po1->pop()->data() != static_cast<int>(i) + 11 || sp_po2->pop()->data() != static_cast<int>(i) + 11)
+		{
+			return false;
+		}
+	}
+
+	return !sp_po1->peek() && !sp_po2->peek();
+}
+
+bool spin(args_t args)
+{
+	size_t c = stoul(args["count"]);
+	size_t spins = stoul(args["spins"]);
+	size_t yields = stoul(args["yields"]);
+
+	auto sp_pu = make_shared<pusher<int>>();
+	auto sp_a = make_shared<flow::samples::math::const_adder<int>>(11);
+	auto sp_po = make_shared<popper<int>>();
+
+	sp_a->spin(spins, yields);
+	sp_po->spin(spins, yields);
+
+	flow::graph g;
+
+	g.add(sp_pu, "pusher");
+	g.add(sp_a);
+	g.add(sp_po, "popper");
+
+	g.connect<int>(sp_pu, 0, sp_a, 0);
+	g.connect<int>(sp_a, 0, sp_po, 0);
+
+	g.start();
+
+	for(size_t i = 0; i != c; ++i)
+	{
+		sp_pu->push(static_cast<int>(i));
+
+		if(sp_po->pop()->data() != static_cast<int>(i) + 11)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
 bool add_delay(args_t args)
 {
 	{
@@ -514,16 +699,16 @@ bool max_length(args_t args)
 	g.add(sp_pu, "pusher");
 	g.add(sp_po, "popper");
 
-	g.connect<int>(sp_pu, 0, sp_po, 0, max_length);
+	g.connect<int>(sp_pu, 0, sp_po, 0, max_length, 0, pipe_type(args));
 
 	g.start();
 
-	for(int i = 0; i != max_length + 1; ++i)
+	for(size_t i = 0; i != max_length + 1; ++i)
 	{
 		sp_pu->push(0);
 	}
 
-	for(int i = 0; i != max_length; ++i)
+	for(size_t i = 0; i != max_length; ++i)
 	{
 		sp_po->pop();
 	}
@@ -548,16 +733,16 @@ bool max_weight(args_t args)
 	g.add(sp_pu, "pusher");
 	g.add(sp_po, "popper");
 
-	g.connect<char>(sp_pu, 0, sp_po, 0, 0, max_weight);
+	g.connect<char>(sp_pu, 0, sp_po, 0, 0, max_weight, pipe_type(args));
 
 	g.start();
 
-	for(int i = 0; i != max_weight + 1; ++i)
+	for(size_t i = 0; i != max_weight + 1; ++i)
 	{
 		sp_pu->push('a');
 	}
 
-	for(int i = 0; i != max_weight; ++i)
+	for(size_t i = 0; i != max_weight; ++i)
 	{
 		sp_po->pop();
 	}
@@ -570,69 +755,2460 @@ bool max_weight(args_t args)
 	return true;
 }
 
-int main(int argc, char* argv[])
+bool string_weight(args_t args)
 {
-	bool b = false;
+	size_t length = stoul(args["length"]);
 
-	if(strcmp(argv[1], "empty") == 0)
+	const string s(length, 'a');
+	const size_t w = flow::weight<string>::of(s);
+
+	auto sp_pu = make_shared<pusher<string>>();
+	auto sp_po = make_shared<popper<string>>();
+
+	flow::graph g;
+
+	g.add(sp_pu, "pusher");
+	g.add(sp_po, "popper");
+
+	// Room for two strings and a half.
+	g.connect<string>(sp_pu, 0, sp_po, 0, 0, w * 5 / 2);
+
+	g.start();
+
+	if(w < length || !sp_pu->push(s) || !sp_pu->push(s) || sp_pu->push(s))
 	{
-		const char* types[] = { "start" };
-		b = empty(make_args(types, &argv[2], argc - 2));
+		return false;
 	}
-	else if(strcmp(argv[1], "unconnected") == 0)
+
+	if(g.metrics().pipes[0].weight != w * 2)
 	{
-		const char* types[] = { "start" };
-		b = unconnected(make_args(types, &argv[2], argc - 2));
+		return false;
 	}
-	else if(strcmp(argv[1], "connected") == 0)
+
+	sp_po->pop();
+	sp_po->pop();
+
+	return g.metrics().pipes[0].weight == 0;
+}
+
+bool reuse_pipe(args_t args)
+{
+	size_t max_weight = stoul(args["weight"]);
+
+	auto sp_pu1 = make_shared<pusher<char>>();
+	auto sp_pu2 = make_shared<pusher<char>>();
+	auto sp_po = make_shared<popper<char>>();
+
+	flow::graph g;
+
+	g.add(sp_pu1, "pusher1");
+	g.add(sp_pu2, "pusher2");
+	g.add(sp_po, "popper");
+
+	g.connect<char>(sp_pu1, 0, sp_po, 0, 0, max_weight * 2);
+
+	// The popper's pipe is handed over to the second pusher with a new maximum weight, the first pusher is disconnected.
+	g.connect<char>(sp_pu2, 0, sp_po, 0, 0, max_weight);
+
+	g.start();
+
+	if(sp_pu1->push('a'))
 	{
-		const char* types[] = { "start" };
-		b = connected(make_args(types, &argv[2], argc - 2));
+		return false;
 	}
-	else if(strcmp(argv[1], "count") == 0)
+
+	for(size_t i = 0; i != max_weight; ++i)
 	{
-		const char* types[] = { "count" };
-		b = count(make_args(types, &argv[2], argc - 2));
+		if(!sp_pu2->push('b'))
+		{
+			return false;
+		}
 	}
-	else if(strcmp(argv[1], "restart") == 0)
+
+	if(sp_pu2->push('b'))
 	{
-		const char* types[] = { "halt", "count" };
-		b = restart(make_args(types, &argv[2], argc - 2));
+		return false;
 	}
-	else if(strcmp(argv[1], "tee") == 0)
+
+	const flow::graph_metrics m = g.metrics();
+
+	return m.pipes.size() == 1 && m.pipes[0].name == "pusher2_out0_to_popper_in0" && m.pipes[0].pushed == max_weight;
+}
+
+bool pool(args_t args)
+{
+	size_t c = stoul(args["count"]);
+
+	unique_ptr<flow::packet<int>> leftover_p;
+
 	{
-		const char* types[] = { "count" };
-		b = tee(make_args(types, &argv[2], argc - 2));
+		auto sp_pu = make_shared<pusher<int>>();
+		auto sp_po = make_shared<popper<int>>();
+
+		flow::graph g;
+
+		g.add(sp_pu, "pusher");
+		g.add(sp_po, "popper");
+
+		g.connect<int>(sp_pu, 0, sp_po, 0);
+
+		g.start();
+
+		// Packets are consumed before the next one is made, only one should ever be allocated.
+		for(size_t i = 0; i != c; ++i)
+		{
+			sp_pu->push(static_cast<int>(i));
+
+			if(sp_po->pop()->data() != static_cast<int>(i))
+			{
+				return false;
+			}
+		}
+
+		if(sp_pu->pool().allocated() != 1)
+		{
+			return false;
+		}
+
+		// Keep a packet alive past the lifetime of the pool that made it.
+		sp_pu->push(11);
+		leftover_p = sp_po->pop();
 	}
-	else if(strcmp(argv[1], "reconnect") == 0)
+
+	return leftover_p->data() == 11;
+}
+
+bool metrics(args_t args)
+{
+	size_t max_length = stoul(args["length"]);
+
+	auto sp_pu = make_shared<pusher<int>>();
+	auto sp_po = make_shared<popper<int>>();
+
+	flow::graph g;
+
+	g.add(sp_pu, "pusher");
+	g.add(sp_po, "popper");
+
+	g.connect<int>(sp_pu, 0, sp_po, 0, max_length, 0, pipe_type(args));
+
+	g.start();
+
+	// Let the popper wait for a while.
+	this_thread::sleep_for(chrono::milliseconds(10));
+
+	for(size_t i = 0; i != max_length + 2; ++i)
 	{
-		const char* types[] = { "halt", "count" };
-		b = reconnect(make_args(types, &argv[2], argc - 2));
+		sp_pu->push(0);
 	}
-	else if(strcmp(argv[1], "add_delay") == 0)
+
+	for(size_t i = 0; i != max_length; ++i)
 	{
-		const char* types[] = { "" };
-		b = add_delay(make_args(types, &argv[2], argc - 2));
+		sp_po->pop();
 	}
-	else if(strcmp(argv[1], "add") == 0)
+
+	// Let the popper be woken up by the packets and go back to waiting.
+	this_thread::sleep_for(chrono::milliseconds(10));
+
+	flow::graph_metrics m = g.metrics();
+
+	if(m.nodes.size() != 2 || m.pipes.size() != 1)
 	{
-		const char* types[] = { "type", "count" };
-		b = add<void>(make_args(types, &argv[2], argc - 2));
+		return false;
 	}
-	else if(strcmp(argv[1], "const_add") == 0)
+
+	const flow::pipe_metrics &pm = m.pipes[0];
+	if(pm.name != "pusher_out0_to_popper_in0" || pm.pushed != max_length || pm.dropped != 2 || pm.high_water != max_length || pm.length != 0)
 	{
-		const char* types[] = { "type", "count" };
-		b = const_add<void>(make_args(types, &argv[2], argc - 2));
+		return false;
 	}
-	else if(strcmp(argv[1], "max_length") == 0)
+
+	for(auto& nm : m.nodes)
 	{
-		const char* types[] = { "length" };
-		b = max_length(make_args(types, &argv[2], argc - 2));
+		if(nm.name == "popper" && nm.waiting < chrono::milliseconds(5))
+		{
+			return false;
+		}
 	}
-	else if(strcmp(argv[1], "max_weight") == 0)
+
+	return true;
+}
+
+bool shared_tee(args_t args)
+{
+	size_t outs = stoul(args["outs"]);
+
+	typedef flow::shared<vector<int>> payload_t;
+
+	auto sp_pu = make_shared<pusher<payload_t>>();
+	auto sp_t = make_shared<flow::samples::generic::tee<payload_t>>(outs);
+	vector<shared_ptr<popper<payload_t>>> poppers;
+
+	flow::graph g;
+
+	g.add(sp_pu, "pusher");
+	g.add(sp_t, "tee");
+	g.connect<payload_t>(sp_pu, 0, sp_t, 0);
+
+	for(size_t i = 0; i != outs; ++i)
 	{
-		const char* types[] = { "weight" };
-		b = max_weight(make_args(types, &argv[2], argc - 2));
+		poppers.push_back(make_shared<popper<payload_t>>());
+		g.add(poppers.back(), "popper" + to_string(i));
+		g.connect<payload_t>(sp_t, i, poppers.back(), 0);
+	}
+
+	g.start();
+
+	sp_pu->push(payload_t(vector<int>(1000, 11)));
+
+	vector<unique_ptr<flow::packet<payload_t>>> packets;
+	for(auto& sp_po : poppers)
+	{
+		packets.push_back(sp_po->pop());
+	}
+
+	// All outputs carry the same buffer.
+	for(auto& packet_p : packets)
+	{
+		if(&packet_p->data().read() != &packets[0]->data().read())
+		{
+			return false;
+		}
+	}
+
+	// Writing to one copies it and leaves the others untouched.
+	const vector<int> *original_p = &packets[0]->data().read();
+	packets[0]->data().write()[0] = 22;
+
+	if(outs > 1 && (&packets[0]->data().read() == original_p || packets[1]->data().read()[0] != 11))
+	{
+		return false;
+	}
+
+	return packets[0]->data().read()[0] == 22 && packets[0]->data().unique();
+}
+
+bool overflow(args_t args)
+{
+	size_t max_length = stoul(args["length"]);
+	const string policy = args["policy"];
+
+	auto sp_pu = make_shared<pusher<int>>();
+	auto sp_po = make_shared<popper<int>>();
+
+	flow::graph g;
+
+	g.add(sp_pu, "pusher");
+	g.add(sp_po, "popper");
+
+	flow::overflow::type p = flow::overflow::reject;
+	if(policy == "drop_newest") p = flow::overflow::drop_newest;
+	else if(policy == "drop_oldest") p = flow::overflow::drop_oldest;
+	else if(policy == "block") p = flow::overflow::block;
+
+	g.connect<int>(sp_pu, 0, sp_po, 0, max_length, 0, pipe_type(args), p);
+
+	g.start();
+
+	if(p == flow::overflow::block)
+	{
+		// Push more than fits, the pusher waits for the popper to make room.
+		const int n = static_cast<int>(max_length) * 3;
+
+		bool pushed = true;
+		thread t([&]
+		{
+			for(int i = 0; i != n; ++i)
+			{
+				pushed = sp_pu->push(i) && pushed;
+			}
+		});
+
+		bool in_order = true;
+		for(int i = 0; i != n; ++i)
+		{
+			in_order = sp_po->pop()->data() == i && in_order;
+		}
+
+		t.join();
+
+		return pushed && in_order && g.metrics().pipes[0].dropped == 0;
+	}
+
+	// Fill the pipe, then push one too many.
+	for(int i = 0; i != static_cast<int>(max_length); ++i)
+	{
+		if(!sp_pu->push(i))
+		{
+			return false;
+		}
+	}
+
+	// The oldest packet makes room for the newest, unless the pipe cannot pop from the producing side.
+	const int first = (p == flow::overflow::drop_oldest && pipe_type(args) == flow::pipe_type::deque) ? 1 : 0;
+
+	if(sp_pu->push(static_cast<int>(max_length)) != (first == 1))
+	{
+		return false;
+	}
+
+	for(int i = first; i != first + static_cast<int>(max_length); ++i)
+	{
+		if(sp_po->pop()->data() != i)
+		{
+			return false;
+		}
+	}
+
+	return !sp_po->peek() && g.metrics().pipes[0].dropped == 1;
+}
+
+bool multirate(args_t args)
+{
+	size_t generators = stoul(args["generators"]);
+
+	flow::multirate_timer mt(chrono::milliseconds(10));
+
+	// A slow listener must not delay the others.
+	atomic<size_t> slow(0);
+	mt.listen([&slow]{ this_thread::sleep_for(chrono::milliseconds(5)); ++slow; });
+
+	flow::graph g;
+
+	auto sp_cc = make_shared<consumption_counter<int>>(generators);
+	g.add(sp_cc, "consumption_counter");
+
+	for(size_t i = 0; i != generators; ++i)
+	{
+		auto sp_g = make_shared<flow::samples::generic::generator<int>>(mt, chrono::milliseconds(10 * (1 + i % 3)), []{ return 0; });
+		g.add(sp_g, "generator" + to_string(i));
+		g.connect<int>(sp_g, 0, sp_cc, i);
+	}
+
+	g.start();
+
+	thread t(ref(mt));
+	this_thread::sleep_for(chrono::milliseconds(300));
+	mt.stop();
+	t.join();
+
+	g.stop();
+
+	// Leave room for a loaded machine, but not for a period that drifts by the time listeners take.
+	if(slow < 20 || slow > 31)
+	{
+		return false;
+	}
+
+	for(size_t i = 0; i != generators; ++i)
+	{
+		const size_t expected = 30 / (1 + i % 3);
+
+		if(sp_cc->count(i) < expected * 2 / 3 || sp_cc->count(i) > expected + 1)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Generators that are destroyed while their timer runs must not be called afterwards.
+bool multirate_churn(args_t args)
+{
+	size_t generators = stoul(args["generators"]);
+
+	flow::multirate_timer mt(chrono::milliseconds(1));
+	thread t(ref(mt));
+
+	for(size_t i = 0; i != generators; ++i)
+	{
+		vector<unique_ptr<flow::samples::generic::generator<int>>> gs;
+		for(size_t j = 0; j != 10; ++j)
+		{
+			gs.emplace_back(new flow::samples::generic::generator<int>(mt, chrono::milliseconds(1), []{ return 0; }));
+		}
+
+		this_thread::sleep_for(chrono::milliseconds(2));
+	}
+
+	// Ignoring waits for a call in progress, so a slow listener always finishes before it is ignored.
+	atomic<bool> ignored(false), late(false), called(false);
+	const size_t token = mt.listen([&]{ called = true; this_thread::sleep_for(chrono::milliseconds(20)); if(ignored) late = true; });
+
+	while(!called)
+	{
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+
+	mt.ignore(token);
+	ignored = true;
+
+	mt.stop();
+	t.join();
+
+	return !late;
+}
+
+bool deliver(args_t args)
+{
+	size_t deliverers = stoul(args["deliverers"]);
+
+	typedef flow::packet<int>::time_point_type time_point_type;
+
+	flow::delivery d;
+
+	flow::graph g;
+
+	vector<shared_ptr<pusher<int>>> pushers;
+	vector<shared_ptr<flow::samples::generic::deliverer<int>>> delivs;
+	vector<shared_ptr<popper<int>>> poppers;
+
+	for(size_t i = 0; i != deliverers; ++i)
+	{
+		pushers.push_back(make_shared<pusher<int>>());
+		delivs.push_back(make_shared<flow::samples::generic::deliverer<int>>(d));
+		poppers.push_back(make_shared<popper<int>>());
+
+		g.add(pushers.back(), "pusher" + to_string(i));
+		g.add(delivs.back(), "deliverer" + to_string(i));
+		g.add(poppers.back(), "popper" + to_string(i));
+
+		g.connect<int>(pushers.back(), 0, delivs.back(), 0);
+		g.connect<int>(delivs.back(), 0, poppers.back(), 0, 0, 0, pipe_type(args));
+	}
+
+	g.start();
+
+	thread t(ref(d));
+
+	const time_point_type now = chrono::high_resolution_clock::now();
+	vector<time_point_type> due(4, time_point_type());
+	due[1] = now + chrono::milliseconds(100);
+	due[2] = now + chrono::milliseconds(200);
+	due[3] = now + chrono::milliseconds(300);
+
+	// Out of order, plus one packet with no consumption time and one that is already late.
+	for(auto& sp_pu : pushers)
+	{
+		sp_pu->push(3, due[3]);
+		sp_pu->push(1, due[1]);
+		sp_pu->push(-1, now - chrono::seconds(1));
+		sp_pu->push(2, due[2]);
+		sp_pu->push(0);
+	}
+
+	bool b = true;
+	for(size_t i = 0; i != deliverers; ++i)
+	{
+		for(int j = 0; j != 4; ++j)
+		{
+			const int k = poppers[i]->pop()->data();
+
+			b = k == j && chrono::high_resolution_clock::now() >= due[j] && b;
+		}
+
+		b = !poppers[i]->peek() && delivs[i]->late() == 1 && delivs[i]->pending() == 0 && b;
+	}
+
+	d.stop();
+	t.join();
+
+	g.stop();
+
+	return b;
+}
+
+bool slim(args_t args)
+{
+	size_t n = stoul(args["packets"]);
+
+	if(sizeof(flow::packet<tick>) != sizeof(tick) || is_polymorphic<flow::packet<tick>>::value || !is_polymorphic<flow::packet<int>>::value)
+	{
+		return false;
+	}
+
+	auto sp_pu = make_shared<pusher<tick>>();
+	auto sp_po = make_shared<popper<tick>>();
+
+	flow::graph g("graph", execution(args));
+
+	g.add(sp_pu, "pusher");
+	g.add(sp_po, "popper");
+	g.connect<tick>(sp_pu, 0, sp_po, 0, 0, 0, pipe_type(args));
+
+	// Slim packets are smaller than the link that chains free blocks.
+	sp_pu->pool().reserve(2);
+
+	g.start();
+
+	for(size_t i = 0; i != n; ++i)
+	{
+		tick t = { static_cast<int>(i) };
+		sp_pu->push(t);
+	}
+
+	for(size_t i = 0; i != n; ++i)
+	{
+		unique_ptr<flow::packet<tick>> packet_p = sp_po->pop();
+
+		if(packet_p->data().value != static_cast<int>(i) || packet_p->consumption_time() != flow::packet<tick>::time_point_type())
+		{
+			return false;
+		}
+	}
+
+	// The blocks of deleted packets are reused.
+	const size_t allocated = sp_pu->pool().allocated();
+	for(size_t i = 0; i != n; ++i)
+	{
+		tick t = { static_cast<int>(i) };
+		sp_pu->push(t);
+
+		if(sp_po->pop()->data().value != static_cast<int>(i))
+		{
+			return false;
+		}
+	}
+
+	return sp_pu->pool().allocated() == allocated;
+}
+
+bool static_pipeline(args_t args)
+{
+	size_t n = stoul(args["packets"]);
+
+	auto increment = [](int i){ return i + 1; };
+	auto twice = [](int i){ return i * 2; };
+
+	// On the calling thread.
+	auto p = flow::pipeline(increment, twice, [](int i){ return to_string(i); });
+	if(p(3) != "8" || p.size() != 3)
+	{
+		return false;
+	}
+
+	// Within a graph.
+	atomic<size_t> consumed(0);
+
+	auto sp_pu = make_shared<pusher<int>>();
+	auto sp_t = flow::make_transformer<int>(flow::pipeline(increment, twice));
+	auto sp_tee = make_shared<flow::samples::generic::tee<int>>(2);
+	auto sp_s = flow::make_transformer<int>(flow::pipeline([](int i){ return to_string(i); }));
+	auto sp_c = flow::make_consumer<int>(flow::pipeline(increment, [&consumed](int){ ++consumed; }));
+	auto sp_po = make_shared<popper<string>>();
+
+	flow::graph g;
+
+	g.add(sp_pu, "pusher");
+	g.add(sp_t, "transformer");
+	g.add(sp_tee, "tee");
+	g.add(sp_s, "stringifier");
+	g.add(sp_c, "consumer");
+	g.add(sp_po, "popper");
+
+	g.connect<int>(sp_pu, 0, sp_t, 0);
+	g.connect<int>(sp_t, 0, sp_tee, 0);
+	g.connect<int>(sp_tee, 0, sp_s, 0);
+	g.connect<int>(sp_tee, 1, sp_c, 0);
+	g.connect<string>(sp_s, 0, sp_po, 0);
+
+	g.start();
+
+	for(size_t i = 0; i != n; ++i)
+	{
+		sp_pu->push(static_cast<int>(i));
+	}
+
+	for(size_t i = 0; i != n; ++i)
+	{
+		if(sp_po->pop()->data() != to_string((i + 1) * 2))
+		{
+			return false;
+		}
+	}
+
+	while(consumed != n)
+	{
+		this_thread::yield();
+	}
+
+	return true;
+}
+
+bool batches(args_t args)
+{
+	size_t values = stoul(args["values"]);
+
+	typedef flow::batch<float, 64> batch_t;
+
+	{
+		// (2 + 3 + 1) * values
+		auto sp_pu1 = make_shared<pusher<batch_t>>();
+		auto sp_pu2 = make_shared<pusher<batch_t>>();
+		auto sp_a = make_shared<flow::samples::math::adder<batch_t>>(2);
+		auto sp_ca = make_shared<flow::samples::math::const_adder<batch_t>>(batch_t(values, 1.f));
+		auto sp_r = make_shared<flow::samples::math::reducer<batch_t>>();
+		auto sp_po = make_shared<popper<float>>();
+
+		flow::graph g;
+
+		g.add(sp_pu1, "pusher1");
+		g.add(sp_pu2, "pusher2");
+		g.add(sp_a, "adder");
+		g.add(sp_ca, "const_adder");
+		g.add(sp_r, "reducer");
+		g.add(sp_po, "popper");
+
+		g.connect<batch_t>(sp_pu1, 0, sp_a, 0);
+		g.connect<batch_t>(sp_pu2, 0, sp_a, 1);
+		g.connect<batch_t>(sp_a, 0, sp_ca, 0);
+		g.connect<batch_t>(sp_ca, 0, sp_r, 0);
+		g.connect<float>(sp_r, 0, sp_po, 0);
+
+		g.start();
+
+		sp_pu1->push(batch_t(values, 2.f));
+		sp_pu2->push(batch_t(values, 3.f));
+
+		if(sp_po->pop()->data() != 6.f * values)
+		{
+			return false;
+		}
+	}
+
+	{
+		// 2 * 3 * 0.5
+		auto sp_pu1 = make_shared<pusher<batch_t>>();
+		auto sp_pu2 = make_shared<pusher<batch_t>>();
+		auto sp_m = make_shared<flow::samples::math::multiplier<batch_t>>(2);
+		auto sp_s = make_shared<flow::samples::math::scaler<batch_t, float>>(0.5f);
+		auto sp_po = make_shared<popper<batch_t>>();
+
+		flow::graph g;
+
+		g.add(sp_pu1, "pusher1");
+		g.add(sp_pu2, "pusher2");
+		g.add(sp_m, "multiplier");
+		g.add(sp_s, "scaler");
+		g.add(sp_po, "popper");
+
+		g.connect<batch_t>(sp_pu1, 0, sp_m, 0);
+		g.connect<batch_t>(sp_pu2, 0, sp_m, 1);
+		g.connect<batch_t>(sp_m, 0, sp_s, 0);
+		g.connect<batch_t>(sp_s, 0, sp_po, 0);
+
+		g.start();
+
+		sp_pu1->push(batch_t(values, 2.f));
+		sp_pu2->push(batch_t(values, 3.f));
+
+		unique_ptr<flow::packet<batch_t>> packet_p = sp_po->pop();
+		if(packet_p->data().size() != values)
+		{
+			return false;
+		}
+
+		for(auto v : packet_p->data())
+		{
+			if(v != 3.f)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool affinity(args_t args)
+{
+	size_t n = stoul(args["count"]);
+
+	auto sp_pn = make_shared<produce_n<int>>(n);
+	auto sp_tc = make_shared<transformation_counter<int>>();
+	auto sp_cc = make_shared<consumption_counter<int>>();
+
+	flow::graph g("graph", execution(args));
+
+	g.add(sp_pn);
+	g.add(sp_tc);
+	g.add(sp_cc);
+
+	g.connect<int>(sp_pn, 0, sp_tc, 0);
+	g.connect<int>(sp_tc, 0, sp_cc, 0);
+
+	const flow::cpus_t first = { 0 };
+
+	// Pinning only fails for unknown nodes and where it is not supported.
+	if(g.pin("nonexistent", first) || g.pin(sp_tc->name(), first) != flow::affinity_supported())
+	{
+		return false;
+	}
+
+	if(execution(args) == flow::execution::pooled && (g.pin_worker(0, first) != flow::affinity_supported() || g.pin_worker(1000, first)))
+	{
+		return false;
+	}
+
+	if(execution(args) == flow::execution::threaded && g.pin_worker(0, first))
+	{
+		return false;
+	}
+
+	g.start();
+
+	this_thread::sleep_for(chrono::milliseconds(100));
+
+	// Everything fits in a single domain.
+	g.place(vector<flow::cpus_t>(1, first));
+
+	g.pause();
+
+	if(sp_tc->count(0) != n || sp_cc->count(0) != n)
+	{
+		return false;
+	}
+
+	if(flow::affinity_supported())
+	{
+		for(auto name : { sp_pn->name(), sp_tc->name(), sp_cc->name() })
+		{
+			if(g.affinity(name) != first)
+			{
+				return false;
+			}
+		}
+	}
+
+	// The affinities still apply once restarted.
+	sp_pn->reset();
+	sp_tc->reset();
+	sp_cc->reset();
+
+	g.start();
+
+	this_thread::sleep_for(chrono::milliseconds(100));
+
+	g.stop();
+
+	return sp_tc->count(0) == n && sp_cc->count(0) == n;
+}
+
+// A fixed-layout record, as found in capture files.
+struct capture
+{
+	unsigned id;
+	float value;
+};
+
+// The whole contents of a file.
+string slurp(const string& path)
+{
+	ifstream file(path.c_str(), ios::binary);
+	ostringstream oss;
+	oss << file.rdbuf();
+
+	return oss.str();
+}
+
+// Flushes a file_sink until it has written a number of bytes or a few seconds went by.
+template<typename T>
+bool written(flow::samples::io::file_sink<T>& sink_r, const size_t bytes)
+{
+	for(int i = 0; i != 500 && sink_r.written() < bytes; ++i)
+	{
+		this_thread::sleep_for(chrono::milliseconds(10));
+		sink_r.flush();
+	}
+
+	return sink_r.written() == bytes;
+}
+
+bool files(args_t args)
+{
+	size_t n = stoul(args["records"]);
+	size_t per_packet = stoul(args["per_packet"]);
+
+	typedef flow::samples::io::records<capture> records_t;
+
+	const string in = "files_" + to_string(n) + "_" + to_string(per_packet) + ".in";
+	const string out = "files_" + to_string(n) + "_" + to_string(per_packet) + ".out";
+
+	{
+		ofstream file(in.c_str(), ios::binary);
+		for(size_t i = 0; i != n; ++i)
+		{
+			const capture c = { static_cast<unsigned>(i), i * 0.5f };
+			file.write(reinterpret_cast<const char*>(&c), sizeof(c));
+		}
+		// A partial record, ignored.
+		file.put('x');
+	}
+
+	if(flow::samples::io::mapped_source<capture>("nonexistent").is_open())
+	{
+		return false;
+	}
+
+	// The records reference the mapping, which outlives the source.
+	unique_ptr<flow::packet<records_t>> first_p;
+	{
+		auto sp_ms = make_shared<flow::samples::io::mapped_source<capture>>(in, per_packet);
+		auto sp_po = make_shared<popper<records_t>>();
+
+		if(!sp_ms->is_open() || sp_ms->size() != n)
+		{
+			return false;
+		}
+
+		flow::graph g;
+
+		g.add(sp_ms, "mapped_source");
+		g.add(sp_po, "popper");
+
+		g.connect<records_t>(sp_ms, 0, sp_po, 0);
+
+		g.start();
+
+		for(size_t i = 0; i != n;)
+		{
+			unique_ptr<flow::packet<records_t>> packet_p = sp_po->pop();
+			if(packet_p->data().empty() || packet_p->data().size() > per_packet)
+			{
+				return false;
+			}
+
+			for(auto& c : packet_p->data())
+			{
+				if(c.id != i++)
+				{
+					return false;
+				}
+			}
+
+			if(!first_p) first_p = move(packet_p);
+		}
+
+		g.stop();
+	}
+
+	if(first_p->data()[0].id != 0 || first_p->data()[first_p->data().size() - 1].value != (first_p->data().size() - 1) * 0.5f)
+	{
+		return false;
+	}
+
+	const string expected = slurp(in).substr(0, n * sizeof(capture));
+
+	// Ranges of records go straight back to a file.
+	{
+		auto sp_ms = make_shared<flow::samples::io::mapped_source<capture>>(in, per_packet);
+		auto sp_fs = make_shared<flow::samples::io::file_sink<records_t>>(out, 7 * sizeof(capture));
+
+		flow::graph g;
+
+		g.add(sp_ms, "mapped_source");
+		g.add(sp_fs, "file_sink");
+
+		g.connect<records_t>(sp_ms, 0, sp_fs, 0);
+
+		g.start();
+
+		const bool b = written(*sp_fs, expected.size());
+
+		g.stop();
+
+		if(!b || !sp_fs->good() || slurp(out) != expected)
+		{
+			return false;
+		}
+	}
+
+	// So do single records.
+	{
+		auto sp_pu = make_shared<pusher<capture>>();
+		auto sp_fs = make_shared<flow::samples::io::file_sink<capture>>(out);
+
+		flow::graph g;
+
+		g.add(sp_pu, "pusher");
+		g.add(sp_fs, "file_sink");
+
+		g.connect<capture>(sp_pu, 0, sp_fs, 0);
+
+		g.start();
+
+		for(size_t i = 0; i != n; ++i)
+		{
+			const capture c = { static_cast<unsigned>(i), i * 0.5f };
+			sp_pu->push(c);
+		}
+
+		const bool b = written(*sp_fs, expected.size());
+
+		g.stop();
+
+		if(!b || slurp(out) != expected)
+		{
+			return false;
+		}
+	}
+
+	remove(in.c_str());
+	remove(out.c_str());
+
+	return true;
+}
+
+bool buffered(args_t args)
+{
+	size_t n = stoul(args["packets"]);
+
+	ostringstream expected;
+	for(size_t i = 0; i != n; ++i)
+	{
+		expected << i << '\n';
+	}
+
+	// Written out buffer by buffer.
+	{
+		ostringstream oss;
+
+		auto sp_pu = make_shared<pusher<size_t>>();
+		auto sp_bo = make_shared<flow::samples::generic::buffered_ostreamer<size_t>>(oss, 16, chrono::hours(1));
+
+		flow::graph g("graph", execution(args));
+
+		g.add(sp_pu, "pusher");
+		g.add(sp_bo, "buffered_ostreamer");
+
+		g.connect<size_t>(sp_pu, 0, sp_bo, 0);
+
+		g.start();
+
+		for(size_t i = 0; i != n; ++i)
+		{
+			sp_pu->push(i);
+		}
+
+		// Pausing hands over the last buffer, which is not full.
+		for(int i = 0; i != 500 && sp_bo->written() != expected.str().size(); ++i)
+		{
+			this_thread::sleep_for(chrono::milliseconds(10));
+
+			if(i == 10) g.pause();
+		}
+
+		g.stop();
+
+		if(oss.str() != expected.str())
+		{
+			return false;
+		}
+	}
+
+	// Written out when the interval has passed even though the buffer is far from full.
+	{
+		ostringstream oss;
+
+		auto sp_pu = make_shared<pusher<size_t>>();
+		auto sp_bo = make_shared<flow::samples::generic::buffered_ostreamer<size_t>>(oss, 1 << 20, chrono::milliseconds(20));
+
+		flow::graph g("graph", execution(args));
+
+		g.add(sp_pu, "pusher");
+		g.add(sp_bo, "buffered_ostreamer");
+
+		g.connect<size_t>(sp_pu, 0, sp_bo, 0);
+
+		g.start();
+
+		sp_pu->push(n);
+
+		for(int i = 0; i != 500 && !sp_bo->written(); ++i)
+		{
+			this_thread::sleep_for(chrono::milliseconds(10));
+		}
+
+		if(!sp_bo->written())
+		{
+			return false;
+		}
+
+		// And on demand.
+		sp_pu->push(n);
+
+		const string twice = to_string(n) + '\n' + to_string(n) + '\n';
+		for(int i = 0; i != 500 && sp_bo->written() != twice.size(); ++i)
+		{
+			this_thread::sleep_for(chrono::milliseconds(1));
+			sp_bo->flush();
+		}
+
+		g.stop();
+
+		if(oss.str() != twice)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool joins(args_t args)
+{
+	size_t ins = stoul(args["ins"]);
+	size_t packets = stoul(args["packets"]);
+
+	// Every input gets its packets in bursts of different lengths.
+	{
+		auto sp_a = make_shared<flow::samples::math::adder<size_t>>(ins);
+		auto sp_po = make_shared<popper<size_t>>();
+		vector<shared_ptr<pusher<size_t>>> pushers;
+
+		flow::graph g("graph", execution(args));
+
+		g.add(sp_a, "adder");
+		g.add(sp_po, "popper");
+		g.connect<size_t>(sp_a, 0, sp_po, 0);
+
+		for(size_t i = 0; i != ins; ++i)
+		{
+			pushers.push_back(make_shared<pusher<size_t>>());
+			g.add(pushers.back(), "pusher" + to_string(i));
+			g.connect<size_t>(pushers.back(), 0, sp_a, i);
+		}
+
+		g.start();
+
+		vector<size_t> pushed(ins, 0);
+		for(size_t burst = 1; pushed[0] != packets; ++burst)
+		{
+			for(size_t i = 0; i != ins; ++i)
+			{
+				for(size_t j = 0; j != (burst + i) % 4 && pushed[i] != packets; ++j)
+				{
+					pushers[i]->push(pushed[i]++);
+				}
+			}
+		}
+		for(size_t i = 0; i != ins; ++i)
+		{
+			while(pushed[i] != packets)
+			{
+				pushers[i]->push(pushed[i]++);
+			}
+		}
+
+		// The n-th packets of all inputs are summed together.
+		for(size_t n = 0; n != packets; ++n)
+		{
+			if(sp_po->pop()->data() != n * ins)
+			{
+				return false;
+			}
+		}
+
+		g.stop();
+
+		if(sp_po->peek() || sp_a->unmatched())
+		{
+			return false;
+		}
+	}
+
+	// Only packets with the same consumption time are multiplied together.
+	{
+		auto sp_m = make_shared<flow::samples::math::multiplier<size_t>>(ins, "multiplier", flow::alignment::timestamp);
+		auto sp_po = make_shared<popper<size_t>>();
+		vector<shared_ptr<pusher<size_t>>> pushers;
+
+		flow::graph g("graph", execution(args));
+
+		g.add(sp_m, "multiplier");
+		g.add(sp_po, "popper");
+		g.connect<size_t>(sp_m, 0, sp_po, 0);
+
+		for(size_t i = 0; i != ins; ++i)
+		{
+			pushers.push_back(make_shared<pusher<size_t>>());
+			g.add(pushers.back(), "pusher" + to_string(i));
+			g.connect<size_t>(pushers.back(), 0, sp_m, i);
+		}
+
+		g.start();
+
+		// Input i misses the packets whose index is i modulo 4, except the last one.
+		const flow::packet<size_t>::time_point_type epoch;
+		size_t missing = 0;
+		for(size_t i = 0; i != ins; ++i)
+		{
+			for(size_t n = 0; n <= packets; ++n)
+			{
+				if(n != packets && n % 4 == i % 4 && ins > 1)
+				{
+					++missing;
+					continue;
+				}
+
+				pushers[i]->push(1 + (i == 0 ? n : 0), epoch + chrono::hours(1 + n));
+			}
+		}
+
+		// With 4 inputs or more, only the last packets are complete on all inputs.
+		for(size_t n = 0; n <= packets; ++n)
+		{
+			bool complete = true;
+			for(size_t i = 0; i != ins && ins > 1; ++i)
+			{
+				complete = complete && (n == packets || n % 4 != i % 4);
+			}
+
+			if(complete)
+			{
+				unique_ptr<flow::packet<size_t>> packet_p = sp_po->pop();
+				if(packet_p->data() != 1 + n || packet_p->consumption_time() != epoch + chrono::hours(1 + n))
+				{
+					return false;
+				}
+			}
+		}
+
+		g.stop();
+
+		if(sp_po->peek() || (missing && !sp_m->unmatched()))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// A pass-through transformer that counts the times it was stopped.
+class watched : public flow::transformer<int, int>
+{
+	atomic<size_t> d_stops_a;
+
+public:
+	watched() : flow::node("watched"), flow::transformer<int, int>("watched", 1, 1), d_stops_a(0) {}
+
+	virtual void stopped()
+	{
+		++d_stops_a;
+	}
+
+	virtual void ready(size_t)
+	{
+		auto packet_p(flow::consumer<int>::input(0).pop());
+		flow::producer<int>::output(0).push(packet_p);
+	}
+
+	size_t stops() const
+	{
+		return d_stops_a;
+	}
+};
+
+bool update(args_t args)
+{
+	size_t n = stoul(args["count"]);
+
+	// The subgraph to redeploy.
+	auto sp_pu = make_shared<pusher<int>>();
+	auto sp_t0 = make_shared<watched>();
+	auto sp_t1 = make_shared<watched>();
+	auto sp_po = make_shared<popper<int>>();
+
+	// The subgraph that keeps streaming.
+	auto sp_steady_pu = make_shared<pusher<int>>();
+	auto sp_steady_t0 = make_shared<watched>();
+	auto sp_steady_t1 = make_shared<watched>();
+	auto sp_steady_po = make_shared<popper<int>>();
+
+	flow::graph g("graph", execution(args));
+
+	g.add(sp_pu, "pusher");
+	g.add(sp_t0, "t0");
+	g.add(sp_t1, "t1");
+	g.add(sp_po, "popper");
+	g.connect<int>(sp_pu, 0, sp_t0, 0);
+	g.connect<int>(sp_t0, 0, sp_t1, 0);
+	g.connect<int>(sp_t1, 0, sp_po, 0);
+
+	g.add(sp_steady_pu, "steady_pusher");
+	g.add(sp_steady_t0, "steady_t0");
+	g.add(sp_steady_t1, "steady_t1");
+	g.add(sp_steady_po, "steady_popper");
+	g.connect<int>(sp_steady_pu, 0, sp_steady_t0, 0);
+	g.connect<int>(sp_steady_t0, 0, sp_steady_t1, 0);
+	g.connect<int>(sp_steady_t1, 0, sp_steady_po, 0);
+
+	g.start();
+
+	auto stream = [n](pusher<int>& pusher_r, popper<int>& popper_r)
+	{
+		for(size_t i = 0; i != n; ++i)
+		{
+			pusher_r.push(static_cast<int>(i));
+		}
+
+		for(size_t i = 0; i != n; ++i)
+		{
+			if(popper_r.pop()->data() != static_cast<int>(i)) return false;
+		}
+
+		return true;
+	};
+
+	if(!stream(*sp_pu, *sp_po) || !stream(*sp_steady_pu, *sp_steady_po))
+	{
+		return false;
+	}
+
+	// Rejected as a whole: the last change names a node that does not exist.
+	{
+		flow::graph::update u;
+		u.remove("t1");
+		u.connect<int>("t0", 0, "nonexistent", 0);
+
+		if(g.apply(u) || g.epoch() != 0 || !stream(*sp_pu, *sp_po))
+		{
+			return false;
+		}
+	}
+
+	// Rejected: the pins carry ints and there is no second outpin.
+	{
+		flow::graph::update u;
+		u.connect<double>("t0", 0, "popper", 0);
+
+		flow::graph::update v;
+		v.connect<int>("t0", 1, "popper", 0);
+
+		if(g.apply(u) || g.apply(v) || !g.apply(flow::graph::update()) || g.epoch() != 1)
+		{
+			return false;
+		}
+	}
+
+	// Replace t1 while packets keep flowing in the other subgraph.
+	auto sp_t2 = make_shared<watched>();
+	{
+		flow::graph::update u;
+		u.remove("t1");
+		u.add(sp_t2, "t2");
+		u.connect<int>("t0", 0, "t2", 0);
+		u.connect<int>("t2", 0, "popper", 0);
+
+		thread steady([&]{ for(int r = 0; r != 10; ++r) if(!stream(*sp_steady_pu, *sp_steady_po)) return; });
+
+		const bool applied = g.apply(u);
+
+		steady.join();
+
+		if(!applied || g.epoch() != 2)
+		{
+			return false;
+		}
+	}
+
+	if(!stream(*sp_pu, *sp_po) || !stream(*sp_steady_pu, *sp_steady_po))
+	{
+		return false;
+	}
+
+	// Only the touched nodes were stopped. The removed node is disconnected.
+	if(sp_steady_t0->stops() || sp_steady_t1->stops() || !sp_t1->stops() || sp_t2->stops() || sp_t1->input(0).peek())
+	{
+		return false;
+	}
+
+	// An added node can be removed right away by a later update.
+	{
+		flow::graph::update u;
+		u.disconnect<int>(static_pointer_cast<flow::producer<int>>(sp_t0), 0);
+		u.remove("t2");
+		u.connect<int>("t0", 0, "popper", 0);
+
+		if(!g.apply(u) || !stream(*sp_pu, *sp_po))
+		{
+			return false;
+		}
+	}
+
+	g.stop();
+
+	return true;
+}
+
+// Counts the packets it consumes, slowly.
+class sluggish : public flow::consumer<int>
+{
+	atomic<size_t> d_consumed_a;
+
+public:
+	sluggish() : flow::node("sluggish"), flow::consumer<int>("sluggish", 1), d_consumed_a(0) {}
+
+	virtual void ready(size_t)
+	{
+		flow::consumer<int>::input(0).pop();
+		this_thread::sleep_for(chrono::milliseconds(1));
+		++d_consumed_a;
+	}
+
+	size_t consumed() const
+	{
+		return d_consumed_a;
+	}
+};
+
+bool drain(args_t args)
+{
+	size_t n = stoul(args["count"]);
+
+	// Every packet in flight reaches the consumer.
+	{
+		auto sp_pu = make_shared<pusher<int>>();
+		auto sp_t0 = make_shared<transformation_counter<int>>();
+		auto sp_t1 = make_shared<transformation_counter<int>>();
+		auto sp_s = make_shared<sluggish>();
+
+		flow::graph g("graph", execution(args));
+
+		g.add(sp_pu, "pusher");
+		g.add(sp_t0, "t0");
+		g.add(sp_t1, "t1");
+		g.add(sp_s, "sluggish");
+		g.connect<int>(sp_pu, 0, sp_t0, 0);
+		g.connect<int>(sp_t0, 0, sp_t1, 0);
+		g.connect<int>(sp_t1, 0, sp_s, 0);
+
+		g.start();
+
+		for(size_t i = 0; i != n; ++i)
+		{
+			sp_pu->push(static_cast<int>(i));
+		}
+
+		flow::drain_report r = g.drain(chrono::seconds(30));
+
+		if(!r.complete || r.left || !r.pipes.empty() || sp_s->consumed() != n)
+		{
+			return false;
+		}
+	}
+
+	// A consumer waiting for a consumption time far in the future does not hold up the shutdown for longer than the timeout.
+	{
+		ostringstream oss;
+
+		auto sp_pu = make_shared<pusher<int>>();
+		auto sp_o = make_shared<flow::samples::generic::ostreamer<int>>(oss);
+
+		flow::graph g("graph", execution(args));
+
+		g.add(sp_pu, "pusher");
+		g.add(sp_o, "ostreamer");
+		g.connect<int>(sp_pu, 0, sp_o, 0);
+
+		g.start();
+
+		for(size_t i = 0; i != n; ++i)
+		{
+			sp_pu->push(static_cast<int>(i), chrono::high_resolution_clock::now() + chrono::hours(1));
+		}
+
+		// Let the ostreamer start waiting on the first packet.
+		this_thread::sleep_for(chrono::milliseconds(50));
+
+		flow::drain_report r = g.drain(chrono::milliseconds(100));
+
+		// The packet the ostreamer waits on is held inside the node, not in a pipe.
+		if(r.complete != (n == 1) || r.elapsed > chrono::seconds(10) || r.left != n - 1 || r.pipes.size() != (n > 1 ? 1u : 0u) || !oss.str().empty())
+		{
+			return false;
+		}
+	}
+
+	// The same, draining as soon as the packets are pushed so the ostreamer may be stopped before it starts waiting.
+	{
+		ostringstream oss;
+
+		auto sp_pu = make_shared<pusher<int>>();
+		auto sp_o = make_shared<flow::samples::generic::ostreamer<int>>(oss);
+
+		flow::graph g("graph", execution(args));
+
+		g.add(sp_pu, "pusher");
+		g.add(sp_o, "ostreamer");
+		g.connect<int>(sp_pu, 0, sp_o, 0);
+
+		g.start();
+
+		for(size_t i = 0; i != n; ++i)
+		{
+			sp_pu->push(static_cast<int>(i), chrono::high_resolution_clock::now() + chrono::hours(1));
+		}
+
+		flow::drain_report r = g.drain(chrono::milliseconds(100));
+
+		if(r.elapsed > chrono::seconds(10) || !oss.str().empty())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool shm(args_t args)
+{
+#if defined(FLOW_SHM_SUPPORTED)
+	size_t n = stoul(args["count"]);
+
+	const string segment = "/flow_functional_" + to_string(getpid());
+
+	// A sink whose segment could not be opened drops what it is given.
+	{
+		flow::shm_sink<int> sink("/bad/name/with/slashes");
+		flow::pipe<int>::packets_t packets;
+		packets.emplace_back(new flow::packet<int>(0));
+		packets.emplace_back(new flow::packet<int>(1));
+		sink.ready_batch(0, packets);
+
+		int i;
+		if(sink.is_open() || sink.dropped() != 2 || flow::shm_ring<int>("/bad/name/with/slashes", flow::shm_end::reader).pop(i))
+		{
+			return false;
+		}
+	}
+
+	// Records wrap around a small ring and an end that opens the segment with another record type is refused.
+	{
+		flow::shm_ring<tick> writer(segment, flow::shm_end::writer, 3), reader(segment, flow::shm_end::reader);
+
+		if(!writer.is_open() || !reader.is_open() || reader.capacity() != 4 || flow::shm_ring<capture>(segment, flow::shm_end::reader).is_open())
+		{
+			return false;
+		}
+
+		for(size_t i = 0; i != n; ++i)
+		{
+			const tick t = { static_cast<int>(i) };
+			tick r;
+
+			if(!writer.push(t) || reader.length() != 1 || !reader.pop(r) || r.value != t.value)
+			{
+				return false;
+			}
+		}
+
+		for(int i = 0; i != 4; ++i)
+		{
+			const tick t = { i };
+			if(!writer.push(t)) return false;
+		}
+
+		tick r;
+		const tick t = { 4 };
+		if(writer.push(t, chrono::milliseconds(5)) || !reader.pop(r) || r.value != 0 || !writer.push(t))
+		{
+			return false;
+		}
+	}
+
+	// Both ends came and went, so the segment is gone.
+	if(flow::shm_ring<tick>::unlink(segment))
+	{
+		return false;
+	}
+
+	// A graph in a child process feeds a graph in this one, through a ring smaller than the number of packets.
+	const pid_t pid = fork();
+	if(pid == 0)
+	{
+		bool b;
+		{
+			auto sp_pu = make_shared<pusher<tick>>();
+
+			flow::graph g("graph", execution(args));
+
+			g.add(sp_pu, "pusher");
+			b = g.connect<tick>(sp_pu, 0, segment, 16);
+
+			g.start();
+
+			for(size_t i = 0; i != n; ++i)
+			{
+				const tick t = { static_cast<int>(i) };
+				sp_pu->push(t);
+			}
+
+			b = g.drain(chrono::seconds(30)).complete && b;
+		}
+
+		_exit(b ? 0 : 1);
+	}
+
+	bool b = pid != -1;
+	{
+		auto sp_po = make_shared<popper<tick>>();
+
+		flow::graph g("graph", execution(args));
+
+		g.add(sp_po, "popper");
+
+		if(b && g.connect<tick>(segment, sp_po, 0, 16))
+		{
+			g.start();
+
+			for(size_t i = 0; i != n && b; ++i)
+			{
+				b = sp_po->pop()->data().value == static_cast<int>(i);
+			}
+
+			g.stop();
+		}
+		else
+		{
+			b = false;
+		}
+	}
+
+	int status = 0;
+	if(pid != -1 && (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0))
+	{
+		b = false;
+	}
+
+	flow::shm_ring<tick>::unlink(segment);
+
+	return b;
+#else
+	return true;
+#endif
+}
+
+bool net(args_t args)
+{
+#if defined(FLOW_NET_SUPPORTED)
+	size_t n = stoul(args["count"]);
+
+	// Records cross in order, over a window smaller than the number of packets.
+	{
+		auto sp_pu = make_shared<pusher<tick>>();
+		auto sp_ns = make_shared<flow::net_source<tick>>(0, 8);
+		auto sp_po = make_shared<popper<tick>>();
+
+		if(!sp_ns->is_open() || !sp_ns->port())
+		{
+			return false;
+		}
+
+		auto sp_nk = make_shared<flow::net_sink<tick>>("127.0.0.1", sp_ns->port());
+
+		flow::graph sending("sending", execution(args)), receiving("receiving", execution(args));
+
+		sending.add(sp_pu, "pusher");
+		sending.add(sp_nk, "net_sink");
+		sending.connect<tick>(sp_pu, 0, sp_nk, 0);
+
+		receiving.add(sp_ns, "net_source");
+		receiving.add(sp_po, "popper");
+		receiving.connect<tick>(sp_ns, 0, sp_po, 0);
+
+		ostringstream dot;
+		sending.to_dot(dot);
+		receiving.to_dot(dot);
+		if(dot.str().find("net_sink -> \"tcp://127.0.0.1:" + to_string(sp_ns->port()) + "\"") == string::npos ||
+		   dot.str().find("\"tcp://*:" + to_string(sp_ns->port()) + "\" -> net_source") == string::npos)
+		{
+			return false;
+		}
+
+		receiving.start();
+		sending.start();
+
+		for(size_t i = 0; i != n; ++i)
+		{
+			const tick t = { static_cast<int>(i) };
+			sp_pu->push(t);
+		}
+
+		for(size_t i = 0; i != n; ++i)
+		{
+			if(sp_po->pop()->data().value != static_cast<int>(i))
+			{
+				return false;
+			}
+		}
+
+		sending.stop();
+		receiving.stop();
+
+		if(sp_nk->sent() != n || sp_ns->received() != n || sp_nk->dropped() || !sp_nk->frames() || sp_nk->frames() > n)
+		{
+			return false;
+		}
+	}
+
+	// A full pipe on the receiving side holds back the sending side and strings go through a serializer.
+	{
+		const size_t length = 4, window = 8;
+
+		auto sp_pu = make_shared<pusher<string>>();
+		auto sp_ns = make_shared<flow::net_source<string>>(0, window);
+		auto sp_nk = make_shared<flow::net_sink<string>>("localhost", sp_ns->port());
+		auto sp_po = make_shared<popper<string>>();
+
+		flow::graph sending("sending", execution(args)), receiving("receiving", execution(args));
+
+		sending.add(sp_pu, "pusher");
+		sending.add(sp_nk, "net_sink");
+		sending.connect<string>(sp_pu, 0, sp_nk, 0);
+
+		receiving.add(sp_ns, "net_source");
+		receiving.add(sp_po, "popper");
+		receiving.connect<string>(sp_ns, 0, sp_po, 0, length, 0, flow::pipe_type::deque, flow::overflow::block);
+
+		receiving.start();
+		sending.start();
+
+		for(size_t i = 0; i != n + window + length; ++i)
+		{
+			sp_pu->push(string(i % 7, 'x') + to_string(i));
+		}
+
+		this_thread::sleep_for(chrono::milliseconds(200));
+
+		if(sp_nk->sent() > length + window + 1 || sp_nk->sent() < length)
+		{
+			return false;
+		}
+
+		for(size_t i = 0; i != n + window + length; ++i)
+		{
+			if(sp_po->pop()->data() != string(i % 7, 'x') + to_string(i))
+			{
+				return false;
+			}
+		}
+
+		sending.stop();
+		receiving.stop();
+	}
+
+	return true;
+#else
+	return true;
+#endif
+}
+
+bool budget(args_t args)
+{
+	const size_t size = flow::packet<int>(0).size();
+
+	// Once the budget is exhausted, packets pushed to the pipe of lowest priority are shed while the other pipe still takes them.
+	{
+		auto sp_pu0 = make_shared<pusher<int>>();
+		auto sp_pu1 = make_shared<pusher<int>>();
+		auto sp_po0 = make_shared<popper<int>>();
+		auto sp_po1 = make_shared<popper<int>>();
+
+		flow::graph g("graph", execution(args));
+
+		g.add(sp_pu0, "control");
+		g.add(sp_pu1, "bulk");
+		g.add(sp_po0, "control_popper");
+		g.add(sp_po1, "bulk_popper");
+		g.connect<int>(sp_pu0, 0, sp_po0, 0, 0, 0, pipe_type(args));
+		g.connect<int>(sp_pu1, 0, sp_po1, 0, 0, 0, pipe_type(args));
+
+		// Pipes connected before the budget is set are counted too.
+		g.budget(10 * size, flow::budget_policy::shed);
+
+		if(!g.prioritize("control", 0, 1) || g.prioritize("control_popper", 0, 1))
+		{
+			return false;
+		}
+
+		size_t pushed = 0;
+		for(int i = 0; i != 6; ++i)
+		{
+			pushed += sp_pu0->push(i);
+		}
+
+		for(int i = 0; i != 6; ++i)
+		{
+			pushed += sp_pu1->push(i);
+		}
+
+		pushed += sp_pu0->push(6);
+
+		flow::graph_metrics m = g.metrics();
+		if(pushed != 11 || m.budget.limit != 10 * size || m.budget.used != 11 * size || m.budget.high_water != 11 * size || m.budget.shed != 2 || m.budget.refused != 0)
+		{
+			return false;
+		}
+
+		for(auto& pm : m.pipes)
+		{
+			if(pm.dropped != (pm.name == "bulk_out0_to_bulk_popper_in0" ? 2u : 0u))
+			{
+				return false;
+			}
+		}
+
+		for(int i = 0; i != 4; ++i)
+		{
+			if(sp_po1->pop()->data() != i)
+			{
+				return false;
+			}
+		}
+
+		if(g.metrics().budget.used != 7 * size)
+		{
+			return false;
+		}
+	}
+
+	// The pipe that holds the most bytes refuses packets, the other does not.
+	{
+		auto sp_pu0 = make_shared<pusher<int>>();
+		auto sp_pu1 = make_shared<pusher<int>>();
+		auto sp_po0 = make_shared<popper<int>>();
+		auto sp_po1 = make_shared<popper<int>>();
+
+		flow::graph g("graph", execution(args));
+
+		// Pipes connected after the budget is set are counted as they are made.
+		g.budget(8 * size);
+
+		g.add(sp_pu0, "pusher0");
+		g.add(sp_pu1, "pusher1");
+		g.add(sp_po0, "popper0");
+		g.add(sp_po1, "popper1");
+		g.connect<int>(sp_pu0, 0, sp_po0, 0, 0, 0, pipe_type(args));
+		g.connect<int>(sp_pu1, 0, sp_po1, 0, 0, 0, pipe_type(args));
+
+		for(int i = 0; i != 8; ++i)
+		{
+			if(!sp_pu0->push(i))
+			{
+				return false;
+			}
+		}
+
+		if(!sp_pu1->push(0) || sp_pu0->push(8) || !sp_pu1->push(1))
+		{
+			return false;
+		}
+
+		flow::graph_metrics m = g.metrics();
+		if(m.budget.used != 10 * size || m.budget.refused != 1 || m.budget.shed != 0)
+		{
+			return false;
+		}
+
+		for(int i = 0; i != 3; ++i)
+		{
+			if(sp_po0->pop()->data() != i)
+			{
+				return false;
+			}
+		}
+
+		if(!sp_pu0->push(8) || g.metrics().budget.used != 8 * size)
+		{
+			return false;
+		}
+	}
+
+	// A producer pushing to a blocking pipe waits for room in the budget and nothing is lost.
+	{
+		auto sp_pu = make_shared<pusher<int>>();
+		auto sp_po = make_shared<popper<int>>();
+
+		flow::graph g("graph", execution(args));
+
+		g.add(sp_pu, "pusher");
+		g.add(sp_po, "popper");
+		g.connect<int>(sp_pu, 0, sp_po, 0, 0, 0, pipe_type(args), flow::overflow::block);
+		g.budget(4 * size);
+
+		g.start();
+
+		const int n = 100;
+
+		bool pushed = true;
+		thread t([&]
+		{
+			for(int i = 0; i != n; ++i)
+			{
+				pushed = sp_pu->push(i) && pushed;
+			}
+		});
+
+		bool in_order = true;
+		for(int i = 0; i != n; ++i)
+		{
+			in_order = sp_po->pop()->data() == i && in_order;
+		}
+
+		t.join();
+
+		flow::graph_metrics m = g.metrics();
+		if(!pushed || !in_order || m.pipes[0].dropped || m.budget.high_water > 4 * size || m.budget.used)
+		{
+			return false;
+		}
+	}
+
+	// The oldest packets make room for the newest, unless the pipe cannot pop from the producing side.
+	{
+		auto sp_pu = make_shared<pusher<int>>();
+		auto sp_po = make_shared<popper<int>>();
+
+		flow::graph g("graph", execution(args));
+
+		g.add(sp_pu, "pusher");
+		g.add(sp_po, "popper");
+		g.budget(4 * size, flow::budget_policy::drop_oldest);
+		g.connect<int>(sp_pu, 0, sp_po, 0, 0, 0, pipe_type(args));
+
+		const bool oldest = pipe_type(args) == flow::pipe_type::deque;
+
+		for(int i = 0; i != 6; ++i)
+		{
+			if(sp_pu->push(i) != (oldest || i < 4))
+			{
+				return false;
+			}
+		}
+
+		for(int i = oldest ? 2 : 0; i != (oldest ? 6 : 4); ++i)
+		{
+			if(sp_po->pop()->data() != i)
+			{
+				return false;
+			}
+		}
+
+		flow::graph_metrics m = g.metrics();
+		if(m.budget.shed != 2 || m.pipes[0].dropped != 2 || m.budget.used)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Records the index of the inpin of every packet it consumes.
+class recorder : public flow::consumer<int>
+{
+	vector<size_t> d_pins;
+	mutable mutex d_m;
+
+public:
+	recorder(const size_t ins) : flow::node("recorder"), flow::consumer<int>("recorder", ins) {}
+
+	virtual void ready(size_t i)
+	{
+		input(i).pop();
+
+		lock_guard<mutex> lg(d_m);
+		d_pins.push_back(i);
+	}
+
+	vector<size_t> pins() const
+	{
+		lock_guard<mutex> lg(d_m);
+		return d_pins;
+	}
+};
+
+bool service(args_t args)
+{
+	const string order = args["order"];
+	const size_t ins = 3, n = 6;
+
+	const int priorities[ins] = { 0, 5, 1 };
+	const size_t shares[ins] = { 1, 2, 3 };
+
+	auto sp_r = make_shared<recorder>(ins);
+
+	flow::graph g("graph", execution(args));
+	g.add(sp_r, "recorder");
+
+	if(order == "priority") sp_r->set_order(flow::service_order::priority);
+	else if(order == "weighted") sp_r->set_order(flow::service_order::weighted);
+	else if(order == "earliest") sp_r->set_order(flow::service_order::earliest);
+
+	vector<shared_ptr<pusher<int>>> pushers;
+	for(size_t i = 0; i != ins; ++i)
+	{
+		pushers.push_back(make_shared<pusher<int>>());
+		g.add(pushers[i], "pusher" + to_string(i));
+		g.connect<int>(pushers[i], 0, sp_r, i, 0, 0, flow::pipe_type::deque, flow::overflow::reject, priorities[i], shares[i]);
+	}
+
+	if(sp_r->input(1).priority() != 5 || sp_r->input(2).share() != 3)
+	{
+		return false;
+	}
+
+	// All packets wait at the inpins before the recorder starts. At each round, the last inpin has the earliest packet.
+	const flow::packet<int>::time_point_type now = chrono::high_resolution_clock::now();
+	for(size_t k = 0; k != n; ++k)
+	{
+		for(size_t i = 0; i != ins; ++i)
+		{
+			pushers[i]->push(static_cast<int>(k), now + chrono::milliseconds(k * ins + ins - 1 - i));
+		}
+	}
+
+	g.start();
+
+	for(int i = 0; i != 1000 && sp_r->pins().size() != ins * n; ++i)
+	{
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+
+	g.stop();
+
+	vector<size_t> expected;
+	if(order == "priority")
+	{
+		expected.insert(expected.end(), n, 1);
+		expected.insert(expected.end(), n, 2);
+		expected.insert(expected.end(), n, 0);
+	}
+	else if(order == "weighted")
+	{
+		vector<size_t> left(ins, n);
+		while(expected.size() != ins * n)
+		{
+			for(size_t i = 0; i != ins; ++i)
+			{
+				for(size_t t = 0; t != shares[i] && left[i]; ++t, --left[i])
+				{
+					expected.push_back(i);
+				}
+			}
+		}
+	}
+	else
+	{
+		for(size_t k = 0; k != n; ++k)
+		{
+			for(size_t i = 0; i != ins; ++i)
+			{
+				expected.push_back(order == "earliest" ? ins - 1 - i : i);
+			}
+		}
+	}
+
+	return sp_r->pins() == expected;
+}
+
+// Passes packets through after a delay that depends on their value.
+class jittery : public flow::transformer<int, int>
+{
+	const int d_max_us;
+	atomic<size_t> d_received_a;
+
+public:
+	jittery(const int max_us) : flow::node("jittery"), flow::transformer<int, int>("jittery", 1, 1), d_max_us(max_us), d_received_a(0) {}
+
+	virtual void ready(size_t i)
+	{
+		unique_ptr<flow::packet<int>> packet_p(input(i).pop());
+
+		this_thread::sleep_for(chrono::microseconds(packet_p->data() * 7919 % d_max_us));
+		++d_received_a;
+
+		output(0).push(packet_p);
+	}
+
+	size_t received() const
+	{
+		return d_received_a;
+	}
+};
+
+// Records the values of the packets it consumes.
+class collector : public flow::consumer<int>
+{
+	vector<int> d_values;
+	mutable mutex d_m;
+
+public:
+	collector() : flow::node("collector"), flow::consumer<int>("collector", 1) {}
+
+	virtual void ready(size_t i)
+	{
+		unique_ptr<flow::packet<int>> packet_p(input(i).pop());
+
+		lock_guard<mutex> lg(d_m);
+		d_values.push_back(packet_p->data());
+	}
+
+	vector<int> values() const
+	{
+		lock_guard<mutex> lg(d_m);
+		return d_values;
+	}
+};
+
+bool replicated(args_t args)
+{
+	const size_t replicas = stoul(args["replicas"]), n = stoul(args["packets"]);
+	const flow::distribution::type d = args["distribution"] == "least_loaded" ? flow::distribution::least_loaded : flow::distribution::round_robin;
+	const flow::ordering::type o = args["ordering"] == "arrival" ? flow::ordering::arrival : flow::ordering::sequence;
+
+	flow::parallel<jittery> p(replicas, d, o, 500);
+
+	auto sp_pu = make_shared<pusher<int>>();
+	auto sp_c = make_shared<collector>();
+
+	flow::graph g("graph", execution(args));
+	g.add(sp_pu, "pusher");
+	g.add(p, "jittery");
+	g.add(sp_c, "collector");
+	g.connect<int>(sp_pu, 0, p.splitter(), 0);
+	g.connect<int>(p.merger(), 0, sp_c, 0);
+
+	// A stage asked for no replicas gets one.
+	if(p.replicas() != max<size_t>(replicas, 1) || p.splitter()->name() != "jittery_split" || p.merger()->name() != "jittery_merge" || p.replica(p.replicas() - 1)->name() != "jittery_" + to_string(p.replicas() - 1))
+	{
+		return false;
+	}
+
+	g.start();
+
+	for(size_t i = 0; i != n; ++i)
+	{
+		sp_pu->push(static_cast<int>(i));
+	}
+
+	for(int i = 0; i != 1000 && sp_c->values().size() != n; ++i)
+	{
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+
+	g.stop();
+
+	vector<int> values = sp_c->values();
+	if(values.size() != n)
+	{
+		return false;
+	}
+
+	if(o == flow::ordering::arrival)
+	{
+		sort(values.begin(), values.end());
+	}
+
+	for(size_t i = 0; i != n; ++i)
+	{
+		if(values[i] != static_cast<int>(i))
+		{
+			return false;
+		}
+	}
+
+	size_t received = 0;
+	for(size_t r = 0; r != p.replicas(); ++r)
+	{
+		received += p.replica(r)->received();
+
+		if(d == flow::distribution::round_robin && p.replica(r)->received() != n / p.replicas() + (r < n % p.replicas()))
+		{
+			return false;
+		}
+	}
+
+	return received == n;
+}
+
+// A source with more than ten outpins feeding chains of transformers, built by name.
+bool large(args_t args)
+{
+	const size_t outs = 12, nodes = stoul(args["nodes"]), length = nodes / outs;
+
+	// A name reused across kinds of nodes replaces the earlier node.
+	{
+		flow::graph h;
+		h.add(make_shared<transformation_counter<int>>(), "reused");
+		h.add(make_shared<collector>(), "reused");
+
+		if(h.metrics().nodes.size() != 1)
+		{
+			return false;
+		}
+	}
+
+	flow::graph g("graph", execution(args));
+	g.reserve(1 + outs * (length + 1));
+
+	auto sp_p = make_shared<produce_n<int>>(1, outs);
+	g.add(sp_p, "source");
+
+	vector<shared_ptr<collector>> counters;
+	for(size_t o = 0; o != outs; ++o)
+	{
+		string last = "source";
+		size_t pin = o;
+
+		for(size_t i = 0; i != length; ++i)
+		{
+			const string name = "t" + to_string(o) + "_" + to_string(i);
+			g.add(make_shared<transformation_counter<int>>(), name);
+			if(!g.connect<int>(last, pin, name, 0))
+			{
+				return false;
+			}
+
+			last = name;
+			pin = 0;
+		}
+
+		counters.push_back(make_shared<collector>());
+		g.add(counters.back(), "counter" + to_string(o));
+		if(!g.connect<int>(last, pin, "counter" + to_string(o), 0))
+		{
+			return false;
+		}
+	}
+
+	if(g.connect<int>("source", 0, "nothing", 0) || sp_p->output(11).name() != "source_out11")
+	{
+		return false;
+	}
+
+	// Every pipe has a name of its own.
+	set<string> names;
+	for(auto& pm : g.metrics().pipes)
+	{
+		names.insert(pm.name);
+	}
+
+	if(names.size() != outs * (length + 1) || !names.count(length ? "source_out11_to_t11_0_in0" : "source_out11_to_counter11_in0"))
+	{
+		return false;
+	}
+
+	g.start();
+
+	for(int i = 0; i != 1000; ++i)
+	{
+		size_t counted = 0;
+		for(auto& sp_c : counters)
+		{
+			counted += sp_c->values().size();
+		}
+
+		if(counted == outs) break;
+
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+
+	g.stop();
+
+	for(auto& sp_c : counters)
+	{
+		if(sp_c->values().size() != 1)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Produces increasing values, as fast as it can.
+class counter : public flow::producer<int>
+{
+	int d_next;
+
+public:
+	counter() : flow::node("counter"), flow::producer<int>("counter", 1), d_next(0) {}
+
+	virtual void produce()
+	{
+		unique_ptr<flow::packet<int>> packet_p(make_packet(d_next++));
+		output(0).push(packet_p);
+
+		this_thread::yield();
+	}
+};
+
+// Moves a producer back and forth between two consumers while it is pushing.
+bool reconnect_live(args_t args)
+{
+	const size_t rounds = stoul(args["rounds"]);
+
+	auto sp_c = make_shared<counter>();
+	vector<shared_ptr<collector>> collectors{ make_shared<collector>(), make_shared<collector>() };
+
+	flow::graph g("graph", execution(args));
+	g.add(sp_c, "counter");
+	g.add(collectors[0], "collector0");
+	g.add(collectors[1], "collector1");
+	g.connect<int>(sp_c, 0, collectors[0], 0);
+
+	g.start();
+
+	int last = -1;
+	for(size_t r = 0; r != rounds; ++r)
+	{
+		collector &current_r = *collectors[r % 2];
+		const size_t had = current_r.values().size();
+
+		for(int i = 0; i != 1000 && current_r.values().size() < had + 10; ++i)
+		{
+			this_thread::sleep_for(chrono::milliseconds(1));
+		}
+
+		flow::graph::update u;
+		u.connect<int>("counter", 0, "collector" + to_string((r + 1) % 2), 0);
+
+		if(!g.apply(u))
+		{
+			return false;
+		}
+
+		// The consumer that was left gets nothing more, what it got follows what the other got before.
+		this_thread::sleep_for(chrono::milliseconds(5));
+		const vector<int> values = current_r.values();
+		if(values.size() < had + 10 || values[had] <= last || current_r.values().size() != values.size())
+		{
+			return false;
+		}
+
+		for(size_t i = had + 1; i != values.size(); ++i)
+		{
+			if(values[i] <= values[i - 1])
+			{
+				return false;
+			}
+		}
+
+		last = values.back();
+	}
+
+	g.stop();
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	bool b = false;
+
+	if(strcmp(argv[1], "empty") == 0)
+	{
+		const char* types[] = { "start" };
+		b = empty(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "unconnected") == 0)
+	{
+		const char* types[] = { "start" };
+		b = unconnected(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "connected") == 0)
+	{
+		const char* types[] = { "start" };
+		b = connected(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "count") == 0)
+	{
+		const char* types[] = { "count", "pipe", "execution" };
+		b = count(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "restart") == 0)
+	{
+		const char* types[] = { "halt", "count", "execution" };
+		b = restart(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "fused") == 0)
+	{
+		const char* types[] = { "count", "length", "execution" };
+		b = fused(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "tee") == 0)
+	{
+		const char* types[] = { "count", "execution" };
+		b = tee(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "reconnect") == 0)
+	{
+		const char* types[] = { "halt", "count", "execution" };
+		b = reconnect(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "batch") == 0)
+	{
+		const char* types[] = { "count", "pipe", "execution" };
+		b = batch(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "spin") == 0)
+	{
+		const char* types[] = { "count", "spins", "yields" };
+		b = spin(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "add_delay") == 0)
+	{
+		const char* types[] = { "" };
+		b = add_delay(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "add") == 0)
+	{
+		const char* types[] = { "type", "count" };
+		b = add<void>(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "const_add") == 0)
+	{
+		const char* types[] = { "type", "count" };
+		b = const_add<void>(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "max_length") == 0)
+	{
+		const char* types[] = { "length", "pipe" };
+		b = max_length(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "max_weight") == 0)
+	{
+		const char* types[] = { "weight", "pipe" };
+		b = max_weight(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "string_weight") == 0)
+	{
+		const char* types[] = { "length" };
+		b = string_weight(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "reuse_pipe") == 0)
+	{
+		const char* types[] = { "weight" };
+		b = reuse_pipe(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "pool") == 0)
+	{
+		const char* types[] = { "count" };
+		b = pool(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "metrics") == 0)
+	{
+		const char* types[] = { "length", "pipe" };
+		b = metrics(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "shared_tee") == 0)
+	{
+		const char* types[] = { "outs" };
+		b = shared_tee(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "overflow") == 0)
+	{
+		const char* types[] = { "policy", "length", "pipe" };
+		b = overflow(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "multirate") == 0)
+	{
+		const char* types[] = { "generators" };
+		b = multirate(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "multirate_churn") == 0)
+	{
+		const char* types[] = { "generators" };
+		b = multirate_churn(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "static_pipeline") == 0)
+	{
+		const char* types[] = { "packets" };
+		b = static_pipeline(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "batches") == 0)
+	{
+		const char* types[] = { "values" };
+		b = batches(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "slim") == 0)
+	{
+		const char* types[] = { "packets", "pipe", "execution" };
+		b = slim(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "deliver") == 0)
+	{
+		const char* types[] = { "deliverers", "pipe" };
+		b = deliver(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "affinity") == 0)
+	{
+		const char* types[] = { "count", "execution" };
+		b = affinity(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "files") == 0)
+	{
+		const char* types[] = { "records", "per_packet" };
+		b = files(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "buffered") == 0)
+	{
+		const char* types[] = { "packets", "execution" };
+		b = buffered(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "joins") == 0)
+	{
+		const char* types[] = { "ins", "packets", "execution" };
+		b = joins(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "update") == 0)
+	{
+		const char* types[] = { "count", "execution" };
+		b = update(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "drain") == 0)
+	{
+		const char* types[] = { "count", "execution" };
+		b = drain(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "shm") == 0)
+	{
+		const char* types[] = { "count", "execution" };
+		b = shm(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "net") == 0)
+	{
+		const char* types[] = { "count", "execution" };
+		b = net(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "budget") == 0)
+	{
+		const char* types[] = { "pipe", "execution" };
+		b = budget(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "service") == 0)
+	{
+		const char* types[] = { "order", "execution" };
+		b = service(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "reconnect_live") == 0)
+	{
+		const char* types[] = { "rounds", "execution" };
+		b = reconnect_live(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "large") == 0)
+	{
+		const char* types[] = { "nodes", "execution" };
+		b = large(make_args(types, &argv[2], argc - 2));
+	}
+	else if(strcmp(argv[1], "parallel") == 0)
+	{
+		const char* types[] = { "replicas", "packets", "distribution", "ordering", "execution" };
+		b = replicated(make_args(types, &argv[2], argc - 2));
 	}
 
 	return b ? 0 : 1;
@@ -4,6 +4,7 @@
 #include "flow.h"
 
 #include <memory>
+#include <vector>
 
 template<typename T>
 class pusher : public flow::producer<T>
@@ -16,17 +17,29 @@ public:
 
 	virtual void produce() {}
 
-	virtual void push(const T& t)
+	virtual bool push(const T& t)
 	{
-		std::unique_ptr<flow::packet<T>> packet_p(new flow::packet<T>(t));
+		std::unique_ptr<flow::packet<T>> packet_p(flow::producer<T>::make_packet(t));
 
-		flow::producer<T>::output(0).push(packet_p);
+		return flow::producer<T>::output(0).push(packet_p);
+	}
+
+	virtual size_t push_n(const std::vector<T>& ts)
+	{
+		typename flow::pipe<T>::packets_t packets;
+
+		for(auto& t : ts)
+		{
+			packets.push_back(flow::producer<T>::make_packet(t));
+		}
+
+		return flow::producer<T>::output(0).push_n(packets);
 	}
 
 	template<typename Duration>
 	void push(const T& t, const Duration& d)
 	{
-		std::unique_ptr<flow::packet<T>> packet_p(new flow::packet<T>(t, d));
+		std::unique_ptr<flow::packet<T>> packet_p(flow::producer<T>::make_packet(t, d));
 
 		flow::producer<T>::output(0).push(packet_p);
 	}
@@ -46,6 +59,8 @@ public:
 
 	virtual void ready(size_t)
 	{
+		// Locking keeps the notification from falling between pop's check and its wait.
+		std::lock_guard<std::mutex> lg(d_incoming_m);
 		d_incoming_cv.notify_one();
 	}
 
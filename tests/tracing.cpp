@@ -0,0 +1,225 @@
+#include "flow.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+typedef map<string, string> args_t;
+
+args_t make_args(const char* types[], char* values[], int c)
+{
+	args_t args;
+
+	while(c)
+	{
+		--c;
+
+		args[types[c]] = values[c];
+	}
+
+	return args;
+}
+
+flow::execution::type execution(args_t& args)
+{
+	return args["execution"] == "pooled" ? flow::execution::pooled : flow::execution::threaded;
+}
+
+// Produces a number of packets then yields its thread.
+class source : public flow::producer<int>
+{
+	size_t d_n;
+
+public:
+	source(size_t n) : flow::node("source"), flow::producer<int>("source", 1), d_n(n) {}
+
+	virtual void produce()
+	{
+		if(d_n)
+		{
+			--d_n;
+
+			unique_ptr<flow::packet<int>> packet_p(make_packet(0));
+			output(0).push(packet_p);
+		}
+		else
+		{
+			this_thread::yield();
+		}
+	}
+};
+
+// Passes packets through.
+class relay : public flow::transformer<int, int>
+{
+public:
+	relay() : flow::node("relay"), flow::transformer<int, int>("relay", 1, 1) {}
+
+	virtual void ready(size_t i)
+	{
+		unique_ptr<flow::packet<int>> packet_p(input(i).pop());
+		output(0).push(packet_p);
+	}
+};
+
+// Counts the packets it consumes.
+class sink : public flow::consumer<int>
+{
+	atomic<size_t> d_received_a;
+
+public:
+	sink() : flow::node("sink"), flow::consumer<int>("sink", 1), d_received_a(0) {}
+
+	virtual void ready(size_t i)
+	{
+		input(i).pop();
+		++d_received_a;
+	}
+
+	size_t received() const
+	{
+		return d_received_a;
+	}
+};
+
+// Waits for a sink to receive a number of packets, for a few seconds at most.
+bool received(const sink& sink_r, const size_t n)
+{
+	for(int i = 0; i != 1000 && sink_r.received() < n; ++i)
+	{
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+
+	return sink_r.received() == n;
+}
+
+// Builds a source, a relay and a sink, runs them until the sink got n packets and stops them.
+bool run(flow::graph& g, const size_t n, const string& prefix = "")
+{
+	auto sp_s = make_shared<source>(n);
+	auto sp_r = make_shared<relay>();
+	auto sp_k = make_shared<sink>();
+	g.add(sp_s, prefix + "source");
+	g.add(sp_r, prefix + "relay");
+	g.add(sp_k, prefix + "sink");
+	g.connect<int>(sp_s, 0, sp_r, 0);
+	g.connect<int>(sp_r, 0, sp_k, 0);
+
+	g.start();
+	const bool b = received(*sp_k, n);
+	g.stop();
+
+	return b;
+}
+
+size_t occurrences(const string& s, const string& what)
+{
+	size_t n = 0;
+
+	for(size_t p = s.find(what); p != string::npos; p = s.find(what, p + what.size()))
+	{
+		++n;
+	}
+
+	return n;
+}
+
+// Every push is linked to its pop, every call to produce() and ready() is a slice and every state change is recorded.
+// Events of another graph are left out, clearing the tracer leaves nothing to collect.
+bool trace(args_t args)
+{
+	const size_t n = stoul(args["packets"]);
+
+	if(!flow::tracer::enabled())
+	{
+		return false;
+	}
+
+	flow::tracer::clear();
+
+	flow::graph other("other", execution(args), 2);
+	flow::graph g("graph", execution(args), 2);
+
+	if(!run(other, n, "other_") || !run(g, n))
+	{
+		return false;
+	}
+
+	vector<flow::trace_event> events;
+	flow::tracer::collect(events);
+
+	map<flow::hook::type, size_t> counts;
+	for(auto& e : events)
+	{
+		++counts[e.what];
+
+		if(e.what == flow::hook::push && (!e.packet_p || e.arg != 1))
+		{
+			return false;
+		}
+	}
+
+	// In each graph, the source and the relay push and the relay and the sink pop.
+	if(counts[flow::hook::push] != 4 * n || counts[flow::hook::pop] != 4 * n || counts[flow::hook::ready] != 4 * n || counts[flow::hook::produce] < 2 * n)
+	{
+		return false;
+	}
+
+	ostringstream oss;
+	g.to_trace(oss);
+	const string t = oss.str();
+
+	if(t.find("{\"traceEvents\":[") != 0 || t.find("\"displayTimeUnit\":\"ns\"}") == string::npos)
+	{
+		return false;
+	}
+
+	if(occurrences(t, "\"ph\":\"s\"") != 2 * n || occurrences(t, "\"ph\":\"f\"") != 2 * n || occurrences(t, "\"latency_us\":") != 2 * n)
+	{
+		return false;
+	}
+
+	if(occurrences(t, "\"cat\":\"ready\"") != 2 * n || occurrences(t, "\"cat\":\"produce\"") < n)
+	{
+		return false;
+	}
+
+	// Each of the three nodes was started and stopped.
+	if(occurrences(t, "\"name\":\"started\"") != 3 || occurrences(t, "\"name\":\"stopped\"") != 3)
+	{
+		return false;
+	}
+
+	if(t.find("other_") != string::npos || occurrences(t, "\"ph\":\"M\"") == 0)
+	{
+		return false;
+	}
+
+	flow::tracer::clear();
+
+	events.clear();
+	flow::tracer::collect(events);
+
+	return events.empty();
+}
+
+int main(int argc, char* argv[])
+{
+	bool b = false;
+
+	if(strcmp(argv[1], "trace") == 0)
+	{
+		const char* types[] = { "packets", "execution" };
+		b = trace(make_args(types, &argv[2], argc - 2));
+	}
+
+	return b ? 0 : 1;
+}